@@ -6,11 +6,14 @@
 #define MARROW_API_H
 
 #include "index.h"
+#include "chunked_index.h"
+#include "lazy_batch.h"
 #include "sort.h"
 #include "left.h"
 #include "inner.h"
 #include "outer.h"
 #include "arrow_throw.h"
+#include <arrow/array/concatenate.h>
 #include <arrow/util/key_value_metadata.h>
 #include <boost/algorithm/string.hpp>
 
@@ -19,7 +22,7 @@ namespace marrow {
     constexpr const char* index_metadata_key = "__marrow_index";
     constexpr const char* sort_metadata_key = "__marrow_index";
 
-    std::shared_ptr<arrow::RecordBatch> add_sort_metadata(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> on) {
+    inline std::shared_ptr<arrow::RecordBatch> add_sort_metadata(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> on) {
         std::string ret = on[0];
         for (size_t i = 1; i < on.size(); i++) {
             ret += ",";
@@ -34,74 +37,336 @@ namespace marrow {
         return batch->ReplaceSchemaMetadata(arrow::key_value_metadata(meta_data));
     }
 
-    std::pair<std::shared_ptr<arrow::Array>, std::shared_ptr<arrow::RecordBatch>> get_index(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> on) {
+    /**
+     * The pool the api functions allocate from, null is the default memory pool. It holds the results and the Arrow
+     * arrays made on the way, like sort indices and join indices. Scratch memory in std::vectors is not taken from
+     * it: the normalized keys and radix sort buffers of make_index, the hash table and row hashes of a hash join,
+     * the row blocks of a blocked gather and the temporaries of the batch comparers.
+     */
+    inline arrow::MemoryPool* memory_pool(arrow::MemoryPool* pool) {
+        return pool ? pool : arrow::default_memory_pool();
+    }
+
+    /**
+     * Whether the meta data says the batch is indexed or sorted on the on columns.
+     */
+    inline bool has_sort_metadata(const std::shared_ptr<arrow::RecordBatch>& batch, const std::vector<std::string>& on) {
+        if (!batch->schema()->metadata()) {
+            return false;
+        }
+        auto value_index = batch->schema()->metadata()->FindKey(index_metadata_key);
+        if (value_index < 0) {
+            return false;
+        }
+        auto value = batch->schema()->metadata()->value(value_index);
+        std::vector<std::string> sort_columns;
+        boost::split(sort_columns, value, [](char c) { return c == ','; });
+        if (sort_columns.size() < on.size()) {
+            return false;
+        }
+        sort_columns.resize(on.size());
+        return std::equal(sort_columns.begin(), sort_columns.end(), on.begin(), on.end());
+    }
+
+    /**
+     * Returns the index (null if the batch is already sorted) and the batch without index column. With a limit >= 0
+     * only the first limit rows in sort order are indexed.
+     */
+    inline std::pair<std::shared_ptr<arrow::Array>, std::shared_ptr<arrow::RecordBatch>> get_index(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> on, int num_threads = 1, int64_t limit = -1, arrow::MemoryPool* pool = nullptr) {
         std::shared_ptr<arrow::Array> index;
-        if (batch->schema()->metadata()) {
-            auto value_index = batch->schema()->metadata()->FindKey(index_metadata_key);
-            if (value_index >= 0) {
-                auto value = batch->schema()->metadata()->value(value_index);
-                std::vector<std::string> sort_columns;
-                boost::split(sort_columns, value, [](char c) { return c == ','; });
-                if (sort_columns.size() >= on.size()) {
-                    sort_columns.resize(on.size());
-                    if (std::equal(sort_columns.begin(), sort_columns.end(), on.begin(), on.end())) {
-                        auto ret_index = batch->schema()->GetFieldIndex(index_column_name);
-                        if (ret_index >= 0) {
-                            //It has an index, remove and return
-                            index = batch->column(ret_index);
-                            ARROW_THROW_NOT_OK(batch->RemoveColumn(ret_index, &batch));
-                        }
-                        //no index but meta data, hence it is sorted
-                        return {index, batch};
-                    }
+        if (has_sort_metadata(batch, on)) {
+            auto ret_index = batch->schema()->GetFieldIndex(index_column_name);
+            if (ret_index >= 0) {
+                //It has an index, remove and return
+                index = batch->column(ret_index);
+                ARROW_THROW_NOT_OK(batch->RemoveColumn(ret_index, &batch));
+                if (limit >= 0 && limit < index->length()) {
+                    index = index->Slice(0, limit);
                 }
             }
+            else if (limit >= 0 && limit < batch->num_rows()) {
+                batch = batch->Slice(0, limit);
+            }
+            //no index but meta data, hence it is sorted
+            return {index, batch};
         }
         auto index_index = batch->schema()->GetFieldIndex(index_column_name);
         if (index_index >= 0) {
             //It has an index, remove and return
             ARROW_THROW_NOT_OK(batch->RemoveColumn(index_index, &batch));
         }
+        //The string prefixes of the key are computed once, for the sort check and the index
+        StringPrefixCache prefixes;
+        bool sorted;
+        ARROW_THROW_NOT_OK(is_batch_sorted(batch, on, &sorted, &prefixes));
+        if (sorted) {
+            //Sorted without meta data, e.g. a time ordered feed
+            if (limit >= 0 && limit < batch->num_rows()) {
+                batch = batch->Slice(0, limit);
+            }
+            return {index, batch};
+        }
         // No usable index or sort order, so create an index
-        ARROW_THROW_NOT_OK(make_index(batch, on, &index));
+        if (limit >= 0) {
+            ARROW_THROW_NOT_OK(make_partial_index(batch, on, limit, &index, memory_pool(pool), &prefixes));
+        }
+        else {
+            ARROW_THROW_NOT_OK(make_index(batch, on, &index, num_threads, memory_pool(pool), &prefixes));
+        }
         return {index, batch};
     }
 
     namespace api {
 
-    std::shared_ptr<arrow::RecordBatch> add_index(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> on) {
+    inline std::shared_ptr<arrow::RecordBatch> add_index(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> on, int num_threads = 1, arrow::MemoryPool* pool = nullptr) {
         std::shared_ptr<arrow::Array> index;
-        ARROW_THROW_NOT_OK(make_index(batch, on, &index));
+        ARROW_THROW_NOT_OK(make_index(batch, on, &index, num_threads, memory_pool(pool)));
         auto field = arrow::field(index_column_name, index->type());
         ARROW_THROW_NOT_OK(batch->AddColumn(0, field, index, &batch));
         return add_sort_metadata(batch, on);
     }
 
-    std::shared_ptr<arrow::RecordBatch> sort(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> on) {
-        auto index = get_index(batch, on);
-        ARROW_THROW_NOT_OK(batch_by_index(index.second, index.first, &batch));
+    /**
+     * Append the rows of new_batch to an indexed (or sorted) batch and return it with the updated index column and
+     * meta data. Only the new rows are sorted.
+     */
+    inline std::shared_ptr<arrow::RecordBatch> append(std::shared_ptr<arrow::RecordBatch> batch, std::shared_ptr<arrow::RecordBatch> new_batch, std::vector<std::string> on, arrow::MemoryPool* pool = nullptr) {
+        auto index = get_index(batch, on, 1, -1, pool);
+        batch = index.second;
+        if (!batch->schema()->Equals(*new_batch->schema(), false)) {
+            throw std::runtime_error("Appended batch has a different schema: " + new_batch->schema()->ToString());
+        }
+        std::shared_ptr<arrow::Array> combined_index;
+        ARROW_THROW_NOT_OK(append_index(batch, index.first, new_batch, on, &combined_index, memory_pool(pool)));
+
+        std::vector<std::shared_ptr<arrow::Array>> columns(batch->num_columns());
+        for (int i = 0; i < batch->num_columns(); i++) {
+            ARROW_THROW_NOT_OK(arrow::Concatenate({batch->column(i), new_batch->column(i)}, memory_pool(pool), &columns[i]));
+        }
+        auto combined = arrow::RecordBatch::Make(batch->schema(), combined_index->length(), columns);
+        auto field = arrow::field(index_column_name, combined_index->type());
+        ARROW_THROW_NOT_OK(combined->AddColumn(0, field, combined_index, &combined));
+        return add_sort_metadata(combined, on);
+    }
+
+    /**
+     * Sort the batch by the on columns. If columns are given only those are gathered and returned. The gather options
+     * pick how fixed width columns are gathered, see GatherOptions.
+     */
+    inline std::shared_ptr<arrow::RecordBatch> sort(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> on, int num_threads = 1, int64_t limit = -1, std::vector<std::string> columns = {}, arrow::MemoryPool* pool = nullptr,
+                                                    GatherOptions gather = GatherOptions()) {
+        auto index = get_index(batch, on, num_threads, limit, pool);
+        ARROW_THROW_NOT_OK(select_columns(index.second, columns, &batch));
+        if (!index.first) {
+            //Already sorted
+            return batch;
+        }
+        ARROW_THROW_NOT_OK(batch_by_index(batch, index.first, &batch, num_threads, memory_pool(pool), gather));
         return batch;
     }
 
-    std::shared_ptr<arrow::RecordBatch> merge(std::shared_ptr<arrow::RecordBatch> batch1, std::shared_ptr<arrow::RecordBatch> batch2, std::vector<std::string> on, std::string how, std::string right_prefix) {
-        auto index1 = get_index(batch1, on);
-        auto index2 = get_index(batch2, on);
+    /**
+     * The most right rows for which "auto" hashes, so that the hash table of the right rows stays small enough to be
+     * mostly in cache.
+     */
+    constexpr int64_t hash_join_max_right_rows = 1 << 20;
+
+    /**
+     * How many times more left rows than right rows "auto" needs to hash: sorting the small right side is cheap, so
+     * hashing only pays when it saves sorting a much larger left side.
+     */
+    constexpr int64_t hash_join_min_left_ratio = 4;
+
+    /**
+     * The join method of a merge: "sort" merges both sides in sort order, "hash" looks the left rows up in a hash table
+     * of the right rows and "auto" merges if both sides are indexed or sorted by their meta data. Otherwise "auto"
+     * hashes only if right has fewer than hash_join_max_right_rows rows and at most a hash_join_min_left_ratio-th of the
+     * left rows, and merges if not.
+     */
+    inline JoinMethod join_method(const std::string& method, const std::shared_ptr<arrow::RecordBatch>& batch1, const std::shared_ptr<arrow::RecordBatch>& batch2, const std::vector<std::string>& on) {
+        if (method == "sort") {
+            return JoinMethod::Sort;
+        }
+        else if (method == "hash") {
+            return JoinMethod::Hash;
+        }
+        else if (method == "auto") {
+            if (has_sort_metadata(batch1, on) && has_sort_metadata(batch2, on)) {
+                return JoinMethod::Sort;
+            }
+            auto right_rows = batch2->num_rows();
+            return right_rows < hash_join_max_right_rows && right_rows * hash_join_min_left_ratio <= batch1->num_rows() ? JoinMethod::Hash : JoinMethod::Sort;
+        }
+        throw std::runtime_error("Unsupported merge method argument: " + method);
+    }
+
+    /**
+     * The index (null for a hash join, which needs none) and the batch without index column for a join.
+     */
+    inline std::pair<std::shared_ptr<arrow::Array>, std::shared_ptr<arrow::RecordBatch>> get_join_index(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> on, JoinMethod method, int num_threads, arrow::MemoryPool* pool) {
+        if (method == JoinMethod::Sort) {
+            return get_index(batch, on, num_threads, -1, pool);
+        }
+        auto index_index = batch->schema()->GetFieldIndex(index_column_name);
+        if (index_index >= 0) {
+            ARROW_THROW_NOT_OK(batch->RemoveColumn(index_index, &batch));
+        }
+        return {nullptr, batch};
+    }
+
+    /**
+     * Merge the batches on the on columns. If columns or right_columns are given only those columns of the left and
+     * (non key) columns of the right batch are gathered. A hash join (see join_method) does not sort either side, its
+     * rows come in left row order followed by the right only rows. The gather options are those of sort.
+     */
+    inline std::shared_ptr<arrow::RecordBatch> merge(std::shared_ptr<arrow::RecordBatch> batch1, std::shared_ptr<arrow::RecordBatch> batch2, std::vector<std::string> on, std::string how, std::string right_prefix, int num_threads = 1,
+                                                     std::vector<std::string> columns = {}, std::vector<std::string> right_columns = {}, arrow::MemoryPool* pool = nullptr, std::string method = "sort",
+                                                     GatherOptions gather = GatherOptions()) {
+        auto join = join_method(method, batch1, batch2, on);
+        auto index1 = get_join_index(batch1, on, join, num_threads, pool);
+        auto index2 = get_join_index(batch2, on, join, num_threads, pool);
         std::shared_ptr<arrow::RecordBatch> ret;
         if (how == "left") {
-            ARROW_THROW_NOT_OK(left(index1.second, index2.second, index1.first, index2.first, on, &ret, right_prefix));
+            ARROW_THROW_NOT_OK(left(index1.second, index2.second, index1.first, index2.first, on, &ret, right_prefix, num_threads, columns, right_columns, memory_pool(pool), join, gather));
+        }
+        else if (how == "inner") {
+            ARROW_THROW_NOT_OK(inner(index1.second, index2.second, index1.first, index2.first, on, &ret, right_prefix, num_threads, columns, right_columns, memory_pool(pool), join, gather));
+        }
+        else if (how == "outer") {
+            ARROW_THROW_NOT_OK(outer(index1.second, index2.second, index1.first, index2.first, on, &ret, right_prefix, num_threads, columns, right_columns, memory_pool(pool), join, gather));
+        }
+        else {
+            throw std::runtime_error("Unsupported merge how argument: " + how);
+        }
+
+        return ret;
+    }
+
+    /**
+     * Like sort, but a column is only gathered when it is first accessed, e.g. by materialize(columns).
+     */
+    inline std::shared_ptr<LazyRecordBatch> lazy_sort(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> on, int num_threads = 1, int64_t limit = -1, arrow::MemoryPool* pool = nullptr,
+                                                      GatherOptions gather = GatherOptions()) {
+        auto index = get_index(batch, on, num_threads, limit, pool);
+        return LazyRecordBatch::make(index.second, index.first, num_threads, memory_pool(pool), gather);
+    }
+
+    /**
+     * Like merge, but the columns are only gathered when they are first accessed. Columns which are not selected by
+     * columns or right_columns are left out.
+     */
+    inline std::shared_ptr<LazyRecordBatch> lazy_merge(std::shared_ptr<arrow::RecordBatch> batch1, std::shared_ptr<arrow::RecordBatch> batch2, std::vector<std::string> on, std::string how, std::string right_prefix, int num_threads = 1,
+                                                       std::vector<std::string> columns = {}, std::vector<std::string> right_columns = {}, arrow::MemoryPool* pool = nullptr, std::string method = "sort",
+                                                       GatherOptions gather = GatherOptions()) {
+        auto join = join_method(method, batch1, batch2, on);
+        auto index1 = get_join_index(batch1, on, join, num_threads, pool);
+        auto index2 = get_join_index(batch2, on, join, num_threads, pool);
+        std::shared_ptr<LazyRecordBatch> ret;
+        if (how == "left") {
+            ARROW_THROW_NOT_OK(lazy_left(index1.second, index2.second, index1.first, index2.first, on, &ret, right_prefix, num_threads, columns, right_columns, memory_pool(pool), join, gather));
         }
         else if (how == "inner") {
-            ARROW_THROW_NOT_OK(inner(index1.second, index2.second, index1.first, index2.first, on, &ret, right_prefix));
+            ARROW_THROW_NOT_OK(lazy_inner(index1.second, index2.second, index1.first, index2.first, on, &ret, right_prefix, num_threads, columns, right_columns, memory_pool(pool), join, gather));
         }
         else if (how == "outer") {
-            ARROW_THROW_NOT_OK(outer(index1.second, index2.second, index1.first, index2.first, on, &ret, right_prefix));
+            ARROW_THROW_NOT_OK(lazy_outer(index1.second, index2.second, index1.first, index2.first, on, &ret, right_prefix, num_threads, columns, right_columns, memory_pool(pool), join, gather));
         }
         else {
             throw std::runtime_error("Unsupported merge how argument: " + how);
         }
+        return ret;
+    }
 
+    /**
+     * Materialize the given columns of a lazy batch, all columns if none are given.
+     */
+    inline std::shared_ptr<arrow::RecordBatch> materialize(std::shared_ptr<LazyRecordBatch> lazy, std::vector<std::string> columns = {}) {
+        std::shared_ptr<arrow::RecordBatch> ret;
+        if (columns.empty()) {
+            ARROW_THROW_NOT_OK(lazy->materialize(&ret));
+        }
+        else {
+            ARROW_THROW_NOT_OK(lazy->materialize(columns, &ret));
+        }
         return ret;
     }
+
+    /**
+     * The table without an index column, whose rows do not index the chunks of a table.
+     */
+    inline std::shared_ptr<arrow::Table> without_index_column(std::shared_ptr<arrow::Table> table) {
+        auto index_index = table->schema()->GetFieldIndex(index_column_name);
+        if (index_index >= 0) {
+            ARROW_THROW_NOT_OK(table->RemoveColumn(index_index, &table));
+        }
+        return table;
+    }
+
+    /**
+     * Sort the rows of all chunks of the table into one batch with sort meta data. Chunks are indexed on their own and
+     * merged, so the table is never concatenated. If columns are given only those are gathered and returned, without
+     * sort meta data unless they include the on columns.
+     */
+    inline std::shared_ptr<arrow::RecordBatch> sorted_batch(std::shared_ptr<arrow::Table> table, std::vector<std::string> on, int num_threads = 1, std::vector<std::string> columns = {}, arrow::MemoryPool* pool = nullptr) {
+        table = without_index_column(table);
+        std::vector<std::shared_ptr<arrow::RecordBatch>> batches;
+        ARROW_THROW_NOT_OK(table_batches(*table, &batches));
+        ChunkedIndex index;
+        ARROW_THROW_NOT_OK(make_chunked_index(batches, on, &index, num_threads, memory_pool(pool)));
+        auto schema = table->schema();
+        if (!columns.empty()) {
+            std::vector<int> indices;
+            for (auto& name: columns) {
+                auto i = schema->GetFieldIndex(name);
+                if (i < 0) {
+                    throw std::runtime_error("No such column: " + name);
+                }
+                indices.push_back(i);
+            }
+            for (auto& b: batches) {
+                b = project_batch(b, indices);
+            }
+            schema = project_schema(*schema, indices);
+        }
+        std::shared_ptr<arrow::RecordBatch> batch;
+        ARROW_THROW_NOT_OK(batches_by_index(schema, batches, index, &batch, num_threads, memory_pool(pool)));
+        for (auto& name: on) {
+            if (batch->schema()->GetFieldIndex(name) < 0) {
+                return batch;
+            }
+        }
+        return add_sort_metadata(batch, on);
+    }
+
+    inline std::shared_ptr<arrow::Table> sort(std::shared_ptr<arrow::Table> table, std::vector<std::string> on, int num_threads = 1, std::vector<std::string> columns = {}, arrow::MemoryPool* pool = nullptr) {
+        auto batch = sorted_batch(table, on, num_threads, columns, pool);
+        return arrow::Table::Make(batch->schema(), batch->columns(), batch->num_rows());
+    }
+
+    /**
+     * Merge two tables chunk by chunk: the chunks of either side are indexed on their own and the result is gathered
+     * from them, without a concatenated or sorted copy of either table. Columns and right_columns select the gathered
+     * columns as in merge of two batches.
+     */
+    inline std::shared_ptr<arrow::Table> merge(std::shared_ptr<arrow::Table> table1, std::shared_ptr<arrow::Table> table2, std::vector<std::string> on, std::string how, std::string right_prefix, int num_threads = 1,
+                                               std::vector<std::string> columns = {}, std::vector<std::string> right_columns = {}, arrow::MemoryPool* pool = nullptr) {
+        table1 = without_index_column(table1);
+        table2 = without_index_column(table2);
+        std::shared_ptr<arrow::RecordBatch> batch;
+        if (how == "left") {
+            ARROW_THROW_NOT_OK(left(table1, table2, on, &batch, right_prefix, num_threads, columns, right_columns, memory_pool(pool)));
+        }
+        else if (how == "inner") {
+            ARROW_THROW_NOT_OK(inner(table1, table2, on, &batch, right_prefix, num_threads, columns, right_columns, memory_pool(pool)));
+        }
+        else if (how == "outer") {
+            ARROW_THROW_NOT_OK(outer(table1, table2, on, &batch, right_prefix, num_threads, columns, right_columns, memory_pool(pool)));
+        }
+        else {
+            throw std::runtime_error("Unsupported merge how argument: " + how);
+        }
+        return arrow::Table::Make(batch->schema(), batch->columns(), batch->num_rows());
+    }
     }
 }
 
@@ -0,0 +1,98 @@
+#ifndef MARROW_CHUNKED_INDEX_H
+#define MARROW_CHUNKED_INDEX_H
+
+#include <queue>
+#include <utility>
+#include <vector>
+#include <arrow/table.h>
+#include "marrow/index.h"
+#include "marrow/normalized_key.h"
+#include "marrow/parallel.h"
+
+namespace marrow {
+
+    /**
+     * Index into a list of batches, e.g. the chunks of a table: the i-th row in sort order is row rows[i] of batch
+     * chunks[i]. A null row, e.g. the missing side of an outer join, gathers a null.
+     */
+    struct ChunkedIndex {
+        std::shared_ptr<arrow::Int32Array> chunks;
+        std::shared_ptr<arrow::Int64Array> rows;
+
+        int64_t length() const {
+            return rows->length();
+        }
+    };
+
+    /**
+     * The record batches of a table, sliced where the chunks of its columns do not line up. No data is copied.
+     */
+    static arrow::Status table_batches(const arrow::Table& table, std::vector<std::shared_ptr<arrow::RecordBatch>>* batches_out) {
+        arrow::TableBatchReader reader(table);
+        std::shared_ptr<arrow::RecordBatch> batch;
+        while (true) {
+            ARROW_RETURN_NOT_OK(reader.ReadNext(&batch));
+            if (!batch) {
+                return arrow::Status::OK();
+            }
+            if (batch->num_rows() > 0) {
+                batches_out->push_back(batch);
+            }
+        }
+    }
+
+    /**
+     * Create an index which sorts the rows of all batches together, without concatenating them. Every batch is indexed
+     * on its own (on up to num_threads threads), then the sorted batches are k-way merged by their normalized keys.
+     * Equal keys keep their batch and row order.
+     */
+    static arrow::Status make_chunked_index(const std::vector<std::shared_ptr<arrow::RecordBatch>>& batches, std::vector<std::string> index_columns, ChunkedIndex* index_out, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool()) {
+        auto num_batches = static_cast<int64_t>(batches.size());
+        std::vector<std::shared_ptr<arrow::Array>> indices(num_batches);
+        std::vector<std::unique_ptr<NormalizedKeyComparer>> keys(num_batches);
+        int64_t num_rows = 0;
+        for (auto& b: batches) {
+            num_rows += b->num_rows();
+        }
+        ARROW_RETURN_NOT_OK(parallel_for(num_batches, num_threads, [&](int64_t c) {
+            keys[c].reset(new NormalizedKeyComparer(batches[c], index_columns, true));
+            return make_index<arrow::Int64Type>(batches[c], index_columns, &indices[c], 1, pool);
+        }));
+
+        std::shared_ptr<arrow::Buffer> chunks_buffer, rows_buffer;
+        ARROW_RETURN_NOT_OK(arrow::AllocateBuffer(pool, num_rows * sizeof(int32_t), &chunks_buffer));
+        ARROW_RETURN_NOT_OK(arrow::AllocateBuffer(pool, num_rows * sizeof(int64_t), &rows_buffer));
+        auto chunks_out = reinterpret_cast<int32_t*>(chunks_buffer->mutable_data());
+        auto rows_out = reinterpret_cast<int64_t*>(rows_buffer->mutable_data());
+
+        //Heap of the next position of every batch, with the smallest key on top
+        auto row = [&indices](int32_t chunk, int64_t position) {
+            return static_cast<const arrow::Int64Array&>(*indices[chunk]).Value(position);
+        };
+        auto later = [&](const std::pair<int32_t, int64_t>& p1, const std::pair<int32_t, int64_t>& p2) {
+            auto ret = NormalizedKeyComparer::compare_keys(keys[p1.first]->key(row(p1.first, p1.second)), keys[p2.first]->key(row(p2.first, p2.second)));
+            return ret > 0 || (ret == 0 && p1.first > p2.first);
+        };
+        std::priority_queue<std::pair<int32_t, int64_t>, std::vector<std::pair<int32_t, int64_t>>, decltype(later)> heap(later);
+        for (int32_t c = 0; c < num_batches; c++) {
+            if (batches[c]->num_rows() > 0) {
+                heap.emplace(c, 0);
+            }
+        }
+        while (!heap.empty()) {
+            auto next = heap.top();
+            heap.pop();
+            *chunks_out++ = next.first;
+            *rows_out++ = row(next.first, next.second);
+            if (++next.second < batches[next.first]->num_rows()) {
+                heap.push(next);
+            }
+        }
+
+        index_out->chunks = std::make_shared<arrow::Int32Array>(num_rows, chunks_buffer);
+        index_out->rows = std::make_shared<arrow::Int64Array>(num_rows, rows_buffer);
+        return arrow::Status::OK();
+    }
+}
+
+#endif //MARROW_CHUNKED_INDEX_H
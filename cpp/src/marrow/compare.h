@@ -5,8 +5,11 @@
 #ifndef CPP_COMPARE_H
 #define CPP_COMPARE_H
 
+#include <type_traits>
+#include <vector>
 #include <arrow/array.h>
 #include <arrow/record_batch.h>
+#include <marrow/dictionary_rank.h>
 #include <marrow/string_array.h>
 
 namespace marrow {
@@ -14,6 +17,21 @@ namespace marrow {
     public:
         virtual bool lt(int64_t index1, int64_t index2) const = 0;
         virtual bool gt(int64_t index1, int64_t index2) const = 0;
+
+        /**
+         * Three way compare: less than, equal to or greater than 0 as row index1 orders before, with or after index2.
+         */
+        virtual int cmp(int64_t index1, int64_t index2) const = 0;
+
+        /**
+         * Compare the pairs (indices1[i], indices2[i]) into out[i] as -1, 0 or 1, with one virtual call for all pairs.
+         */
+        virtual void cmp_batch(const int64_t* indices1, const int64_t* indices2, int64_t length, int8_t* out) const {
+            for (int64_t i = 0; i < length; i++) {
+                auto ret = cmp(indices1[i], indices2[i]);
+                out[i] = static_cast<int8_t>((ret > 0) - (ret < 0));
+            }
+        }
     };
 
     template<typename TArray = arrow::Int32Array>
@@ -32,6 +50,23 @@ namespace marrow {
             auto v2 = _array2->Value(index2);
             return v1 > v2;
         }
+        int cmp(int64_t index1, int64_t index2) const final {
+            auto v1 = _array1->Value(index1);
+            auto v2 = _array2->Value(index2);
+            return static_cast<int>(v2 < v1) - static_cast<int>(v1 < v2);
+        }
+        /**
+         * Branch free over the raw values, which the compiler can vectorize with gathers.
+         */
+        void cmp_batch(const int64_t* indices1, const int64_t* indices2, int64_t length, int8_t* out) const final {
+            auto values1 = _array1->raw_values();
+            auto values2 = _array2->raw_values();
+            for (int64_t i = 0; i < length; i++) {
+                auto v1 = values1[indices1[i]];
+                auto v2 = values2[indices2[i]];
+                out[i] = static_cast<int8_t>(static_cast<int>(v2 < v1) - static_cast<int>(v1 < v2));
+            }
+        }
         private:
             std::shared_ptr<TArray> _array1, _array2;
     };
@@ -47,6 +82,10 @@ namespace marrow {
         bool gt(int64_t index1, int64_t index2) const final {
             return _array1->Value(index1) > _array2->Value(index2);
         }
+        int cmp(int64_t index1, int64_t index2) const final {
+            auto ret = _array1->Value(index1).compare(_array2->Value(index2));
+            return (ret > 0) - (ret < 0);
+        }
     private:
         std::shared_ptr<IStringArray> _array1, _array2;
     };
@@ -76,16 +115,269 @@ namespace marrow {
             return _comparer->gt(index1, index2);
         }
 
+        int cmp(int64_t index1, int64_t index2) const final {
+            bool null1 = _array1->IsNull(index1), null2 = _array2->IsNull(index2);
+            if (null1 || null2) {
+                return static_cast<int>(null2) - static_cast<int>(null1);
+            }
+            return _comparer->cmp(index1, index2);
+        }
+
+        /**
+         * Compares the pairs with a null here and passes the others to the wrapped comparer in one batch, as the values
+         * behind a null, e.g. a dictionary code, may not be valid.
+         */
+        void cmp_batch(const int64_t* indices1, const int64_t* indices2, int64_t length, int8_t* out) const final {
+            std::vector<int64_t> valid, valid1, valid2;
+            for (int64_t i = 0; i < length; i++) {
+                bool null1 = _array1->IsNull(indices1[i]), null2 = _array2->IsNull(indices2[i]);
+                if (null1 || null2) {
+                    out[i] = static_cast<int8_t>(static_cast<int>(null2) - static_cast<int>(null1));
+                }
+                else {
+                    valid.push_back(i);
+                    valid1.push_back(indices1[i]);
+                    valid2.push_back(indices2[i]);
+                }
+            }
+            std::vector<int8_t> valid_out(valid.size());
+            _comparer->cmp_batch(valid1.data(), valid2.data(), static_cast<int64_t>(valid.size()), valid_out.data());
+            for (size_t v = 0; v < valid.size(); v++) {
+                out[valid[v]] = valid_out[v];
+            }
+        }
+
     private:
         std::shared_ptr<arrow::Array> _array1, _array2;
         std::shared_ptr<IComparer> _comparer;
     };
 
-    static inline std::shared_ptr<IComparer> make_array_comparer(std::shared_ptr<arrow::Array> array1, std::shared_ptr<arrow::Array> array2) {
+    /**
+     * Three way compare of two numbers by value. Integers of different signedness are compared exactly, other pairs
+     * by the usual arithmetic conversions.
+     */
+    template<typename T1, typename T2>
+    int compare_values(T1 v1, T2 v2) {
+        if constexpr (std::is_integral<T1>::value && std::is_integral<T2>::value && std::is_signed<T1>::value != std::is_signed<T2>::value) {
+            if constexpr (std::is_signed<T1>::value) {
+                if (v1 < 0) {
+                    return -1;
+                }
+            }
+            else if (v2 < 0) {
+                return 1;
+            }
+            return compare_values(static_cast<uint64_t>(v1), static_cast<uint64_t>(v2));
+        }
+        else {
+            return static_cast<int>(v2 < v1) - static_cast<int>(v1 < v2);
+        }
+    }
+
+    /**
+     * Compares two numeric arrays of different types, e.g. an int32 and an int64 key, without converting either.
+     */
+    template<typename TArray1, typename TArray2>
+    class MixedComparer : public IComparer {
+    public:
+        MixedComparer(std::shared_ptr<arrow::Array> array1, std::shared_ptr<arrow::Array> array2) : _array1(std::static_pointer_cast<TArray1>(array1)), _array2(std::static_pointer_cast<TArray2>(array2)) {
+        }
+
+        bool lt(int64_t index1, int64_t index2) const final {
+            return cmp(index1, index2) < 0;
+        }
+        bool gt(int64_t index1, int64_t index2) const final {
+            return cmp(index1, index2) > 0;
+        }
+        int cmp(int64_t index1, int64_t index2) const final {
+            return compare_values(_array1->Value(index1), _array2->Value(index2));
+        }
+    private:
+        std::shared_ptr<TArray1> _array1;
+        std::shared_ptr<TArray2> _array2;
+    };
+
+    /**
+     * Compares two string dictionary columns by the ranks of their codes in the order of both dictionaries, which are
+     * computed once (or taken from the cache if there is one), instead of by their strings.
+     */
+    template<typename TIndexArray1, typename TIndexArray2>
+    class DictionaryRankComparer : public IComparer {
+    public:
+        DictionaryRankComparer(std::shared_ptr<arrow::Array> array1, std::shared_ptr<arrow::Array> array2, DictionaryRanksCache* cache = nullptr)
+                : _indices1(indices<TIndexArray1>(array1)), _indices2(indices<TIndexArray2>(array2)),
+                  _codes1(_indices1->raw_values()), _codes2(_indices2->raw_values()),
+                  _ranks(dictionary_ranks(dictionary(array1), dictionary(array2), cache)),
+                  _ranks1(_ranks->ranks1.data()), _ranks2(_ranks->ranks2.data()) {
+        }
+
+        bool lt(int64_t index1, int64_t index2) const final {
+            return rank1(index1) < rank2(index2);
+        }
+        bool gt(int64_t index1, int64_t index2) const final {
+            return rank1(index1) > rank2(index2);
+        }
+        int cmp(int64_t index1, int64_t index2) const final {
+            auto r1 = rank1(index1), r2 = rank2(index2);
+            return static_cast<int>(r2 < r1) - static_cast<int>(r1 < r2);
+        }
+        void cmp_batch(const int64_t* indices1, const int64_t* indices2, int64_t length, int8_t* out) const final {
+            for (int64_t i = 0; i < length; i++) {
+                auto r1 = rank1(indices1[i]), r2 = rank2(indices2[i]);
+                out[i] = static_cast<int8_t>(static_cast<int>(r2 < r1) - static_cast<int>(r1 < r2));
+            }
+        }
+
+    private:
+        template<typename TIndexArray>
+        static std::shared_ptr<TIndexArray> indices(const std::shared_ptr<arrow::Array>& array) {
+            return std::static_pointer_cast<TIndexArray>(std::static_pointer_cast<arrow::DictionaryArray>(array)->indices());
+        }
+
+        static std::shared_ptr<arrow::Array> dictionary(const std::shared_ptr<arrow::Array>& array) {
+            return std::static_pointer_cast<arrow::DictionaryArray>(array)->dictionary();
+        }
+
+        uint32_t rank1(int64_t index) const {
+            return _ranks1[_codes1[index]];
+        }
+
+        uint32_t rank2(int64_t index) const {
+            return _ranks2[_codes2[index]];
+        }
+
+        std::shared_ptr<TIndexArray1> _indices1;
+        std::shared_ptr<TIndexArray2> _indices2;
+        const typename TIndexArray1::value_type* _codes1;
+        const typename TIndexArray2::value_type* _codes2;
+        std::shared_ptr<const DictionaryRanks> _ranks;
+        const uint32_t* _ranks1;
+        const uint32_t* _ranks2;
+    };
+
+    /**
+     * Call f with the dictionary index array type of a string dictionary array.
+     */
+    template<typename TFunc>
+    auto visit_dictionary_index_type(const arrow::Array& array, TFunc f) {
+        auto& dict_type = static_cast<const arrow::DictionaryType&>(*array.type());
+        switch (dict_type.index_type()->id()) {
+            case arrow::Type::INT8:
+                return f(static_cast<arrow::Int8Array*>(nullptr));
+            case arrow::Type::INT16:
+                return f(static_cast<arrow::Int16Array*>(nullptr));
+            case arrow::Type::INT32:
+                return f(static_cast<arrow::Int32Array*>(nullptr));
+            case arrow::Type::INT64:
+                return f(static_cast<arrow::Int64Array*>(nullptr));
+            default:
+                throw std::runtime_error("Invalid dict index type " + dict_type.index_type()->ToString());
+        }
+    }
+
+    static inline std::shared_ptr<IComparer> make_dictionary_comparer(const std::shared_ptr<arrow::Array>& array1, const std::shared_ptr<arrow::Array>& array2, DictionaryRanksCache* ranks = nullptr) {
+        return visit_dictionary_index_type(*array1, [&](auto* index1) {
+            return visit_dictionary_index_type(*array2, [&](auto* index2) -> std::shared_ptr<IComparer> {
+                typedef std::remove_pointer_t<decltype(index1)> TIndexArray1;
+                typedef std::remove_pointer_t<decltype(index2)> TIndexArray2;
+                return std::make_shared<DictionaryRankComparer<TIndexArray1, TIndexArray2>>(array1, array2, ranks);
+            });
+        });
+    }
+
+    /**
+     * The classes of key types which compare with each other: integers of any width and sign, floating point numbers,
+     * and strings, large strings and string dictionaries.
+     */
+    enum class KeyKind {Other, Integer, Floating, String};
+
+    static inline KeyKind key_kind(const arrow::DataType& type) {
+        switch (type.id()) {
+            case arrow::Type::INT8:
+            case arrow::Type::INT16:
+            case arrow::Type::INT32:
+            case arrow::Type::INT64:
+            case arrow::Type::UINT8:
+            case arrow::Type::UINT16:
+            case arrow::Type::UINT32:
+            case arrow::Type::UINT64:
+                return KeyKind::Integer;
+            case arrow::Type::FLOAT:
+            case arrow::Type::DOUBLE:
+                return KeyKind::Floating;
+            case arrow::Type::STRING:
+            case arrow::Type::LARGE_STRING:
+                return KeyKind::String;
+            case arrow::Type::DICTIONARY:
+                return static_cast<const arrow::DictionaryType&>(type).value_type()->id() == arrow::Type::STRING ? KeyKind::String : KeyKind::Other;
+            default:
+                return KeyKind::Other;
+        }
+    }
+
+    static inline bool are_comparable_types(const arrow::DataType& type1, const arrow::DataType& type2) {
+        auto kind = key_kind(type1);
+        return type1.Equals(type2) || (kind != KeyKind::Other && kind == key_kind(type2));
+    }
+
+    /**
+     * Call f with the array cast to its numeric array type, for the integer and floating point key kinds.
+     */
+    template<typename TFunc>
+    auto visit_numeric_array(const std::shared_ptr<arrow::Array>& array, TFunc f) {
+        switch (array->type_id()) {
+            case arrow::Type::INT8:
+                return f(std::static_pointer_cast<arrow::Int8Array>(array));
+            case arrow::Type::INT16:
+                return f(std::static_pointer_cast<arrow::Int16Array>(array));
+            case arrow::Type::INT32:
+                return f(std::static_pointer_cast<arrow::Int32Array>(array));
+            case arrow::Type::INT64:
+                return f(std::static_pointer_cast<arrow::Int64Array>(array));
+            case arrow::Type::UINT8:
+                return f(std::static_pointer_cast<arrow::UInt8Array>(array));
+            case arrow::Type::UINT16:
+                return f(std::static_pointer_cast<arrow::UInt16Array>(array));
+            case arrow::Type::UINT32:
+                return f(std::static_pointer_cast<arrow::UInt32Array>(array));
+            case arrow::Type::UINT64:
+                return f(std::static_pointer_cast<arrow::UInt64Array>(array));
+            case arrow::Type::FLOAT:
+                return f(std::static_pointer_cast<arrow::FloatArray>(array));
+            case arrow::Type::DOUBLE:
+                return f(std::static_pointer_cast<arrow::DoubleArray>(array));
+            default:
+                throw std::runtime_error("Not a numeric array: " + array->type()->ToString());
+        }
+    }
+
+    static inline std::shared_ptr<IComparer> make_mixed_comparer(const std::shared_ptr<arrow::Array>& array1, const std::shared_ptr<arrow::Array>& array2) {
+        return visit_numeric_array(array1, [&array2](auto typed1) {
+            return visit_numeric_array(array2, [&typed1](auto typed2) -> std::shared_ptr<IComparer> {
+                typedef typename decltype(typed1)::element_type TArray1;
+                typedef typename decltype(typed2)::element_type TArray2;
+                return std::make_shared<MixedComparer<TArray1, TArray2>>(typed1, typed2);
+            });
+        });
+    }
+
+    /**
+     * Comparer of two key columns. Their types must be equal or of the same KeyKind, in which case numbers are compared
+     * by value and strings by their bytes whatever their representation. String dictionaries are compared by ranks
+     * from the cache if there is one.
+     */
+    static inline std::shared_ptr<IComparer> make_array_comparer(std::shared_ptr<arrow::Array> array1, std::shared_ptr<arrow::Array> array2, DictionaryRanksCache* ranks = nullptr) {
         std::shared_ptr<IComparer> ret;
-        if (!array1->type()->Equals(array2->type())) {
+        if (!are_comparable_types(*array1->type(), *array2->type())) {
             throw std::runtime_error("Incompatible array tipes for compare on columns: " + array1->type()->ToString() + " != " + array2->type()->ToString());
         }
+        if (!array1->type()->Equals(array2->type()) && key_kind(*array1->type()) != KeyKind::String) {
+            ret = make_mixed_comparer(array1, array2);
+            if (array1->null_count() != 0 || array2->null_count() != 0) {
+                ret = std::make_shared<NullComparer>(array1, array2, ret);
+            }
+            return ret;
+        }
         switch (array1->type_id()) {
             case arrow::Type::INT8:
                 ret = std::make_shared<SimpleComparer<arrow::Int8Array>>(array1, array2);
@@ -120,9 +412,16 @@ namespace marrow {
             case arrow::Type::DOUBLE:
                 ret = std::make_shared<SimpleComparer<arrow::DoubleArray>>(array1, array2);
                 break;
+            case arrow::Type::DICTIONARY:
+                if (array2->type_id() == arrow::Type::DICTIONARY && key_kind(*array1->type()) == KeyKind::String) {
+                    ret = make_dictionary_comparer(array1, array2, ranks);
+                }
+                else {
+                    ret = std::make_shared<StringComparer>(make_istring_array(array1), make_istring_array(array2));
+                }
+                break;
             case arrow::Type::STRING:
-            case arrow::Type::LARGE_STRING:
-            case arrow::Type::DICTIONARY: {
+            case arrow::Type::LARGE_STRING: {
                 auto string_array1 = make_istring_array(array1);
                 auto string_array2 = make_istring_array(array2);
                 ret = std::make_shared<StringComparer>(string_array1, string_array2);
@@ -143,32 +442,53 @@ namespace marrow {
 
         }
         bool lt(int64_t index1, int64_t index2) const final {
-            for (auto c: _comparers) {
-                if (c->lt(index1, index2)) {
-                    return true;
-                }
-                if (c->gt(index2, index1)) {
-                    return false;
+            return cmp(index1, index2) < 0;
+        }
+        bool gt(int64_t index1, int64_t index2) const final {
+            return cmp(index1, index2) > 0;
+        }
+        int cmp(int64_t index1, int64_t index2) const final {
+            for (auto& c: _comparers) {
+                auto ret = c->cmp(index1, index2);
+                if (ret != 0) {
+                    return ret;
                 }
             }
-            return false;
+            return 0;
         }
-        bool gt(int64_t index1, int64_t index2) const final {
-            for (auto c: _comparers) {
-                if (c->gt(index1, index2)) {
-                    return true;
+        /**
+         * Compares all pairs on the first column, and only the pairs still tied on each further column.
+         */
+        void cmp_batch(const int64_t* indices1, const int64_t* indices2, int64_t length, int8_t* out) const final {
+            _comparers[0]->cmp_batch(indices1, indices2, length, out);
+            std::vector<int64_t> ties, ties1, ties2;
+            std::vector<int8_t> tie_out;
+            for (size_t c = 1; c < _comparers.size(); c++) {
+                ties.clear();
+                ties1.clear();
+                ties2.clear();
+                for (int64_t i = 0; i < length; i++) {
+                    if (out[i] == 0) {
+                        ties.push_back(i);
+                        ties1.push_back(indices1[i]);
+                        ties2.push_back(indices2[i]);
+                    }
+                }
+                if (ties.empty()) {
+                    break;
                 }
-                if (c->lt(index1, index2)) {
-                    return false;
+                tie_out.resize(ties.size());
+                _comparers[c]->cmp_batch(ties1.data(), ties2.data(), static_cast<int64_t>(ties.size()), tie_out.data());
+                for (size_t t = 0; t < ties.size(); t++) {
+                    out[ties[t]] = tie_out[t];
                 }
             }
-            return false;
         }
     private:
         std::vector<std::shared_ptr<IComparer>> _comparers;
     };
 
-    static inline std::shared_ptr<IComparer> make_comparer(std::shared_ptr<arrow::RecordBatch> batch1, std::shared_ptr<arrow::RecordBatch> batch2, std::vector<std::string> columns) {
+    static inline std::shared_ptr<IComparer> make_comparer(std::shared_ptr<arrow::RecordBatch> batch1, std::shared_ptr<arrow::RecordBatch> batch2, std::vector<std::string> columns, DictionaryRanksCache* ranks = nullptr) {
         std::vector<std::shared_ptr<IComparer>> comparer;
         for (auto& c: columns) {
             auto array1 = batch1->GetColumnByName(c);
@@ -179,7 +499,7 @@ namespace marrow {
             if (!array2) {
                 throw std::runtime_error("Column missing from batch2: " + c);
             }
-            comparer.push_back(make_array_comparer(array1, array2));
+            comparer.push_back(make_array_comparer(array1, array2, ranks));
         }
         if (comparer.size() == 1) {
             return comparer[0];
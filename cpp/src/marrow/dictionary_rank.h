@@ -0,0 +1,164 @@
+#ifndef MARROW_DICTIONARY_RANK_H
+#define MARROW_DICTIONARY_RANK_H
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <utility>
+#include <vector>
+#include <arrow/array.h>
+
+namespace marrow {
+
+    /**
+     * The rank of every dictionary entry in string order; equal strings get the same rank. Rows of a dictionary column
+     * can then be ordered by comparing the small integer ranks of their codes instead of the strings.
+     */
+    static inline std::vector<uint32_t> dictionary_ranks(const arrow::StringArray& dictionary) {
+        std::vector<uint32_t> order(dictionary.length());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&dictionary](uint32_t i1, uint32_t i2) {
+            return dictionary.GetView(i1) < dictionary.GetView(i2);
+        });
+        std::vector<uint32_t> ranks(dictionary.length());
+        uint32_t rank = 0;
+        for (size_t i = 0; i < order.size(); i++) {
+            if (i > 0 && dictionary.GetView(order[i - 1]) != dictionary.GetView(order[i])) {
+                rank++;
+            }
+            ranks[order[i]] = rank;
+        }
+        return ranks;
+    }
+
+    /**
+     * The ranks of the entries of two dictionaries in the string order of both together, where equal strings of
+     * either dictionary get the same rank. Codes of two dictionary columns with different dictionaries can then be
+     * compared as integers. Returns for every rank a (dictionary, entry) with its string: 0 for dictionary1 and 1 for
+     * dictionary2, so the ranks are the codes into the unified dictionary of those strings.
+     */
+    static inline std::vector<std::pair<int, uint32_t>> unify_dictionary_ranks(const arrow::StringArray& dictionary1, const arrow::StringArray& dictionary2, std::vector<uint32_t>* ranks1, std::vector<uint32_t>* ranks2) {
+        auto sorted = [](const arrow::StringArray& dictionary) {
+            std::vector<uint32_t> order(dictionary.length());
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&dictionary](uint32_t i1, uint32_t i2) {
+                return dictionary.GetView(i1) < dictionary.GetView(i2);
+            });
+            return order;
+        };
+        auto order1 = sorted(dictionary1);
+        auto order2 = sorted(dictionary2);
+        ranks1->resize(dictionary1.length());
+        ranks2->resize(dictionary2.length());
+        std::vector<std::pair<int, uint32_t>> entries;
+        auto value = [&](int dictionary, uint32_t entry) {
+            return dictionary == 0 ? dictionary1.GetView(entry) : dictionary2.GetView(entry);
+        };
+        size_t i1 = 0, i2 = 0;
+        while (i1 < order1.size() || i2 < order2.size()) {
+            int dictionary = i2 == order2.size() || (i1 < order1.size() && dictionary1.GetView(order1[i1]) <= dictionary2.GetView(order2[i2])) ? 0 : 1;
+            auto entry = dictionary == 0 ? order1[i1++] : order2[i2++];
+            if (entries.empty() || value(entries.back().first, entries.back().second) != value(dictionary, entry)) {
+                entries.emplace_back(dictionary, entry);
+            }
+            (dictionary == 0 ? *ranks1 : *ranks2)[entry] = static_cast<uint32_t>(entries.size() - 1);
+        }
+        return entries;
+    }
+
+    /**
+     * Whether two dictionaries are one, as the dictionary of every slice or take of a dictionary column is, although
+     * each DictionaryArray boxes it into its own array.
+     */
+    static inline bool is_same_dictionary(const arrow::Array& dictionary1, const arrow::Array& dictionary2) {
+        return dictionary1.data() == dictionary2.data();
+    }
+
+    /**
+     * The ranks of the dictionaries of two string dictionary columns in the order of both. A dictionary shared by
+     * both columns is ranked once with dictionary_ranks and has no entries, as it is its own unified dictionary.
+     */
+    struct DictionaryRanks {
+        std::vector<uint32_t> ranks1;
+        std::vector<uint32_t> ranks2;
+        std::vector<std::pair<int, uint32_t>> entries;
+    };
+
+    static inline std::shared_ptr<const DictionaryRanks> make_dictionary_ranks(const std::shared_ptr<arrow::Array>& dictionary1, const std::shared_ptr<arrow::Array>& dictionary2) {
+        auto ret = std::make_shared<DictionaryRanks>();
+        auto& values1 = static_cast<const arrow::StringArray&>(*dictionary1);
+        if (is_same_dictionary(*dictionary1, *dictionary2)) {
+            ret->ranks1 = dictionary_ranks(values1);
+            ret->ranks2 = ret->ranks1;
+        }
+        else {
+            ret->entries = unify_dictionary_ranks(values1, static_cast<const arrow::StringArray&>(*dictionary2), &ret->ranks1, &ret->ranks2);
+        }
+        return ret;
+    }
+
+    /**
+     * The DictionaryRanks of the pairs of dictionaries a join has seen, so that its comparers and the unification of
+     * its outer keys rank each pair once. Not safe for concurrent use.
+     */
+    class DictionaryRanksCache {
+    public:
+        std::shared_ptr<const DictionaryRanks> get(const std::shared_ptr<arrow::Array>& dictionary1, const std::shared_ptr<arrow::Array>& dictionary2) {
+            for (auto& entry: _entries) {
+                if (entry.dictionary1->data() == dictionary1->data() && entry.dictionary2->data() == dictionary2->data()) {
+                    return entry.ranks;
+                }
+            }
+            _entries.push_back(Entry{dictionary1, dictionary2, make_dictionary_ranks(dictionary1, dictionary2)});
+            return _entries.back().ranks;
+        }
+
+    private:
+        struct Entry {
+            //Held so that the data pointers are not reused by other dictionaries
+            std::shared_ptr<arrow::Array> dictionary1;
+            std::shared_ptr<arrow::Array> dictionary2;
+            std::shared_ptr<const DictionaryRanks> ranks;
+        };
+
+        std::vector<Entry> _entries;
+    };
+
+    /**
+     * The ranks of two dictionaries from the cache if there is one.
+     */
+    static inline std::shared_ptr<const DictionaryRanks> dictionary_ranks(const std::shared_ptr<arrow::Array>& dictionary1, const std::shared_ptr<arrow::Array>& dictionary2, DictionaryRanksCache* cache) {
+        return cache ? cache->get(dictionary1, dictionary2) : make_dictionary_ranks(dictionary1, dictionary2);
+    }
+
+    static inline bool is_string_dictionary(const arrow::Array& array) {
+        return array.type_id() == arrow::Type::DICTIONARY &&
+            static_cast<const arrow::DictionaryType&>(*array.type()).value_type()->id() == arrow::Type::STRING;
+    }
+
+    /**
+     * Call f with the typed indices of a string dictionary array and the ranks of its dictionary.
+     */
+    template<typename TFunc>
+    arrow::Status visit_dictionary_ranks(const arrow::Array& array, TFunc f) {
+        auto& dict_array = static_cast<const arrow::DictionaryArray&>(array);
+        auto ranks = dictionary_ranks(static_cast<const arrow::StringArray&>(*dict_array.dictionary()));
+        auto indices = dict_array.indices();
+        switch (indices->type_id()) {
+            case arrow::Type::INT8:
+                f(static_cast<const arrow::Int8Array&>(*indices), ranks);
+                break;
+            case arrow::Type::INT16:
+                f(static_cast<const arrow::Int16Array&>(*indices), ranks);
+                break;
+            case arrow::Type::INT32:
+                f(static_cast<const arrow::Int32Array&>(*indices), ranks);
+                break;
+            default:
+                return arrow::Status::Invalid("Invalid dict index type " + indices->type()->ToString());
+        }
+        return arrow::Status::OK();
+    }
+}
+
+#endif //MARROW_DICTIONARY_RANK_H
@@ -0,0 +1,364 @@
+#ifndef MARROW_EXTERNAL_SORT_H
+#define MARROW_EXTERNAL_SORT_H
+
+#include <cstdio>
+#include <queue>
+#include <random>
+#include <arrow/io/file.h>
+#include <arrow/ipc/reader.h>
+#include <arrow/ipc/writer.h>
+#include <arrow/record_batch.h>
+#include "marrow/chunked_index.h"
+#include "marrow/normalized_key.h"
+#include "marrow/sort.h"
+
+namespace marrow {
+
+    /**
+     * Number of rows per batch of the spilled runs and of the merged output.
+     */
+    constexpr int64_t external_sort_batch_rows = 64 * 1024;
+
+    /**
+     * The size of the buffers an array references, which for slices is more than the slice itself.
+     */
+    static int64_t array_memory_size(const arrow::Array& array) {
+        if (array.type_id() == arrow::Type::DICTIONARY) {
+            auto& dict_array = static_cast<const arrow::DictionaryArray&>(array);
+            return array_memory_size(*dict_array.indices()) + array_memory_size(*dict_array.dictionary());
+        }
+        int64_t ret = 0;
+        for (auto& b: array.data()->buffers) {
+            if (b) {
+                ret += b->size();
+            }
+        }
+        for (auto& c: array.data()->child_data) {
+            ret += array_memory_size(*arrow::MakeArray(c));
+        }
+        return ret;
+    }
+
+    /**
+     * A sorted run of an external sort, read back one batch at a time.
+     */
+    class ISortedRun {
+    public:
+        virtual ~ISortedRun() = default;
+        virtual int num_batches() const = 0;
+        virtual arrow::Status read_batch(int i, std::shared_ptr<arrow::RecordBatch>* batch_out) = 0;
+    };
+
+    /**
+     * A run held as its input batches and their chunked index in sort order. Every batch is gathered when it is read,
+     * so the sorted copy of the run is never in memory as a whole.
+     */
+    class MemorySortedRun : public ISortedRun {
+    public:
+        MemorySortedRun(std::shared_ptr<arrow::Schema> schema, std::vector<std::shared_ptr<arrow::RecordBatch>> batches, ChunkedIndex index, int64_t batch_rows,
+                        arrow::MemoryPool* pool = arrow::default_memory_pool())
+                : _schema(std::move(schema)), _batches(std::move(batches)), _index(std::move(index)), _batch_rows(batch_rows), _pool(pool) {
+        }
+
+        int num_batches() const final {
+            return static_cast<int>((_index.length() + _batch_rows - 1) / _batch_rows);
+        }
+
+        arrow::Status read_batch(int i, std::shared_ptr<arrow::RecordBatch>* batch_out) final {
+            ChunkedIndex slice;
+            slice.chunks = std::static_pointer_cast<arrow::Int32Array>(_index.chunks->Slice(i * _batch_rows, _batch_rows));
+            slice.rows = std::static_pointer_cast<arrow::Int64Array>(_index.rows->Slice(i * _batch_rows, _batch_rows));
+            return batches_by_index(_schema, _batches, slice, batch_out, 1, _pool);
+        }
+
+    private:
+        std::shared_ptr<arrow::Schema> _schema;
+        std::vector<std::shared_ptr<arrow::RecordBatch>> _batches;
+        ChunkedIndex _index;
+        int64_t _batch_rows;
+        arrow::MemoryPool* _pool;
+    };
+
+    /**
+     * A run spilled to an Arrow IPC file, which is removed when the run is destroyed.
+     */
+    class FileSortedRun : public ISortedRun {
+    public:
+        ~FileSortedRun() override {
+            _reader.reset();
+            _file.reset();
+            std::remove(_path.c_str());
+        }
+
+        /**
+         * Write the batches of a run of at least one batch, one batch at a time. The file holds one dictionary per
+         * column, so the batches must have equal dictionaries, as those gathered from a MemorySortedRun do.
+         */
+        static arrow::Status write(const std::string& path, ISortedRun& source, std::unique_ptr<ISortedRun>* run_out) {
+            std::unique_ptr<FileSortedRun> run(new FileSortedRun(path));
+            std::shared_ptr<arrow::io::FileOutputStream> stream;
+            ARROW_RETURN_NOT_OK(arrow::io::FileOutputStream::Open(path, &stream));
+            std::shared_ptr<arrow::ipc::RecordBatchWriter> writer;
+            for (int i = 0; i < source.num_batches(); i++) {
+                std::shared_ptr<arrow::RecordBatch> batch;
+                ARROW_RETURN_NOT_OK(source.read_batch(i, &batch));
+                if (!writer) {
+                    ARROW_RETURN_NOT_OK(arrow::ipc::RecordBatchFileWriter::Open(stream.get(), batch->schema(), &writer));
+                }
+                ARROW_RETURN_NOT_OK(writer->WriteRecordBatch(*batch));
+            }
+            ARROW_RETURN_NOT_OK(writer->Close());
+            ARROW_RETURN_NOT_OK(stream->Close());
+
+            ARROW_RETURN_NOT_OK(arrow::io::ReadableFile::Open(path, &run->_file));
+            ARROW_RETURN_NOT_OK(arrow::ipc::RecordBatchFileReader::Open(run->_file.get(), &run->_reader));
+            *run_out = std::move(run);
+            return arrow::Status::OK();
+        }
+
+        int num_batches() const final {
+            return _reader->num_record_batches();
+        }
+
+        arrow::Status read_batch(int i, std::shared_ptr<arrow::RecordBatch>* batch_out) final {
+            return _reader->ReadRecordBatch(i, batch_out);
+        }
+
+    private:
+        FileSortedRun(std::string path) : _path(std::move(path)) {}
+
+        std::string _path;
+        std::shared_ptr<arrow::io::ReadableFile> _file;
+        std::shared_ptr<arrow::ipc::RecordBatchFileReader> _reader;
+    };
+
+    /**
+     * Replace the dictionary columns of the batches which do not share one dictionary by slices of one column with
+     * the unified dictionary, so that the batches gathered from them keep it instead of unifying the dictionaries
+     * again for every batch.
+     */
+    static arrow::Status share_dictionaries(std::vector<std::shared_ptr<arrow::RecordBatch>>* batches, arrow::MemoryPool* pool) {
+        auto fields = (*batches)[0]->schema()->fields();
+        ChunkedIndex all_rows;
+        for (size_t i = 0; i < fields.size(); i++) {
+            if (fields[i]->type()->id() != arrow::Type::DICTIONARY) {
+                continue;
+            }
+            std::vector<std::shared_ptr<arrow::Array>> chunks;
+            bool same_dictionary = true;
+            for (auto& b: *batches) {
+                chunks.push_back(b->column(i));
+                same_dictionary = same_dictionary && is_same_dictionary(*std::static_pointer_cast<arrow::DictionaryArray>(chunks.back())->dictionary(),
+                                                                        *std::static_pointer_cast<arrow::DictionaryArray>(chunks[0])->dictionary());
+            }
+            if (same_dictionary) {
+                continue;
+            }
+            if (!all_rows.rows) {
+                arrow::Int32Builder chunk_builder(pool);
+                arrow::Int64Builder row_builder(pool);
+                for (size_t c = 0; c < batches->size(); c++) {
+                    for (int64_t row = 0; row < (*batches)[c]->num_rows(); row++) {
+                        ARROW_RETURN_NOT_OK(chunk_builder.Append(static_cast<int32_t>(c)));
+                        ARROW_RETURN_NOT_OK(row_builder.Append(row));
+                    }
+                }
+                std::shared_ptr<arrow::Array> array;
+                ARROW_RETURN_NOT_OK(chunk_builder.Finish(&array));
+                all_rows.chunks = std::static_pointer_cast<arrow::Int32Array>(array);
+                ARROW_RETURN_NOT_OK(row_builder.Finish(&array));
+                all_rows.rows = std::static_pointer_cast<arrow::Int64Array>(array);
+            }
+            std::shared_ptr<arrow::Array> unified;
+            ARROW_RETURN_NOT_OK(chunked_dictionary_by_index(all_rows, chunks, &unified, 1, pool));
+            fields[i] = arrow::field(fields[i]->name(), unified->type(), fields[i]->nullable(), fields[i]->metadata());
+            auto schema = arrow::schema(fields);
+            int64_t offset = 0;
+            for (auto& b: *batches) {
+                auto columns = b->columns();
+                columns[i] = unified->Slice(offset, b->num_rows());
+                offset += b->num_rows();
+                b = arrow::RecordBatch::Make(schema, b->num_rows(), columns);
+            }
+        }
+        return arrow::Status::OK();
+    }
+
+    /**
+     * Reads the k-way merge of sorted runs. Only the current batch of every run is in memory; equal keys keep the
+     * order of their runs.
+     */
+    class ExternalSortReader : public arrow::RecordBatchReader {
+    public:
+        ExternalSortReader(std::shared_ptr<arrow::Schema> schema, std::vector<std::string> columns, std::vector<std::unique_ptr<ISortedRun>> runs, int64_t batch_rows,
+                           arrow::MemoryPool* pool = arrow::default_memory_pool())
+                : _schema(std::move(schema)), _columns(std::move(columns)), _batch_rows(batch_rows), _pool(pool), _runs(runs.size()), _heap(Later{&_runs}) {
+            for (size_t r = 0; r < runs.size(); r++) {
+                _runs[r].run = std::move(runs[r]);
+            }
+        }
+
+        std::shared_ptr<arrow::Schema> schema() const override {
+            return _schema;
+        }
+
+        arrow::Status ReadNext(std::shared_ptr<arrow::RecordBatch>* batch) override {
+            if (!_started) {
+                _started = true;
+                for (size_t r = 0; r < _runs.size(); r++) {
+                    ARROW_RETURN_NOT_OK(next_batch(_runs[r]));
+                    if (_runs[r].batch) {
+                        _heap.push(r);
+                    }
+                }
+            }
+
+            std::vector<std::shared_ptr<arrow::RecordBatch>> batches;
+            arrow::Int32Builder chunks(_pool);
+            arrow::Int64Builder rows(_pool);
+            while (rows.length() < _batch_rows && !_heap.empty()) {
+                auto& state = _runs[_heap.top()];
+                auto r = _heap.top();
+                _heap.pop();
+                if (state.chunk < 0) {
+                    state.chunk = static_cast<int32_t>(batches.size());
+                    batches.push_back(state.batch);
+                }
+                ARROW_RETURN_NOT_OK(chunks.Append(state.chunk));
+                ARROW_RETURN_NOT_OK(rows.Append(state.row));
+                if (++state.row == state.batch->num_rows()) {
+                    ARROW_RETURN_NOT_OK(next_batch(state));
+                }
+                if (state.batch) {
+                    _heap.push(r);
+                }
+            }
+            for (auto& state: _runs) {
+                state.chunk = -1;
+            }
+            if (batches.empty()) {
+                *batch = nullptr;
+                return arrow::Status::OK();
+            }
+
+            ChunkedIndex index;
+            std::shared_ptr<arrow::Array> array;
+            ARROW_RETURN_NOT_OK(chunks.Finish(&array));
+            index.chunks = std::static_pointer_cast<arrow::Int32Array>(array);
+            ARROW_RETURN_NOT_OK(rows.Finish(&array));
+            index.rows = std::static_pointer_cast<arrow::Int64Array>(array);
+            return batches_by_index(_schema, batches, index, batch, 1, _pool);
+        }
+
+    private:
+        struct RunState {
+            std::unique_ptr<ISortedRun> run;
+            int next_batch = 0;
+            std::shared_ptr<arrow::RecordBatch> batch;
+            std::unique_ptr<NormalizedKeyComparer> keys;
+            int64_t row = 0;
+            /** Position of batch in the batches of the output being built, -1 if not in it yet */
+            int32_t chunk = -1;
+        };
+
+        struct Later {
+            const std::vector<RunState>* runs;
+
+            bool operator()(size_t r1, size_t r2) const {
+                auto& s1 = (*runs)[r1];
+                auto& s2 = (*runs)[r2];
+                auto ret = NormalizedKeyComparer::compare_keys(s1.keys->key(s1.row), s2.keys->key(s2.row));
+                return ret > 0 || (ret == 0 && r1 > r2);
+            }
+        };
+
+        arrow::Status next_batch(RunState& state) {
+            state.batch = nullptr;
+            state.keys = nullptr;
+            state.row = 0;
+            state.chunk = -1;
+            while (!state.batch && state.next_batch < state.run->num_batches()) {
+                ARROW_RETURN_NOT_OK(state.run->read_batch(state.next_batch++, &state.batch));
+                if (state.batch->num_rows() == 0) {
+                    state.batch = nullptr;
+                }
+            }
+            if (state.batch) {
+                state.keys.reset(new NormalizedKeyComparer(state.batch, _columns, true));
+            }
+            return arrow::Status::OK();
+        }
+
+        std::shared_ptr<arrow::Schema> _schema;
+        std::vector<std::string> _columns;
+        int64_t _batch_rows;
+        arrow::MemoryPool* _pool;
+        std::vector<RunState> _runs;
+        std::priority_queue<size_t, std::vector<size_t>, Later> _heap;
+        bool _started = false;
+    };
+
+    /**
+     * Sort the batches of input by the sort columns with bounded memory. Input is collected until it reaches
+     * memory_budget bytes, which is then sorted with make_chunked_index and spilled as an Arrow IPC file to
+     * spill_directory, gathered with batches_by_index batch_rows rows at a time. The last run stays in memory, and is
+     * gathered the same way while the returned reader k-way merges the runs; if the input fits in the budget nothing
+     * is spilled. The sort is stable.
+     *
+     * Peak memory is memory_budget plus the input batch which reaches it, the chunked index of a run (12 bytes a row),
+     * and a few batches of batch_rows rows: one being gathered, and while merging the current batch of every run and
+     * the output batch. A spilled run whose dictionary columns do not share a dictionary also holds their unified
+     * indices.
+     */
+    static arrow::Status external_sort(std::shared_ptr<arrow::RecordBatchReader> input, std::vector<std::string> sort_columns, int64_t memory_budget, const std::string& spill_directory,
+                                       std::shared_ptr<arrow::RecordBatchReader>* reader_out, int64_t batch_rows = external_sort_batch_rows, arrow::MemoryPool* pool = arrow::default_memory_pool()) {
+        auto schema = input->schema();
+        std::vector<std::unique_ptr<ISortedRun>> runs;
+        std::vector<std::shared_ptr<arrow::RecordBatch>> batches;
+        int64_t batches_size = 0;
+        std::random_device random;
+        auto run_prefix = spill_directory + "/marrow_run_" + std::to_string(random()) + "_";
+
+        auto sort_batches = [&](std::unique_ptr<ISortedRun>* run_out) {
+            ChunkedIndex index;
+            ARROW_RETURN_NOT_OK(make_chunked_index(batches, sort_columns, &index, 1, pool));
+            run_out->reset(new MemorySortedRun(schema, std::move(batches), std::move(index), batch_rows, pool));
+            batches.clear();
+            batches_size = 0;
+            return arrow::Status::OK();
+        };
+        while (true) {
+            std::shared_ptr<arrow::RecordBatch> batch;
+            ARROW_RETURN_NOT_OK(input->ReadNext(&batch));
+            if (!batch) {
+                break;
+            }
+            if (batch->num_rows() == 0) {
+                continue;
+            }
+            batches.push_back(batch);
+            for (auto& c: batch->columns()) {
+                batches_size += array_memory_size(*c);
+            }
+            if (batches_size >= memory_budget) {
+                ARROW_RETURN_NOT_OK(share_dictionaries(&batches, pool));
+                std::unique_ptr<ISortedRun> sorted;
+                ARROW_RETURN_NOT_OK(sort_batches(&sorted));
+                std::unique_ptr<ISortedRun> run;
+                ARROW_RETURN_NOT_OK(FileSortedRun::write(run_prefix + std::to_string(runs.size()) + ".arrow", *sorted, &run));
+                runs.push_back(std::move(run));
+            }
+        }
+        if (!batches.empty()) {
+            //The last run fits in the budget, so it stays in memory
+            std::unique_ptr<ISortedRun> sorted;
+            ARROW_RETURN_NOT_OK(sort_batches(&sorted));
+            runs.push_back(std::move(sorted));
+        }
+
+        *reader_out = std::make_shared<ExternalSortReader>(schema, sort_columns, std::move(runs), batch_rows, pool);
+        return arrow::Status::OK();
+    }
+}
+
+#endif //MARROW_EXTERNAL_SORT_H
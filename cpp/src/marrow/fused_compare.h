@@ -0,0 +1,368 @@
+#ifndef MARROW_FUSED_COMPARE_H
+#define MARROW_FUSED_COMPARE_H
+
+#include <tuple>
+#include <vector>
+#include <utility>
+#include <arrow/array.h>
+#include <arrow/record_batch.h>
+#include "marrow/compare.h"
+
+namespace marrow {
+
+    /**
+     * Non virtual three way compare of one key column. Nulls are ordered first, as in NullComparer. Whether a column
+     * has nulls is decided once at construction.
+     */
+    template<typename TArray>
+    class PrimitiveColumnComparer {
+    public:
+        PrimitiveColumnComparer(const std::shared_ptr<arrow::Array>& array1, const std::shared_ptr<arrow::Array>& array2)
+                : _array1(std::static_pointer_cast<TArray>(array1)), _array2(std::static_pointer_cast<TArray>(array2)),
+                  _values1(_array1->raw_values()), _values2(_array2->raw_values()),
+                  _has_nulls(array1->null_count() != 0 || array2->null_count() != 0) {
+        }
+
+        int cmp(int64_t index1, int64_t index2) const {
+            if (_has_nulls) {
+                bool null1 = _array1->IsNull(index1), null2 = _array2->IsNull(index2);
+                if (null1 || null2) {
+                    return static_cast<int>(null2) - static_cast<int>(null1);
+                }
+            }
+            auto v1 = _values1[index1];
+            auto v2 = _values2[index2];
+            return static_cast<int>(v2 < v1) - static_cast<int>(v1 < v2);
+        }
+
+    private:
+        std::shared_ptr<TArray> _array1, _array2;
+        const typename TArray::value_type* _values1;
+        const typename TArray::value_type* _values2;
+        bool _has_nulls;
+    };
+
+    /**
+     * The first 8 bytes of every string as a big endian number, padded with 0. If the prefixes of two strings differ,
+     * they order the strings; if they are equal the strings have to be compared.
+     */
+    template<typename TArray>
+    std::shared_ptr<std::vector<uint64_t>> string_prefixes(const TArray& array) {
+        auto ret = std::make_shared<std::vector<uint64_t>>(array.length());
+        for (int64_t i = 0; i < array.length(); i++) {
+            auto value = array.GetView(i);
+            uint64_t prefix = 0;
+            for (size_t c = 0; c < std::min<size_t>(8, value.size()); c++) {
+                prefix |= static_cast<uint64_t>(static_cast<uint8_t>(value[c])) << (56 - 8 * c);
+            }
+            (*ret)[i] = prefix;
+        }
+        return ret;
+    }
+
+    /**
+     * The string_prefixes of the string columns an operation compares, so that the comparers it builds compute them
+     * once per column. Arrays which share their offsets and data, e.g. a column and the column without its validity
+     * bitmap, share their prefixes. Not safe for concurrent use.
+     */
+    class StringPrefixCache {
+    public:
+        template<typename TArray>
+        std::shared_ptr<const std::vector<uint64_t>> get(const std::shared_ptr<TArray>& array) {
+            auto& data = *array->data();
+            for (auto& entry: _entries) {
+                auto& other = *entry.array->data();
+                if (other.buffers[1] == data.buffers[1] && other.buffers[2] == data.buffers[2] &&
+                    other.offset == data.offset && other.length == data.length) {
+                    return entry.prefixes;
+                }
+            }
+            _entries.push_back(Entry{array, string_prefixes(*array)});
+            return _entries.back().prefixes;
+        }
+
+    private:
+        struct Entry {
+            //Held so that the buffers are not reused by other arrays
+            std::shared_ptr<arrow::Array> array;
+            std::shared_ptr<const std::vector<uint64_t>> prefixes;
+        };
+
+        std::vector<Entry> _entries;
+    };
+
+    /**
+     * Compares the prefixes from the cache first if there is one, so most compares of selective keys do not touch the
+     * string data. Without a cache the strings are compared directly, which is cheaper for few compares, e.g. one
+     * linear scan.
+     */
+    template<typename TArray>
+    class StringColumnComparer {
+    public:
+        StringColumnComparer(const std::shared_ptr<arrow::Array>& array1, const std::shared_ptr<arrow::Array>& array2, StringPrefixCache* cache = nullptr)
+                : _array1(std::static_pointer_cast<TArray>(array1)), _array2(std::static_pointer_cast<TArray>(array2)),
+                  _prefixes1(cache ? cache->get(_array1) : nullptr), _prefixes2(cache ? cache->get(_array2) : nullptr),
+                  _prefix_values1(cache ? _prefixes1->data() : nullptr), _prefix_values2(cache ? _prefixes2->data() : nullptr),
+                  _has_nulls(array1->null_count() != 0 || array2->null_count() != 0) {
+        }
+
+        int cmp(int64_t index1, int64_t index2) const {
+            if (_has_nulls) {
+                bool null1 = _array1->IsNull(index1), null2 = _array2->IsNull(index2);
+                if (null1 || null2) {
+                    return static_cast<int>(null2) - static_cast<int>(null1);
+                }
+            }
+            if (_prefix_values1) {
+                auto prefix1 = _prefix_values1[index1];
+                auto prefix2 = _prefix_values2[index2];
+                if (prefix1 != prefix2) {
+                    return prefix1 < prefix2 ? -1 : 1;
+                }
+            }
+            auto ret = _array1->GetView(index1).compare(_array2->GetView(index2));
+            return (ret > 0) - (ret < 0);
+        }
+
+    private:
+        std::shared_ptr<TArray> _array1, _array2;
+        std::shared_ptr<const std::vector<uint64_t>> _prefixes1, _prefixes2;
+        const uint64_t* _prefix_values1;
+        const uint64_t* _prefix_values2;
+        bool _has_nulls;
+    };
+
+    /**
+     * Compares the ranks of the codes in the order of both dictionaries, which are computed once at construction, or
+     * taken from the cache if there is one.
+     */
+    template<typename TIndexArray>
+    class DictionaryColumnComparer {
+    public:
+        DictionaryColumnComparer(const std::shared_ptr<arrow::Array>& array1, const std::shared_ptr<arrow::Array>& array2, DictionaryRanksCache* cache = nullptr)
+                : _indices1(indices(array1)), _indices2(indices(array2)),
+                  _values1(_indices1->raw_values()), _values2(_indices2->raw_values()),
+                  _ranks(dictionary_ranks(dictionary(array1), dictionary(array2), cache)),
+                  _ranks1(_ranks->ranks1.data()), _ranks2(_ranks->ranks2.data()),
+                  _has_nulls(array1->null_count() != 0 || array2->null_count() != 0) {
+        }
+
+        int cmp(int64_t index1, int64_t index2) const {
+            if (_has_nulls) {
+                bool null1 = _indices1->IsNull(index1), null2 = _indices2->IsNull(index2);
+                if (null1 || null2) {
+                    return static_cast<int>(null2) - static_cast<int>(null1);
+                }
+            }
+            auto rank1 = _ranks1[_values1[index1]];
+            auto rank2 = _ranks2[_values2[index2]];
+            return static_cast<int>(rank2 < rank1) - static_cast<int>(rank1 < rank2);
+        }
+
+    private:
+        static std::shared_ptr<TIndexArray> indices(const std::shared_ptr<arrow::Array>& array) {
+            return std::static_pointer_cast<TIndexArray>(std::static_pointer_cast<arrow::DictionaryArray>(array)->indices());
+        }
+
+        static std::shared_ptr<arrow::Array> dictionary(const std::shared_ptr<arrow::Array>& array) {
+            return std::static_pointer_cast<arrow::DictionaryArray>(array)->dictionary();
+        }
+
+        std::shared_ptr<TIndexArray> _indices1, _indices2;
+        const typename TIndexArray::value_type* _values1;
+        const typename TIndexArray::value_type* _values2;
+        std::shared_ptr<const DictionaryRanks> _ranks;
+        const uint32_t* _ranks1;
+        const uint32_t* _ranks2;
+        bool _has_nulls;
+    };
+
+    /**
+     * Compares rows on all key columns without virtual calls; the column compares are inlined into one function.
+     */
+    template<typename... TColumns>
+    class FusedComparer final : public IComparer {
+    public:
+        FusedComparer(TColumns... columns) : _columns(std::move(columns)...) {
+        }
+
+        int cmp(int64_t index1, int64_t index2) const final {
+            return cmp_impl<0>(index1, index2);
+        }
+
+        bool lt(int64_t index1, int64_t index2) const final {
+            return cmp(index1, index2) < 0;
+        }
+
+        bool gt(int64_t index1, int64_t index2) const final {
+            return cmp(index1, index2) > 0;
+        }
+
+    private:
+        template<size_t I>
+        int cmp_impl(int64_t index1, int64_t index2) const {
+            if constexpr (I == sizeof...(TColumns)) {
+                return 0;
+            }
+            else {
+                auto ret = std::get<I>(_columns).cmp(index1, index2);
+                return ret != 0 ? ret : cmp_impl<I + 1>(index1, index2);
+            }
+        }
+
+        std::tuple<TColumns...> _columns;
+    };
+
+    /**
+     * The key column types which get a fused comparer. Every type is specialized for a single key column, wider keys
+     * are limited to int32/int64/string (and int32 dictionaries for two columns) to bound the number of instantiations.
+     */
+    static inline bool is_fused_column_type(const arrow::Array& array, size_t num_columns) {
+        auto type_id = array.type_id();
+        if (type_id == arrow::Type::DICTIONARY) {
+            auto& dict_type = static_cast<const arrow::DictionaryType&>(*array.type());
+            if (dict_type.value_type()->id() != arrow::Type::STRING) {
+                return false;
+            }
+            type_id = dict_type.index_type()->id();
+            return num_columns == 1 ? (type_id == arrow::Type::INT8 || type_id == arrow::Type::INT16 || type_id == arrow::Type::INT32) :
+                (num_columns == 2 && type_id == arrow::Type::INT32);
+        }
+        switch (type_id) {
+            case arrow::Type::INT32:
+            case arrow::Type::INT64:
+            case arrow::Type::STRING:
+                return true;
+            case arrow::Type::INT8:
+            case arrow::Type::DOUBLE:
+            case arrow::Type::INT16:
+            case arrow::Type::UINT8:
+            case arrow::Type::UINT16:
+            case arrow::Type::UINT32:
+            case arrow::Type::UINT64:
+            case arrow::Type::HALF_FLOAT:
+            case arrow::Type::FLOAT:
+            case arrow::Type::LARGE_STRING:
+                return num_columns == 1;
+            default:
+                return false;
+        }
+    }
+
+    template<size_t NColumns, typename TVisitor, typename... TColumns>
+    arrow::Status visit_fused_comparer(const std::vector<std::shared_ptr<arrow::Array>>& arrays1, const std::vector<std::shared_ptr<arrow::Array>>& arrays2, TVisitor& visitor, DictionaryRanksCache* ranks, StringPrefixCache* prefixes, TColumns... columns) {
+        constexpr size_t I = sizeof...(TColumns);
+        if constexpr (I == NColumns) {
+            FusedComparer<TColumns...> comparer(std::move(columns)...);
+            return visitor(comparer);
+        }
+        else {
+            auto& array1 = arrays1[I];
+            auto& array2 = arrays2[I];
+            switch (array1->type_id()) {
+                case arrow::Type::INT32:
+                    return visit_fused_comparer<NColumns>(arrays1, arrays2, visitor, ranks, prefixes, std::move(columns)..., PrimitiveColumnComparer<arrow::Int32Array>(array1, array2));
+                case arrow::Type::INT64:
+                    return visit_fused_comparer<NColumns>(arrays1, arrays2, visitor, ranks, prefixes, std::move(columns)..., PrimitiveColumnComparer<arrow::Int64Array>(array1, array2));
+                case arrow::Type::STRING:
+                    return visit_fused_comparer<NColumns>(arrays1, arrays2, visitor, ranks, prefixes, std::move(columns)..., StringColumnComparer<arrow::StringArray>(array1, array2, prefixes));
+                case arrow::Type::DICTIONARY:
+                    if constexpr (NColumns <= 2) {
+                        switch (static_cast<const arrow::DictionaryType&>(*array1->type()).index_type()->id()) {
+                            case arrow::Type::INT32:
+                                return visit_fused_comparer<NColumns>(arrays1, arrays2, visitor, ranks, prefixes, std::move(columns)..., DictionaryColumnComparer<arrow::Int32Array>(array1, array2, ranks));
+                            case arrow::Type::INT8:
+                                if constexpr (NColumns == 1) {
+                                    return visit_fused_comparer<NColumns>(arrays1, arrays2, visitor, ranks, prefixes, std::move(columns)..., DictionaryColumnComparer<arrow::Int8Array>(array1, array2, ranks));
+                                }
+                                break;
+                            case arrow::Type::INT16:
+                                if constexpr (NColumns == 1) {
+                                    return visit_fused_comparer<NColumns>(arrays1, arrays2, visitor, ranks, prefixes, std::move(columns)..., DictionaryColumnComparer<arrow::Int16Array>(array1, array2, ranks));
+                                }
+                                break;
+                            default:
+                                break;
+                        }
+                    }
+                    break;
+                default:
+                    if constexpr (NColumns == 1) {
+                        switch (array1->type_id()) {
+                            case arrow::Type::DOUBLE:
+                                return visit_fused_comparer<NColumns>(arrays1, arrays2, visitor, ranks, prefixes, std::move(columns)..., PrimitiveColumnComparer<arrow::DoubleArray>(array1, array2));
+                            case arrow::Type::INT8:
+                                return visit_fused_comparer<NColumns>(arrays1, arrays2, visitor, ranks, prefixes, std::move(columns)..., PrimitiveColumnComparer<arrow::Int8Array>(array1, array2));
+                            case arrow::Type::INT16:
+                                return visit_fused_comparer<NColumns>(arrays1, arrays2, visitor, ranks, prefixes, std::move(columns)..., PrimitiveColumnComparer<arrow::Int16Array>(array1, array2));
+                            case arrow::Type::UINT8:
+                                return visit_fused_comparer<NColumns>(arrays1, arrays2, visitor, ranks, prefixes, std::move(columns)..., PrimitiveColumnComparer<arrow::UInt8Array>(array1, array2));
+                            case arrow::Type::UINT16:
+                                return visit_fused_comparer<NColumns>(arrays1, arrays2, visitor, ranks, prefixes, std::move(columns)..., PrimitiveColumnComparer<arrow::UInt16Array>(array1, array2));
+                            case arrow::Type::UINT32:
+                                return visit_fused_comparer<NColumns>(arrays1, arrays2, visitor, ranks, prefixes, std::move(columns)..., PrimitiveColumnComparer<arrow::UInt32Array>(array1, array2));
+                            case arrow::Type::UINT64:
+                                return visit_fused_comparer<NColumns>(arrays1, arrays2, visitor, ranks, prefixes, std::move(columns)..., PrimitiveColumnComparer<arrow::UInt64Array>(array1, array2));
+                            case arrow::Type::HALF_FLOAT:
+                                return visit_fused_comparer<NColumns>(arrays1, arrays2, visitor, ranks, prefixes, std::move(columns)..., PrimitiveColumnComparer<arrow::HalfFloatArray>(array1, array2));
+                            case arrow::Type::FLOAT:
+                                return visit_fused_comparer<NColumns>(arrays1, arrays2, visitor, ranks, prefixes, std::move(columns)..., PrimitiveColumnComparer<arrow::FloatArray>(array1, array2));
+                            case arrow::Type::LARGE_STRING:
+                                return visit_fused_comparer<NColumns>(arrays1, arrays2, visitor, ranks, prefixes, std::move(columns)..., StringColumnComparer<arrow::LargeStringArray>(array1, array2, prefixes));
+                            default:
+                                break;
+                        }
+                    }
+                    break;
+            }
+            return arrow::Status::Invalid("No fused comparer for column type " + array1->type()->ToString());
+        }
+    }
+
+    /**
+     * Call visitor with the fastest comparer for the key columns of batch1 and batch2: a FusedComparer for up to
+     * MaxColumns columns of the types in is_fused_column_type, otherwise the virtual comparer from make_comparer, which
+     * is only built then.
+     * Dictionary ranks come from the cache if one is given, so that the caller can reuse them. String columns compare
+     * prefixes first only if a prefix cache is given.
+     */
+    template<size_t MaxColumns = 3, typename TVisitor>
+    arrow::Status with_comparer(std::shared_ptr<arrow::RecordBatch> batch1, std::shared_ptr<arrow::RecordBatch> batch2, const std::vector<std::string>& columns, TVisitor visitor, DictionaryRanksCache* ranks = nullptr, StringPrefixCache* prefixes = nullptr) {
+        static_assert(MaxColumns <= 3, "Fused comparers are only instantiated for up to 3 columns");
+        std::vector<std::shared_ptr<arrow::Array>> arrays1, arrays2;
+        bool fused = columns.size() <= MaxColumns;
+        for (auto& c: columns) {
+            arrays1.push_back(batch1->GetColumnByName(c));
+            if (!arrays1.back()) {
+                throw std::runtime_error("Column missing from batch1: " + c);
+            }
+            arrays2.push_back(batch2->GetColumnByName(c));
+            if (!arrays2.back()) {
+                throw std::runtime_error("Column missing from batch2: " + c);
+            }
+            //Equal fused types are comparable, make_comparer checks the types of the fallback
+            fused = fused && is_fused_column_type(*arrays1.back(), columns.size()) && arrays1.back()->type()->Equals(arrays2.back()->type());
+        }
+        if (fused) {
+            switch (columns.size()) {
+                case 1:
+                    return visit_fused_comparer<1>(arrays1, arrays2, visitor, ranks, prefixes);
+                case 2:
+                    if constexpr (MaxColumns >= 2) {
+                        return visit_fused_comparer<2>(arrays1, arrays2, visitor, ranks, prefixes);
+                    }
+                    break;
+                case 3:
+                    if constexpr (MaxColumns >= 3) {
+                        return visit_fused_comparer<3>(arrays1, arrays2, visitor, ranks, prefixes);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        return visitor(*make_comparer(batch1, batch2, columns, ranks));
+    }
+}
+
+#endif //MARROW_FUSED_COMPARE_H
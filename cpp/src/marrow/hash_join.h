@@ -0,0 +1,181 @@
+#ifndef MARROW_HASH_JOIN_H
+#define MARROW_HASH_JOIN_H
+
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <vector>
+#include <arrow/array.h>
+#include <arrow/record_batch.h>
+#include "marrow/compare.h"
+#include "marrow/fused_compare.h"
+
+namespace marrow {
+
+    static inline uint64_t mix_hash(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    static inline void combine_hash(uint64_t* seed, uint64_t h) {
+        *seed ^= h + 0x9e3779b97f4a7c15ULL + (*seed << 6) + (*seed >> 2);
+    }
+
+    /**
+     * The hash of a key value. Keys which compare equal hash equal whatever their type: integers hash their value as
+     * uint64, floating point numbers as double, and all strings their bytes.
+     */
+    template<typename T>
+    uint64_t hash_value(T value) {
+        if constexpr (std::is_integral<T>::value) {
+            return mix_hash(static_cast<uint64_t>(value));
+        }
+        else {
+            //-0.0 equals 0.0
+            double d = value == 0 ? 0.0 : static_cast<double>(value);
+            uint64_t bits;
+            std::memcpy(&bits, &d, sizeof(bits));
+            return mix_hash(bits);
+        }
+    }
+
+    template<typename TView>
+    uint64_t hash_string(const TView& value) {
+        return std::hash<std::string_view>()(std::string_view(reinterpret_cast<const char*>(value.data()), value.size()));
+    }
+
+    constexpr uint64_t null_hash = 0x5bd1e995ULL;
+
+    template<typename TArray, typename THash>
+    void combine_row_hashes(const TArray& array, THash hash, std::vector<uint64_t>* hashes) {
+        for (int64_t i = 0; i < array.length(); i++) {
+            combine_hash(&(*hashes)[i], array.IsNull(i) ? null_hash : hash(i));
+        }
+    }
+
+    /**
+     * Combine the hash of every row of a key column into hashes.
+     */
+    static inline arrow::Status hash_column(const std::shared_ptr<arrow::Array>& array, std::vector<uint64_t>* hashes) {
+        switch (array->type_id()) {
+            case arrow::Type::HALF_FLOAT: {
+                auto& typed = static_cast<const arrow::HalfFloatArray&>(*array);
+                combine_row_hashes(typed, [&typed](int64_t i) { return hash_value(typed.Value(i)); }, hashes);
+                break;
+            }
+            case arrow::Type::STRING: {
+                auto& typed = static_cast<const arrow::StringArray&>(*array);
+                combine_row_hashes(typed, [&typed](int64_t i) { return hash_string(typed.GetView(i)); }, hashes);
+                break;
+            }
+            case arrow::Type::LARGE_STRING: {
+                auto& typed = static_cast<const arrow::LargeStringArray&>(*array);
+                combine_row_hashes(typed, [&typed](int64_t i) { return hash_string(typed.GetView(i)); }, hashes);
+                break;
+            }
+            case arrow::Type::DICTIONARY: {
+                auto& dict_array = static_cast<const arrow::DictionaryArray&>(*array);
+                if (dict_array.dictionary()->type_id() != arrow::Type::STRING) {
+                    return arrow::Status::Invalid("Cannot hash array of type " + array->type()->ToString());
+                }
+                //Every dictionary entry is hashed once
+                auto& dictionary = static_cast<const arrow::StringArray&>(*dict_array.dictionary());
+                std::vector<uint64_t> entry_hashes(dictionary.length());
+                for (int64_t i = 0; i < dictionary.length(); i++) {
+                    entry_hashes[i] = hash_string(dictionary.GetView(i));
+                }
+                visit_dictionary_index_type(dict_array, [&](auto* index) {
+                    typedef std::remove_pointer_t<decltype(index)> TIndexArray;
+                    auto& indices = static_cast<const TIndexArray&>(*dict_array.indices());
+                    combine_row_hashes(indices, [&](int64_t i) { return entry_hashes[indices.Value(i)]; }, hashes);
+                });
+                break;
+            }
+            default:
+                if (key_kind(*array->type()) == KeyKind::Other) {
+                    return arrow::Status::Invalid("Cannot hash array of type " + array->type()->ToString());
+                }
+                visit_numeric_array(array, [hashes](auto typed) {
+                    combine_row_hashes(*typed, [&typed](int64_t i) { return hash_value(typed->Value(i)); }, hashes);
+                });
+        }
+        return arrow::Status::OK();
+    }
+
+    /**
+     * The hash of every row on the on columns.
+     */
+    static inline arrow::Status hash_rows(const std::shared_ptr<arrow::RecordBatch>& batch, const std::vector<std::string>& on, std::vector<uint64_t>* hashes) {
+        hashes->assign(batch->num_rows(), 0);
+        for (auto& name: on) {
+            auto column = batch->GetColumnByName(name);
+            if (!column) {
+                return arrow::Status::KeyError("No such column: " + name);
+            }
+            ARROW_RETURN_NOT_OK(hash_column(column, hashes));
+        }
+        return arrow::Status::OK();
+    }
+
+    /**
+     * Like join_indices, but without sorting either side: the rows of right are put in a hash table which every row
+     * of left is looked up in. The joined rows come in left row order with the matches of a row in right row order,
+     * followed by the right only rows in right row order. Null keys match null keys as in the sort-merge join.
+     */
+    template <typename TIndexBuilder>
+    arrow::Status hash_join_indices(std::shared_ptr<arrow::RecordBatch> left, std::shared_ptr<arrow::RecordBatch> right, std::vector<std::string> on,
+                                    std::shared_ptr<arrow::Array>* left_array, std::shared_ptr<arrow::Array>* right_array, arrow::MemoryPool* pool = arrow::default_memory_pool(),
+                                    DictionaryRanksCache* ranks = nullptr) {
+        std::vector<uint64_t> left_hashes, right_hashes;
+        ARROW_RETURN_NOT_OK(hash_rows(left, on, &left_hashes));
+        ARROW_RETURN_NOT_OK(hash_rows(right, on, &right_hashes));
+
+        //Chained hash table over the right rows, with at least two buckets per row
+        uint64_t buckets = 1;
+        while (buckets < 2 * static_cast<uint64_t>(right->num_rows())) {
+            buckets <<= 1;
+        }
+        uint64_t mask = buckets - 1;
+        std::vector<int64_t> heads(buckets, -1);
+        std::vector<int64_t> next(right->num_rows());
+        //Inserted backwards so that the chains are in row order
+        for (int64_t r = right->num_rows() - 1; r >= 0; r--) {
+            auto& head = heads[right_hashes[r] & mask];
+            next[r] = head;
+            head = r;
+        }
+
+        TIndexBuilder index_builder(pool);
+        std::vector<bool> matched(right->num_rows());
+        //Rows with equal hashes mostly have equal keys, which string prefixes do not order, so none are computed
+        ARROW_RETURN_NOT_OK(with_comparer(left, right, on, [&](const auto& comparer) {
+            for (int64_t l = 0; l < left->num_rows(); l++) {
+                auto hash = left_hashes[l];
+                bool found = false;
+                for (auto r = heads[hash & mask]; r >= 0; r = next[r]) {
+                    if (right_hashes[r] == hash && comparer.cmp(l, r) == 0) {
+                        ARROW_RETURN_NOT_OK(index_builder.both(l, r));
+                        matched[r] = true;
+                        found = true;
+                    }
+                }
+                if (!found) {
+                    ARROW_RETURN_NOT_OK(index_builder.left_only(l));
+                }
+            }
+            return arrow::Status::OK();
+        }, ranks));
+        for (int64_t r = 0; r < right->num_rows(); r++) {
+            if (!matched[r]) {
+                ARROW_RETURN_NOT_OK(index_builder.right_only(r));
+            }
+        }
+        return index_builder.finish(left_array, right_array);
+    }
+}
+
+#endif //MARROW_HASH_JOIN_H
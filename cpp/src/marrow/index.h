@@ -7,6 +7,10 @@
 
 #include <limits>
 #include "marrow/compare.h"
+#include "marrow/fused_compare.h"
+#include "marrow/normalized_key.h"
+#include "marrow/parallel.h"
+#include "marrow/radix_sort.h"
 #include <arrow/record_batch.h>
 #include <arrow/builder.h>
 #include <arrow/scalar.h>
@@ -15,35 +19,382 @@
 
 namespace marrow {
 
+    /**
+     * Minimum average length of the natural runs for make_index to merge them instead of sorting.
+     */
+    constexpr int64_t adaptive_min_run_length = 64;
+
+    /**
+     * Split [begin, end) into natural runs: non descending runs, and strictly descending runs which are reversed so
+     * that stability is kept. Returns false without changing the range if there are more than max_runs runs.
+     */
+    template<typename T, typename TLess>
+    bool find_sorted_runs(T* begin, T* end, TLess less, int64_t max_runs, std::vector<int64_t>* bounds) {
+        int64_t n = end - begin;
+        std::vector<int64_t> descending;
+        bounds->assign(1, 0);
+        for (int64_t start = 0; start < n;) {
+            if (static_cast<int64_t>(bounds->size()) > max_runs) {
+                return false;
+            }
+            auto last = start + 1;
+            if (last < n && less(begin[last], begin[start])) {
+                while (last < n && less(begin[last], begin[last - 1])) {
+                    last++;
+                }
+                descending.push_back(bounds->size() - 1);
+            }
+            else {
+                while (last < n && !less(begin[last], begin[last - 1])) {
+                    last++;
+                }
+            }
+            bounds->push_back(last);
+            start = last;
+        }
+        for (auto run: descending) {
+            std::reverse(begin + (*bounds)[run], begin + (*bounds)[run + 1]);
+        }
+        return true;
+    }
+
+    /**
+     * Check with one linear scan if the rows of the batch are already in index_columns order. String prefixes are
+     * only used if a cache is given, e.g. one which make_index reuses if the batch is not sorted.
+     */
+    static arrow::Status is_batch_sorted(std::shared_ptr<arrow::RecordBatch> batch, const std::vector<std::string>& index_columns, bool* sorted_out, StringPrefixCache* prefixes = nullptr) {
+        *sorted_out = true;
+        return with_comparer<1>(batch, batch, index_columns, [&](const auto& comparer) {
+            //Adjacent rows are compared a block at a time, with one call of the comparer per block
+            constexpr int64_t block_rows = 1024;
+            std::vector<int64_t> rows1(block_rows), rows2(block_rows);
+            std::vector<int8_t> cmp(block_rows);
+            for (int64_t begin = 1; begin < batch->num_rows() && *sorted_out; begin += block_rows) {
+                auto length = std::min(block_rows, batch->num_rows() - begin);
+                for (int64_t i = 0; i < length; i++) {
+                    rows1[i] = begin + i;
+                    rows2[i] = begin + i - 1;
+                }
+                comparer.cmp_batch(rows1.data(), rows2.data(), length, cmp.data());
+                *sorted_out = std::none_of(cmp.begin(), cmp.begin() + length, [](int8_t c) {return c < 0;});
+            }
+            return arrow::Status::OK();
+        }, nullptr, prefixes);
+    }
+
+    /**
+     * The array without its validity bitmap, so comparers built on it skip the null checks. The values of the null
+     * slots are undefined, they must not be compared. No data is copied.
+     */
+    static inline std::shared_ptr<arrow::Array> without_nulls(const std::shared_ptr<arrow::Array>& array) {
+        auto data = array->data()->Copy();
+        data->buffers[0] = nullptr;
+        data->null_count = 0;
+        return arrow::MakeArray(data);
+    }
+
+    /**
+     * The single key column of the batch if it has nulls, else null. Nulls sort first, so its null rows can be moved
+     * to a prefix of the index and the other rows compared by a comparer without null checks.
+     */
+    static inline std::shared_ptr<arrow::Array> nullable_key(const std::shared_ptr<arrow::RecordBatch>& batch, const std::vector<std::string>& index_columns) {
+        if (index_columns.size() != 1) {
+            return nullptr;
+        }
+        auto key = batch->GetColumnByName(index_columns[0]);
+        return key && key->null_count() != 0 ? key : nullptr;
+    }
+
+    /**
+     * The batch with the given key column replaced by the array without its validity bitmap.
+     */
+    static inline std::shared_ptr<arrow::RecordBatch> without_key_nulls(const std::shared_ptr<arrow::RecordBatch>& batch, const std::string& key) {
+        auto columns = batch->columns();
+        auto i = batch->schema()->GetFieldIndex(key);
+        columns[i] = without_nulls(columns[i]);
+        return arrow::RecordBatch::Make(batch->schema(), batch->num_rows(), columns);
+    }
+
+    /**
+     * Write the null rows of key in row order then its other rows in row order to rows, and return the number of
+     * null rows.
+     */
+    template<typename c_type>
+    int64_t partition_nulls(const arrow::Array& key, c_type* rows) {
+        int64_t null_count = 0;
+        for (int64_t row = 0; row < key.length(); row++) {
+            null_count += key.IsNull(row);
+        }
+        int64_t nulls = 0, values = null_count;
+        for (int64_t row = 0; row < key.length(); row++) {
+            rows[key.IsNull(row) ? nulls++ : values++] = static_cast<c_type>(row);
+        }
+        return null_count;
+    }
+
+    /**
+     * Create an index which sorts the batch by the index columns. Equal keys keep their row order, so the index is
+     * the same for any num_threads. Input made of few natural runs (e.g. sorted or nearly sorted) is merged instead
+     * of sorted, which is O(n) for sorted input. The string prefixes of the key are computed once, or taken from the
+     * cache if one is given.
+     */
     template<typename TType = arrow::Int32Type>
-    static arrow::Status make_index(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> index_columns, std::shared_ptr<arrow::Array>* index_out) {
-        auto comparer = make_comparer(batch, index_columns);
+    static arrow::Status make_index(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> index_columns, std::shared_ptr<arrow::Array>* index_out, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool(), StringPrefixCache* prefixes = nullptr) {
         typedef arrow::TypeTraits<TType> TypeTrait;
         typedef typename TType::c_type c_type;
 
+        //Shared by the run probe and the sort
+        StringPrefixCache local_prefixes;
+        if (!prefixes) {
+            prefixes = &local_prefixes;
+        }
+
         std::shared_ptr<arrow::Buffer> buffer;
-        ARROW_RETURN_NOT_OK(arrow::AllocateBuffer(arrow::default_memory_pool(), batch->num_rows() * sizeof(c_type), &buffer));
+        ARROW_RETURN_NOT_OK(arrow::AllocateBuffer(pool, batch->num_rows() * sizeof(c_type), &buffer));
 
         auto it = reinterpret_cast<c_type*>(buffer->mutable_data());
         auto end = it + batch->num_rows();
-        std::iota(it, end, 0);
-        std::sort(it, end, [comparer](c_type i1, c_type i2) {return comparer->lt(i1, i2);});
+        if (auto key = nullable_key(batch, index_columns)) {
+            it += partition_nulls(*key, it);
+            batch = without_key_nulls(batch, index_columns[0]);
+        }
+        else {
+            std::iota(it, end, 0);
+        }
+        bool merged = false;
+        ARROW_RETURN_NOT_OK(with_comparer<1>(batch, batch, index_columns, [&](const auto& comparer) {
+            auto less = [&comparer](c_type i1, c_type i2) {return comparer.lt(i1, i2);};
+            std::vector<int64_t> bounds;
+            auto max_runs = std::max<int64_t>(1, batch->num_rows() / adaptive_min_run_length);
+            if (!find_sorted_runs(it, end, less, max_runs, &bounds)) {
+                return arrow::Status::OK();
+            }
+            merged = true;
+            return parallel_merge_runs(it, end, std::move(bounds), num_threads, less);
+        }, nullptr, prefixes));
+        if (merged) {
+            *index_out = std::make_shared<typename TypeTrait::ArrayType>(batch->num_rows(), buffer);
+            return arrow::Status::OK();
+        }
+
+        if (is_radix_sortable(batch, index_columns)) {
+            auto sort_run = [&batch, &index_columns](c_type* run_begin, c_type* run_end) {
+                std::vector<c_type> permutation(run_begin, run_end);
+                ARROW_RETURN_NOT_OK(radix_sort(batch, index_columns, permutation));
+                std::copy(permutation.begin(), permutation.end(), run_begin);
+                return arrow::Status::OK();
+            };
+            if (num_threads > 1) {
+                //The normalized key has the same order as the radix keys, including nulls and -0.0
+                NormalizedKeyComparer comparer(batch, index_columns);
+                auto less = [&comparer](c_type i1, c_type i2) {return comparer.compare(i1, i2) < 0;};
+                ARROW_RETURN_NOT_OK(parallel_stable_sort(it, end, num_threads, less, sort_run));
+            }
+            else {
+                ARROW_RETURN_NOT_OK(sort_run(it, end));
+            }
+        }
+        else if (index_columns.size() > 1) {
+            NormalizedKeyComparer comparer(batch, index_columns);
+            auto less = [&comparer](c_type i1, c_type i2) {return comparer.compare(i1, i2) < 0;};
+            ARROW_RETURN_NOT_OK(parallel_stable_sort(it, end, num_threads, less, [&less](c_type* run_begin, c_type* run_end) {
+                std::stable_sort(run_begin, run_end, less);
+                return arrow::Status::OK();
+            }));
+        }
+        else {
+            ARROW_RETURN_NOT_OK(with_comparer<1>(batch, batch, index_columns, [&](const auto& comparer) {
+                auto less = [&comparer](c_type i1, c_type i2) {return comparer.lt(i1, i2);};
+                return parallel_stable_sort(it, end, num_threads, less, [&less](c_type* run_begin, c_type* run_end) {
+                    std::stable_sort(run_begin, run_end, less);
+                    return arrow::Status::OK();
+                });
+            }, nullptr, prefixes));
+        }
 
         *index_out = std::make_shared<typename TypeTrait::ArrayType>(batch->num_rows(), buffer);
         return arrow::Status::OK();
     }
 
-    static arrow::Status make_index(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> index_columns, std::shared_ptr<arrow::Array>* index_out) {
+    static arrow::Status make_index(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> index_columns, std::shared_ptr<arrow::Array>* index_out, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool(), StringPrefixCache* prefixes = nullptr) {
+        if (batch->num_rows() <= std::numeric_limits<int8_t>::max()) {
+            return make_index<arrow::Int8Type>(batch, index_columns, index_out, num_threads, pool, prefixes);
+        }
+        else if (batch->num_rows() <= std::numeric_limits<int16_t>::max()) {
+            return make_index<arrow::Int16Type>(batch, index_columns, index_out, num_threads, pool, prefixes);
+        }
+        else if (batch->num_rows() <= std::numeric_limits<int32_t>::max()) {
+            return make_index<arrow::Int32Type>(batch, index_columns, index_out, num_threads, pool, prefixes);
+        }
+        return make_index<arrow::Int64Type>(batch, index_columns, index_out, num_threads, pool, prefixes);
+    }
+
+    /**
+     * Create an index of only the first limit rows in sort order, using a bounded heap of limit rows, which is
+     * O(n log limit). The result is the same as the first limit entries of make_index. The string prefixes of the key
+     * are taken from the cache if one is given.
+     */
+    template<typename TType = arrow::Int32Type>
+    static arrow::Status make_partial_index(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> index_columns, int64_t limit, std::shared_ptr<arrow::Array>* index_out, arrow::MemoryPool* pool = arrow::default_memory_pool(), StringPrefixCache* prefixes = nullptr) {
+        typedef arrow::TypeTraits<TType> TypeTrait;
+        typedef typename TType::c_type c_type;
+
+        StringPrefixCache local_prefixes;
+        if (!prefixes) {
+            prefixes = &local_prefixes;
+        }
+
+        limit = std::max<int64_t>(0, std::min(limit, batch->num_rows()));
+        std::shared_ptr<arrow::Buffer> buffer;
+        ARROW_RETURN_NOT_OK(arrow::AllocateBuffer(pool, limit * sizeof(c_type), &buffer));
+        auto it = reinterpret_cast<c_type*>(buffer->mutable_data());
+
+        //The first null rows of a nullable single key column come first, the heap selects among the other rows
+        auto key = nullable_key(batch, index_columns);
+        int64_t null_count = 0;
+        if (key) {
+            for (int64_t row = 0; row < batch->num_rows() && null_count < limit; row++) {
+                if (key->IsNull(row)) {
+                    it[null_count++] = static_cast<c_type>(row);
+                }
+            }
+            batch = without_key_nulls(batch, index_columns[0]);
+        }
+        auto select = [&](auto cmp) {
+            //Ties are broken by row, so this is a strict order and matches the stable full sort
+            auto less = [&cmp](c_type i1, c_type i2) {
+                auto ret = cmp(i1, i2);
+                return ret < 0 || (ret == 0 && i1 < i2);
+            };
+            auto heap_limit = limit - null_count;
+            std::vector<c_type> heap;
+            heap.reserve(heap_limit);
+            for (int64_t row = 0; row < batch->num_rows() && heap_limit > 0; row++) {
+                if (key && key->IsNull(row)) {
+                    continue;
+                }
+                if (static_cast<int64_t>(heap.size()) < heap_limit) {
+                    heap.push_back(row);
+                    std::push_heap(heap.begin(), heap.end(), less);
+                }
+                else if (less(row, heap.front())) {
+                    std::pop_heap(heap.begin(), heap.end(), less);
+                    heap.back() = row;
+                    std::push_heap(heap.begin(), heap.end(), less);
+                }
+            }
+            std::sort_heap(heap.begin(), heap.end(), less);
+            std::copy(heap.begin(), heap.end(), it + null_count);
+            return arrow::Status::OK();
+        };
+        if (index_columns.size() > 1) {
+            NormalizedKeyComparer comparer(batch, index_columns);
+            ARROW_RETURN_NOT_OK(select([&comparer](int64_t i1, int64_t i2) {return comparer.compare(i1, i2);}));
+        }
+        else {
+            ARROW_RETURN_NOT_OK(with_comparer<1>(batch, batch, index_columns, [&](const auto& comparer) {
+                return select([&comparer](int64_t i1, int64_t i2) {return comparer.cmp(i1, i2);});
+            }, nullptr, prefixes));
+        }
+
+        *index_out = std::make_shared<typename TypeTrait::ArrayType>(limit, buffer);
+        return arrow::Status::OK();
+    }
+
+    static arrow::Status make_partial_index(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> index_columns, int64_t limit, std::shared_ptr<arrow::Array>* index_out, arrow::MemoryPool* pool = arrow::default_memory_pool(), StringPrefixCache* prefixes = nullptr) {
         if (batch->num_rows() <= std::numeric_limits<int8_t>::max()) {
-            return make_index<arrow::Int8Type>(batch, index_columns, index_out);
+            return make_partial_index<arrow::Int8Type>(batch, index_columns, limit, index_out, pool, prefixes);
         }
         else if (batch->num_rows() <= std::numeric_limits<int16_t>::max()) {
-            return make_index<arrow::Int16Type>(batch, index_columns, index_out);
+            return make_partial_index<arrow::Int16Type>(batch, index_columns, limit, index_out, pool, prefixes);
         }
         else if (batch->num_rows() <= std::numeric_limits<int32_t>::max()) {
-            return make_index<arrow::Int32Type>(batch, index_columns, index_out);
+            return make_partial_index<arrow::Int32Type>(batch, index_columns, limit, index_out, pool, prefixes);
+        }
+        return make_partial_index<arrow::Int64Type>(batch, index_columns, limit, index_out, pool, prefixes);
+    }
+
+    /**
+     * Call f with the index array cast to its integer array type.
+     */
+    template<typename TFunc>
+    arrow::Status visit_index(const arrow::Array& index, TFunc f) {
+        switch (index.type_id()) {
+            case arrow::Type::INT8:
+                return f(static_cast<const arrow::Int8Array&>(index));
+            case arrow::Type::INT16:
+                return f(static_cast<const arrow::Int16Array&>(index));
+            case arrow::Type::INT32:
+                return f(static_cast<const arrow::Int32Array&>(index));
+            case arrow::Type::INT64:
+                return f(static_cast<const arrow::Int64Array&>(index));
+            default:
+                return arrow::Status::Invalid("Invalid index type " + index.type()->ToString());
+        }
+    }
+
+    /**
+     * Create the index of batch with the rows of new_batch appended, given the index of batch (null if batch is
+     * sorted). Only the new rows are sorted, then both sorted runs are merged in one pass, which is O(n + m log m).
+     * Equal keys keep their row order, so the result is the same as make_index of the combined batch.
+     */
+    template<typename TType = arrow::Int32Type>
+    static arrow::Status append_index(std::shared_ptr<arrow::RecordBatch> batch, std::shared_ptr<arrow::Array> index, std::shared_ptr<arrow::RecordBatch> new_batch, std::vector<std::string> index_columns, std::shared_ptr<arrow::Array>* index_out, arrow::MemoryPool* pool = arrow::default_memory_pool()) {
+        typedef arrow::TypeTraits<TType> TypeTrait;
+        typedef typename TType::c_type c_type;
+        typedef typename TypeTrait::ArrayType ArrayType;
+
+        auto n = batch->num_rows();
+        auto m = new_batch->num_rows();
+        if (index && index->length() != n) {
+            return arrow::Status::Invalid("Index length does not match the batch");
+        }
+        std::shared_ptr<arrow::Array> new_index;
+        ARROW_RETURN_NOT_OK(make_index<TType>(new_batch, index_columns, &new_index, 1, pool));
+        auto& typed_new_index = static_cast<const ArrayType&>(*new_index);
+        auto comparer = make_comparer(batch, new_batch, index_columns);
+
+        std::shared_ptr<arrow::Buffer> buffer;
+        ARROW_RETURN_NOT_OK(arrow::AllocateBuffer(pool, (n + m) * sizeof(c_type), &buffer));
+        auto out = reinterpret_cast<c_type*>(buffer->mutable_data());
+        auto merge = [&](auto row) {
+            int64_t i = 0, j = 0;
+            while (i < n || j < m) {
+                //On equal keys the existing rows come first, as they are first in the combined batch
+                if (j < m && (i == n || comparer->gt(row(i), typed_new_index.Value(j)))) {
+                    *out++ = static_cast<c_type>(n + typed_new_index.Value(j++));
+                }
+                else {
+                    *out++ = static_cast<c_type>(row(i++));
+                }
+            }
+            return arrow::Status::OK();
+        };
+        if (index) {
+            ARROW_RETURN_NOT_OK(visit_index(*index, [&merge](const auto& typed_index) {
+                return merge([&typed_index](int64_t i) {return typed_index.Value(i);});
+            }));
+        }
+        else {
+            ARROW_RETURN_NOT_OK(merge([](int64_t i) {return i;}));
+        }
+
+        *index_out = std::make_shared<ArrayType>(n + m, buffer);
+        return arrow::Status::OK();
+    }
+
+    static arrow::Status append_index(std::shared_ptr<arrow::RecordBatch> batch, std::shared_ptr<arrow::Array> index, std::shared_ptr<arrow::RecordBatch> new_batch, std::vector<std::string> index_columns, std::shared_ptr<arrow::Array>* index_out, arrow::MemoryPool* pool = arrow::default_memory_pool()) {
+        auto num_rows = batch->num_rows() + new_batch->num_rows();
+        if (num_rows <= std::numeric_limits<int8_t>::max()) {
+            return append_index<arrow::Int8Type>(batch, index, new_batch, index_columns, index_out, pool);
+        }
+        else if (num_rows <= std::numeric_limits<int16_t>::max()) {
+            return append_index<arrow::Int16Type>(batch, index, new_batch, index_columns, index_out, pool);
+        }
+        else if (num_rows <= std::numeric_limits<int32_t>::max()) {
+            return append_index<arrow::Int32Type>(batch, index, new_batch, index_columns, index_out, pool);
         }
-        return make_index<arrow::Int64Type>(batch, index_columns, index_out);
+        return append_index<arrow::Int64Type>(batch, index, new_batch, index_columns, index_out, pool);
     }
 }
 
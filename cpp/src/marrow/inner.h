@@ -11,6 +11,8 @@ namespace marrow {
 
     class InnerJoinBuilder {
     public:
+        explicit InnerJoinBuilder(arrow::MemoryPool* pool = arrow::default_memory_pool()) : _lbuilder(pool), _rbuilder(pool) {}
+
         arrow::Status left_only(int64_t index) { return arrow::Status::OK(); }
 
         arrow::Status right_only(int64_t index) { return arrow::Status::OK(); }
@@ -35,9 +37,18 @@ namespace marrow {
     static arrow::Status inner(std::shared_ptr<arrow::RecordBatch> left, std::shared_ptr<arrow::RecordBatch> right,
                                std::shared_ptr<arrow::Array> left_index_array,
                                std::shared_ptr<arrow::Array> right_index_array, std::vector<std::string> on,
-                               std::shared_ptr<arrow::RecordBatch> *table_out, std::string right_prefix = "") {
-        return join_impl<InnerJoinBuilder>(left, right, left_index_array, right_index_array, on, table_out, right_prefix);
+                               std::shared_ptr<arrow::RecordBatch> *table_out, std::string right_prefix = "", int num_threads = 1,
+                               std::vector<std::string> columns = {}, std::vector<std::string> right_columns = {}, arrow::MemoryPool* pool = arrow::default_memory_pool(), JoinMethod method = JoinMethod::Sort, const GatherOptions& gather = GatherOptions()) {
+        return join_impl<InnerJoinBuilder>(left, right, left_index_array, right_index_array, on, table_out, right_prefix, false, num_threads, columns, right_columns, pool, method, gather);
+
+    }
+
+    static arrow::Status inner(std::shared_ptr<arrow::Table> left, std::shared_ptr<arrow::Table> right, std::vector<std::string> on, std::shared_ptr<arrow::RecordBatch>* batch_out, std::string right_prefix = "", int num_threads = 1, std::vector<std::string> columns = {}, std::vector<std::string> right_columns = {}, arrow::MemoryPool* pool = arrow::default_memory_pool()) {
+        return table_join_impl<InnerJoinBuilder>(left, right, on, batch_out, right_prefix, false, num_threads, columns, right_columns, pool);
+    }
 
+    static arrow::Status lazy_inner(std::shared_ptr<arrow::RecordBatch> left, std::shared_ptr<arrow::RecordBatch> right, std::shared_ptr<arrow::Array> left_index_array, std::shared_ptr<arrow::Array> right_index_array, std::vector<std::string> on, std::shared_ptr<LazyRecordBatch>* lazy_out, std::string right_prefix = "", int num_threads = 1, std::vector<std::string> columns = {}, std::vector<std::string> right_columns = {}, arrow::MemoryPool* pool = arrow::default_memory_pool(), JoinMethod method = JoinMethod::Sort, const GatherOptions& gather = GatherOptions()) {
+        return lazy_join_impl<InnerJoinBuilder>(left, right, left_index_array, right_index_array, on, lazy_out, right_prefix, false, num_threads, columns, right_columns, pool, method, gather);
     }
 }
 #endif //MARROW_INNER_H
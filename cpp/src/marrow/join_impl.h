@@ -8,7 +8,11 @@
 #include <arrow/record_batch.h>
 #include <arrow/builder.h>
 #include <iostream>
+#include <limits>
 #include "compare.h"
+#include "fused_compare.h"
+#include "hash_join.h"
+#include "lazy_batch.h"
 #include "sort.h"
 
 namespace marrow {
@@ -59,8 +63,8 @@ static std::shared_ptr<IIndexRecordBatch> make_index(std::shared_ptr<arrow::Arra
 }
 
 template<typename TBuilderType, typename TArrayType>
-arrow::Status unify_outer_column(std::shared_ptr<TArrayType> left_column, std::shared_ptr<TArrayType> right_column, std::shared_ptr<arrow::Array>* left_column_out) {
-    TBuilderType builder;
+arrow::Status unify_outer_column(std::shared_ptr<TArrayType> left_column, std::shared_ptr<TArrayType> right_column, std::shared_ptr<arrow::Array>* left_column_out, arrow::MemoryPool* pool) {
+    TBuilderType builder(pool);
     for (int64_t i = 0; i < left_column->length(); i++) {
         if (left_column->IsNull(i)) {
             if (right_column->IsNull(i)) {
@@ -77,56 +81,269 @@ arrow::Status unify_outer_column(std::shared_ptr<TArrayType> left_column, std::s
     return builder.Finish(left_column_out);
 }
 
+template<typename TBuilderType>
+arrow::Status unified_indices(const std::vector<int64_t>& left_codes, const std::vector<int64_t>& right_codes, std::shared_ptr<arrow::Array>* indices_out, arrow::MemoryPool* pool) {
+    TBuilderType builder(pool);
+    ARROW_RETURN_NOT_OK(builder.Reserve(left_codes.size()));
+    for (size_t i = 0; i < left_codes.size(); i++) {
+        auto code = left_codes[i] >= 0 ? left_codes[i] : right_codes[i];
+        if (code >= 0) {
+            builder.UnsafeAppend(static_cast<typename TBuilderType::value_type>(code));
+        }
+        else {
+            builder.UnsafeAppendNull();
+        }
+    }
+    return builder.Finish(indices_out);
+}
+
+/**
+ * Unify the outer keys of two string dictionary columns into one dictionary built from the ranks of both dictionaries,
+ * rather than interning every row again. The ranks are taken from the cache of the join if there is one, and a
+ * dictionary shared by both columns is kept with its codes.
+ */
+static inline arrow::Status unify_outer_dictionary(const std::shared_ptr<arrow::Array>& left_column, const std::shared_ptr<arrow::Array>& right_column, std::shared_ptr<arrow::Array>* left_column_out, arrow::MemoryPool* pool,
+                                                   DictionaryRanksCache* cache = nullptr) {
+    auto& left_dict = static_cast<const arrow::DictionaryArray&>(*left_column);
+    auto& right_dict = static_cast<const arrow::DictionaryArray&>(*right_column);
+    bool is_shared = is_same_dictionary(*left_dict.dictionary(), *right_dict.dictionary());
+    std::shared_ptr<const DictionaryRanks> ranks;
+    std::shared_ptr<arrow::Array> dict = left_dict.dictionary();
+    if (!is_shared) {
+        ranks = dictionary_ranks(left_dict.dictionary(), right_dict.dictionary(), cache);
+        auto& left_values = static_cast<const arrow::StringArray&>(*left_dict.dictionary());
+        auto& right_values = static_cast<const arrow::StringArray&>(*right_dict.dictionary());
+        arrow::StringBuilder dict_builder(pool);
+        for (auto& entry: ranks->entries) {
+            ARROW_RETURN_NOT_OK(dict_builder.Append(entry.first == 0 ? left_values.GetView(entry.second) : right_values.GetView(entry.second)));
+        }
+        ARROW_RETURN_NOT_OK(dict_builder.Finish(&dict));
+    }
+
+    //The unified codes of a column, with -1 for nulls
+    auto unified_codes = [](const arrow::DictionaryArray& array, const uint32_t* ranks) {
+        return visit_dictionary_index_type(array, [&](auto* index) {
+            typedef std::remove_pointer_t<decltype(index)> TIndexArray;
+            auto& indices = static_cast<const TIndexArray&>(*array.indices());
+            std::vector<int64_t> codes(indices.length());
+            for (int64_t i = 0; i < indices.length(); i++) {
+                codes[i] = indices.IsNull(i) ? -1 : ranks ? static_cast<int64_t>(ranks[indices.Value(i)]) : static_cast<int64_t>(indices.Value(i));
+            }
+            return codes;
+        });
+    };
+    auto left_codes = unified_codes(left_dict, ranks ? ranks->ranks1.data() : nullptr);
+    auto right_codes = unified_codes(right_dict, ranks ? ranks->ranks2.data() : nullptr);
+    //The narrowest index type holding the unified dictionary, as the dictionary builder gives
+    std::shared_ptr<arrow::Array> indices;
+    if (dict->length() <= std::numeric_limits<int8_t>::max()) {
+        ARROW_RETURN_NOT_OK(unified_indices<arrow::Int8Builder>(left_codes, right_codes, &indices, pool));
+    }
+    else if (dict->length() <= std::numeric_limits<int16_t>::max()) {
+        ARROW_RETURN_NOT_OK(unified_indices<arrow::Int16Builder>(left_codes, right_codes, &indices, pool));
+    }
+    else {
+        ARROW_RETURN_NOT_OK(unified_indices<arrow::Int32Builder>(left_codes, right_codes, &indices, pool));
+    }
+    *left_column_out = std::make_shared<arrow::DictionaryArray>(arrow::dictionary(indices->type(), arrow::utf8()), indices, dict);
+    return arrow::Status::OK();
+}
+
+
+/**
+ * The type of the unified outer join key of two comparable key types. It is the type itself if both are equal. Mixed
+ * integers get the narrowest integer type holding both, where uint64 with a signed type gives int64 (see
+ * unsigned_key_type for when uint64 is kept). Mixed floating
+ * point types give double. Two string dictionaries give a dictionary. Other mixed strings give a large string if
+ * either side is large, and a string otherwise.
+ */
+static inline std::shared_ptr<arrow::DataType> common_key_type(const std::shared_ptr<arrow::DataType>& type1, const std::shared_ptr<arrow::DataType>& type2) {
+    if (type1->Equals(type2)) {
+        return type1;
+    }
+    switch (key_kind(*type1)) {
+        case KeyKind::Integer: {
+            auto& int1 = static_cast<const arrow::IntegerType&>(*type1);
+            auto& int2 = static_cast<const arrow::IntegerType&>(*type2);
+            if (int1.is_signed() == int2.is_signed()) {
+                return int1.bit_width() >= int2.bit_width() ? type1 : type2;
+            }
+            auto& signed_type = int1.is_signed() ? int1 : int2;
+            auto& unsigned_type = int1.is_signed() ? int2 : int1;
+            auto bits = std::max(signed_type.bit_width(), 2 * unsigned_type.bit_width());
+            return bits <= 8 ? arrow::int8() : bits <= 16 ? arrow::int16() : bits <= 32 ? arrow::int32() : arrow::int64();
+        }
+        case KeyKind::Floating:
+            return arrow::float64();
+        case KeyKind::String:
+            if (type1->id() == arrow::Type::DICTIONARY && type2->id() == arrow::Type::DICTIONARY) {
+                return type1;
+            }
+            if (type1->id() == arrow::Type::LARGE_STRING || type2->id() == arrow::Type::LARGE_STRING) {
+                return arrow::large_utf8();
+            }
+            return arrow::utf8();
+        default:
+            return type1;
+    }
+}
+
+/**
+ * The unified key type of an integer pair whose common_key_type is int64 because one side is uint64: uint64 if the
+ * signed side has no negative values, so that uint64 values above the int64 range keep their value.
+ */
+static inline std::shared_ptr<arrow::DataType> unsigned_key_type(const std::shared_ptr<arrow::Array>& array1, const std::shared_ptr<arrow::Array>& array2, const std::shared_ptr<arrow::DataType>& type) {
+    if (type->id() != arrow::Type::INT64 || (array1->type_id() != arrow::Type::UINT64 && array2->type_id() != arrow::Type::UINT64)) {
+        return type;
+    }
+    auto& signed_array = array1->type_id() == arrow::Type::UINT64 ? array2 : array1;
+    bool has_negatives = visit_numeric_array(signed_array, [](auto typed_array) {
+        for (int64_t i = 0; i < typed_array->length(); i++) {
+            if (typed_array->IsValid(i) && typed_array->Value(i) < 0) {
+                return true;
+            }
+        }
+        return false;
+    });
+    return has_negatives ? type : arrow::uint64();
+}
+
+/**
+ * Whether an integer value is in the range of the integer type TTo.
+ */
+template<typename TTo, typename TFrom>
+bool in_integer_range(TFrom value) {
+    if constexpr (std::is_signed<TFrom>::value && !std::is_signed<TTo>::value) {
+        if (value < 0) {
+            return false;
+        }
+        return static_cast<std::make_unsigned_t<TFrom>>(value) <= std::numeric_limits<TTo>::max();
+    }
+    else if constexpr (!std::is_signed<TFrom>::value && std::is_signed<TTo>::value) {
+        return value <= static_cast<std::make_unsigned_t<TTo>>(std::numeric_limits<TTo>::max());
+    }
+    else {
+        return value >= std::numeric_limits<TTo>::min() && value <= std::numeric_limits<TTo>::max();
+    }
+}
+
+/**
+ * Convert a numeric array to the numeric type TType by value. Integers out of the range of an integer TType are
+ * invalid rather than wrapped.
+ */
+template<typename TType>
+arrow::Status convert_numeric(const std::shared_ptr<arrow::Array>& array, std::shared_ptr<arrow::Array>* array_out, arrow::MemoryPool* pool) {
+    typedef typename TType::c_type c_type;
+    typename arrow::TypeTraits<TType>::BuilderType builder(pool);
+    ARROW_RETURN_NOT_OK(builder.Reserve(array->length()));
+    return visit_numeric_array(array, [&](auto typed_array) {
+        typedef typename std::decay_t<decltype(*typed_array)>::value_type value_type;
+        for (int64_t i = 0; i < typed_array->length(); i++) {
+            if (typed_array->IsNull(i)) {
+                builder.UnsafeAppendNull();
+                continue;
+            }
+            auto value = typed_array->Value(i);
+            if constexpr (std::is_integral<c_type>::value && std::is_integral<value_type>::value) {
+                if (!in_integer_range<c_type>(value)) {
+                    return arrow::Status::Invalid("Key " + std::to_string(value) + " is out of the range of " + TType::type_name());
+                }
+            }
+            builder.UnsafeAppend(static_cast<c_type>(value));
+        }
+        return builder.Finish(array_out);
+    });
+}
+
+static inline arrow::Status convert_key(const std::shared_ptr<arrow::Array>& array, const std::shared_ptr<arrow::DataType>& type, std::shared_ptr<arrow::Array>* array_out, arrow::MemoryPool* pool) {
+    if (array->type()->Equals(type)) {
+        *array_out = array;
+        return arrow::Status::OK();
+    }
+    switch (type->id()) {
+        case arrow::Type::INT8:
+            return convert_numeric<arrow::Int8Type>(array, array_out, pool);
+        case arrow::Type::INT16:
+            return convert_numeric<arrow::Int16Type>(array, array_out, pool);
+        case arrow::Type::INT32:
+            return convert_numeric<arrow::Int32Type>(array, array_out, pool);
+        case arrow::Type::INT64:
+            return convert_numeric<arrow::Int64Type>(array, array_out, pool);
+        case arrow::Type::UINT8:
+            return convert_numeric<arrow::UInt8Type>(array, array_out, pool);
+        case arrow::Type::UINT16:
+            return convert_numeric<arrow::UInt16Type>(array, array_out, pool);
+        case arrow::Type::UINT32:
+            return convert_numeric<arrow::UInt32Type>(array, array_out, pool);
+        case arrow::Type::UINT64:
+            return convert_numeric<arrow::UInt64Type>(array, array_out, pool);
+        case arrow::Type::DOUBLE:
+            return convert_numeric<arrow::DoubleType>(array, array_out, pool);
+        default:
+            //Strings are read through IStringArray whatever their type
+            *array_out = array;
+            return arrow::Status::OK();
+    }
+}
 
-static inline arrow::Status unify_outer_on_columns(std::shared_ptr<arrow::RecordBatch> left, std::shared_ptr<arrow::RecordBatch> right, std::vector<std::string> on, std::shared_ptr<arrow::RecordBatch>* left_out, std::shared_ptr<arrow::RecordBatch>* right_out) {
+static inline arrow::Status unify_outer_on_columns(std::shared_ptr<arrow::RecordBatch> left, std::shared_ptr<arrow::RecordBatch> right, std::vector<std::string> on, std::shared_ptr<arrow::RecordBatch>* left_out, std::shared_ptr<arrow::RecordBatch>* right_out, arrow::MemoryPool* pool = arrow::default_memory_pool(),
+                                                   DictionaryRanksCache* ranks = nullptr) {
         for (auto column_name: on) {
             auto left_column_index = left->schema()->GetFieldIndex(column_name);
             auto right_column_index = right->schema()->GetFieldIndex(column_name);
             auto left_column = left->column(left_column_index);
             auto right_column = right->column(right_column_index);
-            ARROW_RETURN_IF(!left_column->type()->Equals(right_column->type()), arrow::Status::Invalid("Incompatible column type for column " + column_name));
-            switch (left_column->type_id()) {
+            ARROW_RETURN_IF(!are_comparable_types(*left_column->type(), *right_column->type()), arrow::Status::Invalid("Incompatible column type for column " + column_name));
+            auto type = unsigned_key_type(left_column, right_column, common_key_type(left_column->type(), right_column->type()));
+            ARROW_RETURN_NOT_OK(convert_key(left_column, type, &left_column, pool));
+            ARROW_RETURN_NOT_OK(convert_key(right_column, type, &right_column, pool));
+            switch (type->id()) {
                 case arrow::Type::INT8:
-                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::Int8Builder>(std::static_pointer_cast<arrow::Int8Array>(left_column), std::static_pointer_cast<arrow::Int8Array>(right_column), &left_column));
+                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::Int8Builder>(std::static_pointer_cast<arrow::Int8Array>(left_column), std::static_pointer_cast<arrow::Int8Array>(right_column), &left_column, pool));
                     break;
                 case arrow::Type::INT16:
-                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::Int16Builder>(std::static_pointer_cast<arrow::Int16Array>(left_column), std::static_pointer_cast<arrow::Int16Array>(right_column), &left_column));
+                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::Int16Builder>(std::static_pointer_cast<arrow::Int16Array>(left_column), std::static_pointer_cast<arrow::Int16Array>(right_column), &left_column, pool));
                     break;
                 case arrow::Type::INT32:
-                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::Int32Builder>(std::static_pointer_cast<arrow::Int32Array>(left_column), std::static_pointer_cast<arrow::Int32Array>(right_column), &left_column));
+                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::Int32Builder>(std::static_pointer_cast<arrow::Int32Array>(left_column), std::static_pointer_cast<arrow::Int32Array>(right_column), &left_column, pool));
                     break;
                 case arrow::Type::INT64:
-                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::Int64Builder>(std::static_pointer_cast<arrow::Int64Array>(left_column), std::static_pointer_cast<arrow::Int64Array>(right_column), &left_column));
+                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::Int64Builder>(std::static_pointer_cast<arrow::Int64Array>(left_column), std::static_pointer_cast<arrow::Int64Array>(right_column), &left_column, pool));
                     break;
                 case arrow::Type::UINT8:
-                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::UInt8Builder>(std::static_pointer_cast<arrow::UInt8Array>(left_column), std::static_pointer_cast<arrow::UInt8Array>(right_column), &left_column));
+                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::UInt8Builder>(std::static_pointer_cast<arrow::UInt8Array>(left_column), std::static_pointer_cast<arrow::UInt8Array>(right_column), &left_column, pool));
                     break;
                 case arrow::Type::UINT16:
-                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::UInt16Builder>(std::static_pointer_cast<arrow::UInt16Array>(left_column), std::static_pointer_cast<arrow::UInt16Array>(right_column), &left_column));
+                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::UInt16Builder>(std::static_pointer_cast<arrow::UInt16Array>(left_column), std::static_pointer_cast<arrow::UInt16Array>(right_column), &left_column, pool));
                     break;
                 case arrow::Type::UINT32:
-                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::UInt32Builder>(std::static_pointer_cast<arrow::UInt32Array>(left_column), std::static_pointer_cast<arrow::UInt32Array>(right_column), &left_column));
+                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::UInt32Builder>(std::static_pointer_cast<arrow::UInt32Array>(left_column), std::static_pointer_cast<arrow::UInt32Array>(right_column), &left_column, pool));
                     break;
                 case arrow::Type::UINT64:
-                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::UInt64Builder>(std::static_pointer_cast<arrow::UInt64Array>(left_column), std::static_pointer_cast<arrow::UInt64Array>(right_column), &left_column));
+                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::UInt64Builder>(std::static_pointer_cast<arrow::UInt64Array>(left_column), std::static_pointer_cast<arrow::UInt64Array>(right_column), &left_column, pool));
                     break;
                 case arrow::Type::HALF_FLOAT:
-                    ARROW_RETURN_NOT_OK((unify_outer_column<arrow::HalfFloatBuilder>(std::static_pointer_cast<arrow::HalfFloatArray>(left_column), std::static_pointer_cast<arrow::HalfFloatArray>(right_column), &left_column)));
+                    ARROW_RETURN_NOT_OK((unify_outer_column<arrow::HalfFloatBuilder>(std::static_pointer_cast<arrow::HalfFloatArray>(left_column), std::static_pointer_cast<arrow::HalfFloatArray>(right_column), &left_column, pool)));
                     break;
                 case arrow::Type::FLOAT:
-                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::FloatBuilder>(std::static_pointer_cast<arrow::FloatArray>(left_column), std::static_pointer_cast<arrow::FloatArray>(right_column), &left_column));
+                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::FloatBuilder>(std::static_pointer_cast<arrow::FloatArray>(left_column), std::static_pointer_cast<arrow::FloatArray>(right_column), &left_column, pool));
                     break;
                 case arrow::Type::DOUBLE:
-                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::DoubleBuilder>(std::static_pointer_cast<arrow::DoubleArray>(left_column), std::static_pointer_cast<arrow::DoubleArray>(right_column), &left_column));
+                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::DoubleBuilder>(std::static_pointer_cast<arrow::DoubleArray>(left_column), std::static_pointer_cast<arrow::DoubleArray>(right_column), &left_column, pool));
                     break;
                 case arrow::Type::STRING:
-                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::StringBuilder>(make_istring_array(left_column), make_istring_array(right_column), &left_column));
+                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::StringBuilder>(make_istring_array(left_column), make_istring_array(right_column), &left_column, pool));
                     break;
                 case arrow::Type::LARGE_STRING:
-                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::LargeStringBuilder>(make_istring_array(left_column), make_istring_array(right_column), &left_column));
+                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::LargeStringBuilder>(make_istring_array(left_column), make_istring_array(right_column), &left_column, pool));
                     break;
                 case arrow::Type::DICTIONARY: {
-                    ARROW_RETURN_NOT_OK(unify_outer_column<arrow::StringDictionaryBuilder>(make_istring_array(left_column), make_istring_array(right_column), &left_column));
+                    if (is_string_dictionary(*left_column) && is_string_dictionary(*right_column)) {
+                        ARROW_RETURN_NOT_OK(unify_outer_dictionary(left_column, right_column, &left_column, pool, ranks));
+                    }
+                    else {
+                        ARROW_RETURN_NOT_OK(unify_outer_column<arrow::StringDictionaryBuilder>(make_istring_array(left_column), make_istring_array(right_column), &left_column, pool));
+                    }
                     break;
                 }
                 default:
@@ -144,24 +361,22 @@ static inline arrow::Status unify_outer_on_columns(std::shared_ptr<arrow::Record
         return arrow::Status::OK();
     }
 
-    template <typename TIndexBuilder>
-    arrow::Status join_impl(std::shared_ptr<arrow::RecordBatch> left, std::shared_ptr<arrow::RecordBatch> right,
-                            std::shared_ptr<arrow::Array> left_index_array,
-                            std::shared_ptr<arrow::Array> right_index_array, std::vector<std::string> on,
-                            std::shared_ptr<arrow::RecordBatch> *table_out, std::string right_prefix, bool is_outer = false) {
-        auto left_index = make_index(left_index_array);
-        auto right_index = make_index(right_index_array);
-        TIndexBuilder index_builder;
-        auto comparer = make_comparer(left, right, on);
-        int64_t lindex = 0, rindex = 0, lend = left->num_rows(), rend = right->num_rows();
+    /**
+     * Walk both sorted indices from lbegin and rbegin and pass the left only, right only and matching rows to the
+     * index builder.
+     */
+    template <typename TIndexBuilder, typename TComparer>
+    arrow::Status merge_indices(const IIndexRecordBatch& left_index, const IIndexRecordBatch& right_index, int64_t lbegin, int64_t lend, int64_t rbegin, int64_t rend, const TComparer& comparer, TIndexBuilder& index_builder) {
+        int64_t lindex = lbegin, rindex = rbegin;
         while (lindex < lend && rindex < rend) {
-            auto li = left_index->get_index(lindex);
-            auto ri = right_index->get_index(rindex);
-            if (comparer->lt(li, ri)) {
+            auto li = left_index.get_index(lindex);
+            auto ri = right_index.get_index(rindex);
+            auto ret = comparer.cmp(li, ri);
+            if (ret < 0) {
                 ARROW_RETURN_NOT_OK(index_builder.left_only(li));
                 lindex++;
             }
-            else if (comparer->gt(li, ri)) {
+            else if (ret > 0) {
                 ARROW_RETURN_NOT_OK(index_builder.right_only(ri));
                 rindex++;
             }
@@ -169,20 +384,20 @@ static inline arrow::Status unify_outer_on_columns(std::shared_ptr<arrow::Record
                 int64_t li_end = lindex + 1;
                 int64_t ri_end = rindex + 1;
                 for (; li_end < lend; li_end++) {
-                    auto li_temp = left_index->get_index(li_end);
-                    if (comparer->gt(li_temp, ri)) {
+                    auto li_temp = left_index.get_index(li_end);
+                    if (comparer.gt(li_temp, ri)) {
                         break;
                     }
                 }
                 for (; ri_end < rend; ri_end++) {
-                    auto ri_temp = right_index->get_index(ri_end);
-                    if (comparer->lt(li, ri_temp)) {
+                    auto ri_temp = right_index.get_index(ri_end);
+                    if (comparer.lt(li, ri_temp)) {
                         break;
                     }
                 }
                 for (auto l = lindex; l < li_end; l++) {
                     for (auto r = rindex; r < ri_end; r++) {
-                        ARROW_RETURN_NOT_OK(index_builder.both(left_index->get_index(l), right_index->get_index(r)));
+                        ARROW_RETURN_NOT_OK(index_builder.both(left_index.get_index(l), right_index.get_index(r)));
                     }
                 }
                 lindex = li_end;
@@ -191,42 +406,180 @@ static inline arrow::Status unify_outer_on_columns(std::shared_ptr<arrow::Record
         }
 
         while (lindex < lend) {
-            auto li = left_index->get_index(lindex);
+            auto li = left_index.get_index(lindex);
             ARROW_RETURN_NOT_OK(index_builder.left_only(li));
             lindex++;
         }
         while (rindex < rend) {
-            auto ri = right_index->get_index(rindex);
+            auto ri = right_index.get_index(rindex);
             ARROW_RETURN_NOT_OK(index_builder.right_only(ri));
             rindex++;
         }
+        return arrow::Status::OK();
+    }
 
-        std::shared_ptr<arrow::Array> left_array,  right_array;
-        ARROW_RETURN_NOT_OK(index_builder.finish(&left_array, &right_array));
+    /**
+     * Length of the prefix of the sorted index whose rows are null in key, which is all its null rows as nulls sort
+     * first.
+     */
+    static inline int64_t null_prefix(const IIndexRecordBatch& index, const std::shared_ptr<arrow::Array>& key, int64_t length) {
+        int64_t ret = 0;
+        if (key) {
+            while (ret < length && key->IsNull(index.get_index(ret))) {
+                ret++;
+            }
+        }
+        return ret;
+    }
 
-        ARROW_RETURN_NOT_OK(batch_by_index(left, left_array, &left));
+    /**
+     * The row indices into left and right of the joined rows, -1 where a side has no row. With a single key column
+     * the null key runs, which lead both indices, are joined in one step, null matching null, and the rest is merged
+     * by a comparer without null checks.
+     */
+    template <typename TIndexBuilder>
+    arrow::Status join_indices(std::shared_ptr<arrow::RecordBatch> left, std::shared_ptr<arrow::RecordBatch> right,
+                               std::shared_ptr<arrow::Array> left_index_array, std::shared_ptr<arrow::Array> right_index_array, std::vector<std::string> on,
+                               std::shared_ptr<arrow::Array>* left_array, std::shared_ptr<arrow::Array>* right_array, arrow::MemoryPool* pool = arrow::default_memory_pool(),
+                               DictionaryRanksCache* ranks = nullptr) {
+        auto left_index = make_index(left_index_array);
+        auto right_index = make_index(right_index_array);
+        TIndexBuilder index_builder(pool);
+        auto left_key = nullable_key(left, on);
+        auto right_key = nullable_key(right, on);
+        auto left_nulls = null_prefix(*left_index, left_key, left->num_rows());
+        auto right_nulls = null_prefix(*right_index, right_key, right->num_rows());
+        if (left_nulls > 0 && right_nulls > 0) {
+            for (int64_t l = 0; l < left_nulls; l++) {
+                for (int64_t r = 0; r < right_nulls; r++) {
+                    ARROW_RETURN_NOT_OK(index_builder.both(left_index->get_index(l), right_index->get_index(r)));
+                }
+            }
+        }
+        else {
+            for (int64_t l = 0; l < left_nulls; l++) {
+                ARROW_RETURN_NOT_OK(index_builder.left_only(left_index->get_index(l)));
+            }
+            for (int64_t r = 0; r < right_nulls; r++) {
+                ARROW_RETURN_NOT_OK(index_builder.right_only(right_index->get_index(r)));
+            }
+        }
+        if (left_key) {
+            left = without_key_nulls(left, on[0]);
+        }
+        if (right_key) {
+            right = without_key_nulls(right, on[0]);
+        }
+        //The merge compares most rows, and mostly rows with different keys, so the prefixes pay off
+        StringPrefixCache prefixes;
+        ARROW_RETURN_NOT_OK(with_comparer(left, right, on, [&](const auto& comparer) {
+            return merge_indices(*left_index, *right_index, left_nulls, left->num_rows(), right_nulls, right->num_rows(), comparer, index_builder);
+        }, ranks, &prefixes));
+        return index_builder.finish(left_array, right_array);
+    }
 
-        for (int64_t i = 0; i < right->num_columns(); i++) {
-            auto name = right->column_name(i);
+    /**
+     * How the rows of a join are matched: a merge of both sides in sort order, or a hash table of the right side
+     * which the left rows are looked up in. The indices of a hash join are not used.
+     */
+    enum class JoinMethod {Sort, Hash};
+
+    template <typename TIndexBuilder>
+    arrow::Status join_indices(std::shared_ptr<arrow::RecordBatch> left, std::shared_ptr<arrow::RecordBatch> right,
+                               std::shared_ptr<arrow::Array> left_index_array, std::shared_ptr<arrow::Array> right_index_array, std::vector<std::string> on,
+                               std::shared_ptr<arrow::Array>* left_array, std::shared_ptr<arrow::Array>* right_array, JoinMethod method, arrow::MemoryPool* pool,
+                               DictionaryRanksCache* ranks = nullptr) {
+        if (method == JoinMethod::Hash) {
+            return hash_join_indices<TIndexBuilder>(left, right, on, left_array, right_array, pool, ranks);
+        }
+        return join_indices<TIndexBuilder>(left, right, left_index_array, right_index_array, on, left_array, right_array, pool, ranks);
+    }
+
+    /**
+     * The columns a join gathers: the selected columns of left, and of right the selected non key columns, renamed
+     * with right_prefix, and the on columns which an outer join unifies with those of left.
+     */
+    struct JoinColumns {
+        std::vector<int> left;
+        std::vector<int> right;
+        std::vector<std::string> right_names;
+        std::vector<std::string> unified_on;
+    };
+
+    static inline arrow::Status join_columns(const arrow::Schema& left, const arrow::Schema& right, const std::vector<std::string>& on, const std::string& right_prefix, bool is_outer,
+                                             const std::vector<std::string>& columns, const std::vector<std::string>& right_columns, JoinColumns* join_out) {
+        JoinColumns ret;
+        for (int i = 0; i < left.num_fields(); i++) {
+            if (columns.empty()) {
+                ret.left.push_back(i);
+            }
+        }
+        for (auto& name: columns) {
+            auto i = left.GetFieldIndex(name);
+            if (i < 0) {
+                return arrow::Status::KeyError("No such column: " + name);
+            }
+            ret.left.push_back(i);
+        }
+        for (auto& name: right_columns) {
+            if (right.GetFieldIndex(name) < 0) {
+                return arrow::Status::KeyError("No such column: " + name);
+            }
+        }
+        for (auto& name: on) {
+            if (is_outer && (columns.empty() || std::find(columns.begin(), columns.end(), name) != columns.end())) {
+                ret.unified_on.push_back(name);
+            }
+        }
+        for (int i = 0; i < right.num_fields(); i++) {
+            auto& name = right.field(i)->name();
             if (std::find(on.begin(), on.end(), name) != on.end()) {
-                if (!is_outer) {
-                    ARROW_RETURN_NOT_OK(right->RemoveColumn(i--, &right));
+                if (std::find(ret.unified_on.begin(), ret.unified_on.end(), name) != ret.unified_on.end()) {
+                    ret.right.push_back(i);
+                    ret.right_names.push_back(name);
                 }
             }
-            else if (!right_prefix.empty()) {
-                auto c = right->column(i);
-                auto cn = right->column_name(i) + right_prefix;
-                ARROW_RETURN_NOT_OK(right->RemoveColumn(i, &right));
-                ARROW_RETURN_NOT_OK(right->AddColumn(i, arrow::field(cn, c->type()), c, &right));
+            else if (right_columns.empty() || std::find(right_columns.begin(), right_columns.end(), name) != right_columns.end()) {
+                ret.right.push_back(i);
+                ret.right_names.push_back(name + right_prefix);
             }
         }
+        *join_out = std::move(ret);
+        return arrow::Status::OK();
+    }
 
-        ARROW_RETURN_NOT_OK(batch_by_index(right, right_array, &right));
+    /**
+     * The fields at indices, renamed to names if given.
+     */
+    static inline std::shared_ptr<arrow::Schema> project_schema(const arrow::Schema& schema, const std::vector<int>& indices, const std::vector<std::string>& names = {}) {
+        std::vector<std::shared_ptr<arrow::Field>> fields;
+        for (size_t i = 0; i < indices.size(); i++) {
+            auto field = schema.field(indices[i]);
+            fields.push_back(names.empty() ? field : arrow::field(names[i], field->type()));
+        }
+        return arrow::schema(fields, schema.metadata());
+    }
 
+    /**
+     * The columns at indices, renamed to names if given. No data is copied.
+     */
+    static inline std::shared_ptr<arrow::RecordBatch> project_batch(const std::shared_ptr<arrow::RecordBatch>& batch, const std::vector<int>& indices, const std::vector<std::string>& names = {}) {
+        std::vector<std::shared_ptr<arrow::Array>> arrays;
+        for (auto i: indices) {
+            arrays.push_back(batch->column(i));
+        }
+        return arrow::RecordBatch::Make(project_schema(*batch->schema(), indices, names), batch->num_rows(), arrays);
+    }
+
+    /**
+     * Append the gathered right columns to the gathered left columns, after unifying the on columns of an outer join
+     * with the dictionary ranks the join compared them by.
+     */
+    static inline arrow::Status finish_join(std::shared_ptr<arrow::RecordBatch> left, std::shared_ptr<arrow::RecordBatch> right, const std::vector<std::string>& unified_on, bool is_outer,
+                                            std::shared_ptr<arrow::RecordBatch>* table_out, arrow::MemoryPool* pool, DictionaryRanksCache* ranks = nullptr) {
         if (is_outer) {
             //Unify the index columns from left/right. If left is a null, it should get the value from the right;
-            ARROW_RETURN_NOT_OK(unify_outer_on_columns(left, right, on, &left, &right));
-
+            ARROW_RETURN_NOT_OK(unify_outer_on_columns(left, right, unified_on, &left, &right, pool, ranks));
         }
 
         for (int64_t i = 0; i < right->num_columns(); i++) {
@@ -237,5 +590,185 @@ static inline arrow::Status unify_outer_on_columns(std::shared_ptr<arrow::Record
         return arrow::Status::OK();
     }
 
+    /**
+     * Join left and right on the sorted indices. Only the selected columns of left and the selected non key columns of
+     * right are gathered, all if none are selected. The on columns of an outer join are unified if they are selected.
+     */
+    template <typename TIndexBuilder>
+    arrow::Status join_impl(std::shared_ptr<arrow::RecordBatch> left, std::shared_ptr<arrow::RecordBatch> right,
+                            std::shared_ptr<arrow::Array> left_index_array,
+                            std::shared_ptr<arrow::Array> right_index_array, std::vector<std::string> on,
+                            std::shared_ptr<arrow::RecordBatch> *table_out, std::string right_prefix, bool is_outer = false, int num_threads = 1,
+                            std::vector<std::string> columns = {}, std::vector<std::string> right_columns = {}, arrow::MemoryPool* pool = arrow::default_memory_pool(), JoinMethod method = JoinMethod::Sort,
+                            const GatherOptions& gather = GatherOptions()) {
+        DictionaryRanksCache ranks;
+        std::shared_ptr<arrow::Array> left_array,  right_array;
+        ARROW_RETURN_NOT_OK(join_indices<TIndexBuilder>(left, right, left_index_array, right_index_array, on, &left_array, &right_array, method, pool, &ranks));
+
+        JoinColumns join;
+        ARROW_RETURN_NOT_OK(join_columns(*left->schema(), *right->schema(), on, right_prefix, is_outer, columns, right_columns, &join));
+        ARROW_RETURN_NOT_OK(batch_by_index(project_batch(left, join.left), left_array, &left, num_threads, pool, gather));
+        ARROW_RETURN_NOT_OK(batch_by_index(project_batch(right, join.right, join.right_names), right_array, &right, num_threads, pool, gather));
+        return finish_join(left, right, join.unified_on, is_outer, table_out, pool, &ranks);
+    }
+
+    /**
+     * Compares positions in the chunked indices of two lists of batches. The comparer of a pair of chunks is made
+     * when the merge first reaches it.
+     */
+    class ChunkedIndexComparer {
+    public:
+        ChunkedIndexComparer(std::vector<std::shared_ptr<arrow::RecordBatch>> left, ChunkedIndex left_index, std::vector<std::shared_ptr<arrow::RecordBatch>> right, ChunkedIndex right_index, std::vector<std::string> on,
+                             DictionaryRanksCache* ranks = nullptr)
+                : _left(std::move(left)), _right(std::move(right)), _left_index(std::move(left_index)), _right_index(std::move(right_index)),
+                  _on(std::move(on)), _ranks(ranks), _comparers(_left.size() * _right.size()) {
+        }
+
+        int cmp(int64_t position1, int64_t position2) const {
+            return comparer(position1, position2).cmp(_left_index.rows->Value(position1), _right_index.rows->Value(position2));
+        }
+
+        bool lt(int64_t position1, int64_t position2) const {
+            return comparer(position1, position2).lt(_left_index.rows->Value(position1), _right_index.rows->Value(position2));
+        }
+
+        bool gt(int64_t position1, int64_t position2) const {
+            return comparer(position1, position2).gt(_left_index.rows->Value(position1), _right_index.rows->Value(position2));
+        }
+
+    private:
+        const IComparer& comparer(int64_t position1, int64_t position2) const {
+            auto chunk1 = _left_index.chunks->Value(position1);
+            auto chunk2 = _right_index.chunks->Value(position2);
+            auto& ret = _comparers[chunk1 * _right.size() + chunk2];
+            if (!ret) {
+                ret = make_comparer(_left[chunk1], _right[chunk2], _on, _ranks);
+            }
+            return *ret;
+        }
+
+        std::vector<std::shared_ptr<arrow::RecordBatch>> _left, _right;
+        ChunkedIndex _left_index, _right_index;
+        std::vector<std::string> _on;
+        DictionaryRanksCache* _ranks;
+        mutable std::vector<std::shared_ptr<IComparer>> _comparers;
+    };
+
+    /**
+     * The (chunk, row) of index at every position, with a null row where the position is -1.
+     */
+    static inline arrow::Status chunked_index_by_positions(const ChunkedIndex& index, const std::shared_ptr<arrow::Array>& positions, ChunkedIndex* index_out, arrow::MemoryPool* pool) {
+        auto typed_positions = make_index(positions);
+        arrow::Int32Builder chunks(pool);
+        arrow::Int64Builder rows(pool);
+        ARROW_RETURN_NOT_OK(chunks.Reserve(positions->length()));
+        ARROW_RETURN_NOT_OK(rows.Reserve(positions->length()));
+        for (int64_t i = 0; i < positions->length(); i++) {
+            auto position = typed_positions->get_index(i);
+            if (position < 0) {
+                chunks.UnsafeAppend(0);
+                rows.UnsafeAppendNull();
+            }
+            else {
+                chunks.UnsafeAppend(index.chunks->Value(position));
+                rows.UnsafeAppend(index.rows->Value(position));
+            }
+        }
+        std::shared_ptr<arrow::Array> chunks_array, rows_array;
+        ARROW_RETURN_NOT_OK(chunks.Finish(&chunks_array));
+        ARROW_RETURN_NOT_OK(rows.Finish(&rows_array));
+        index_out->chunks = std::static_pointer_cast<arrow::Int32Array>(chunks_array);
+        index_out->rows = std::static_pointer_cast<arrow::Int64Array>(rows_array);
+        return arrow::Status::OK();
+    }
+
+    /**
+     * Like join_impl for the chunks of two tables, which are neither concatenated nor sorted into a copy: every chunk
+     * is indexed on its own, the chunked indices are merged and the result is gathered from the chunks.
+     */
+    template <typename TIndexBuilder>
+    arrow::Status table_join_impl(std::shared_ptr<arrow::Table> left, std::shared_ptr<arrow::Table> right, std::vector<std::string> on,
+                                  std::shared_ptr<arrow::RecordBatch>* batch_out, std::string right_prefix, bool is_outer = false, int num_threads = 1,
+                                  std::vector<std::string> columns = {}, std::vector<std::string> right_columns = {}, arrow::MemoryPool* pool = arrow::default_memory_pool()) {
+        std::vector<std::shared_ptr<arrow::RecordBatch>> left_batches, right_batches;
+        ARROW_RETURN_NOT_OK(table_batches(*left, &left_batches));
+        ARROW_RETURN_NOT_OK(table_batches(*right, &right_batches));
+        ChunkedIndex left_index, right_index;
+        ARROW_RETURN_NOT_OK(make_chunked_index(left_batches, on, &left_index, num_threads, pool));
+        ARROW_RETURN_NOT_OK(make_chunked_index(right_batches, on, &right_index, num_threads, pool));
+
+        TIndexBuilder index_builder(pool);
+        DictionaryRanksCache ranks;
+        ChunkedIndexComparer comparer(left_batches, left_index, right_batches, right_index, on, &ranks);
+        SortedIndexRecordBatch positions;
+        ARROW_RETURN_NOT_OK(merge_indices(positions, positions, 0, left_index.length(), 0, right_index.length(), comparer, index_builder));
+        std::shared_ptr<arrow::Array> left_positions, right_positions;
+        ARROW_RETURN_NOT_OK(index_builder.finish(&left_positions, &right_positions));
+        ChunkedIndex left_rows, right_rows;
+        ARROW_RETURN_NOT_OK(chunked_index_by_positions(left_index, left_positions, &left_rows, pool));
+        ARROW_RETURN_NOT_OK(chunked_index_by_positions(right_index, right_positions, &right_rows, pool));
+
+        JoinColumns join;
+        ARROW_RETURN_NOT_OK(join_columns(*left->schema(), *right->schema(), on, right_prefix, is_outer, columns, right_columns, &join));
+        for (auto& b: left_batches) {
+            b = project_batch(b, join.left);
+        }
+        for (auto& b: right_batches) {
+            b = project_batch(b, join.right, join.right_names);
+        }
+        std::shared_ptr<arrow::RecordBatch> left_batch, right_batch;
+        ARROW_RETURN_NOT_OK(batches_by_index(project_schema(*left->schema(), join.left), left_batches, left_rows, &left_batch, num_threads, pool));
+        ARROW_RETURN_NOT_OK(batches_by_index(project_schema(*right->schema(), join.right, join.right_names), right_batches, right_rows, &right_batch, num_threads, pool));
+        return finish_join(left_batch, right_batch, join.unified_on, is_outer, batch_out, pool, &ranks);
+    }
+
+    /**
+     * Like join_impl, but the columns are gathered when first accessed. Only the on columns of an outer join, which
+     * are unified from both sides, are gathered right away.
+     */
+    template <typename TIndexBuilder>
+    arrow::Status lazy_join_impl(std::shared_ptr<arrow::RecordBatch> left, std::shared_ptr<arrow::RecordBatch> right,
+                                 std::shared_ptr<arrow::Array> left_index_array,
+                                 std::shared_ptr<arrow::Array> right_index_array, std::vector<std::string> on,
+                                 std::shared_ptr<LazyRecordBatch>* lazy_out, std::string right_prefix, bool is_outer = false, int num_threads = 1,
+                                 std::vector<std::string> columns = {}, std::vector<std::string> right_columns = {}, arrow::MemoryPool* pool = arrow::default_memory_pool(), JoinMethod method = JoinMethod::Sort,
+                                 const GatherOptions& gather = GatherOptions()) {
+        DictionaryRanksCache ranks;
+        std::shared_ptr<arrow::Array> left_array,  right_array;
+        ARROW_RETURN_NOT_OK(join_indices<TIndexBuilder>(left, right, left_index_array, right_index_array, on, &left_array, &right_array, method, pool, &ranks));
+
+        JoinColumns join;
+        ARROW_RETURN_NOT_OK(join_columns(*left->schema(), *right->schema(), on, right_prefix, is_outer, columns, right_columns, &join));
+        auto is_unified = [&join](const std::string& name) {
+            return std::find(join.unified_on.begin(), join.unified_on.end(), name) != join.unified_on.end();
+        };
+        std::shared_ptr<arrow::RecordBatch> left_on, right_on;
+        if (!join.unified_on.empty()) {
+            ARROW_RETURN_NOT_OK(select_columns(left, join.unified_on, &left_on));
+            ARROW_RETURN_NOT_OK(select_columns(right, join.unified_on, &right_on));
+            ARROW_RETURN_NOT_OK(batch_by_index(left_on, left_array, &left_on, num_threads, pool, gather));
+            ARROW_RETURN_NOT_OK(batch_by_index(right_on, right_array, &right_on, num_threads, pool, gather));
+            ARROW_RETURN_NOT_OK(unify_outer_on_columns(left_on, right_on, join.unified_on, &left_on, &right_on, pool, &ranks));
+        }
+
+        auto lazy = std::make_shared<LazyRecordBatch>(left_array->length(), num_threads, pool, gather);
+        for (auto i: join.left) {
+            auto name = left->column_name(i);
+            if (is_unified(name)) {
+                lazy->add_column(name, left_on->GetColumnByName(name), nullptr);
+            }
+            else {
+                lazy->add_column(name, left->column(i), left_array);
+            }
+        }
+        for (size_t i = 0; i < join.right.size(); i++) {
+            if (!is_unified(right->column_name(join.right[i]))) {
+                lazy->add_column(join.right_names[i], right->column(join.right[i]), right_array);
+            }
+        }
+        *lazy_out = lazy;
+        return arrow::Status::OK();
+    }
+
 }
 #endif //MARROW_MERGE_H
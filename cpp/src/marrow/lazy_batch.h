@@ -0,0 +1,161 @@
+#ifndef MARROW_LAZY_BATCH_H
+#define MARROW_LAZY_BATCH_H
+
+#include <string>
+#include <vector>
+#include <arrow/record_batch.h>
+#include "marrow/parallel.h"
+#include "marrow/sort.h"
+
+namespace marrow {
+
+    /**
+     * The result of a sort or merge whose columns are gathered by index when they are first accessed, and then
+     * cached. Columns which are never read are never gathered, those which are are gathered with the given options.
+     * Not safe for concurrent use.
+     */
+    class LazyRecordBatch {
+    public:
+        LazyRecordBatch(int64_t num_rows, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool(), const GatherOptions& options = GatherOptions())
+                : _num_rows(num_rows), _num_threads(num_threads), _pool(pool), _options(options) {}
+
+        /**
+         * A lazy view of the batch in index order, a null index is the batch as it is.
+         */
+        static std::shared_ptr<LazyRecordBatch> make(const std::shared_ptr<arrow::RecordBatch>& batch, std::shared_ptr<arrow::Array> index, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool(),
+                                                     const GatherOptions& options = GatherOptions()) {
+            auto ret = std::make_shared<LazyRecordBatch>(index ? index->length() : batch->num_rows(), num_threads, pool, options);
+            for (int i = 0; i < batch->num_columns(); i++) {
+                ret->add_column(batch->column_name(i), batch->column(i), index);
+            }
+            return ret;
+        }
+
+        /**
+         * Add a column gathered from array by index on first access, a null index takes array as it is.
+         */
+        void add_column(const std::string& name, std::shared_ptr<arrow::Array> array, std::shared_ptr<arrow::Array> index) {
+            auto type = array->type();
+            _fields.push_back(arrow::field(name, type));
+            _columns.push_back(Column{std::move(array), std::move(index), nullptr});
+        }
+
+        int64_t num_rows() const {
+            return _num_rows;
+        }
+
+        int num_columns() const {
+            return static_cast<int>(_columns.size());
+        }
+
+        const std::string& column_name(int i) const {
+            return _fields[i]->name();
+        }
+
+        std::shared_ptr<arrow::Schema> schema() const {
+            return arrow::schema(_fields);
+        }
+
+        bool is_materialized(int i) const {
+            return _columns[i].gathered != nullptr;
+        }
+
+        arrow::Status column(int i, std::shared_ptr<arrow::Array>* array_out) {
+            ARROW_RETURN_NOT_OK(gather(i, _num_threads));
+            *array_out = _columns[i].gathered;
+            return arrow::Status::OK();
+        }
+
+        arrow::Status column(const std::string& name, std::shared_ptr<arrow::Array>* array_out) {
+            int i;
+            ARROW_RETURN_NOT_OK(column_index(name, &i));
+            return column(i, array_out);
+        }
+
+        /**
+         * A record batch of the given columns in the given order. Columns which are not gathered yet are gathered
+         * concurrently.
+         */
+        arrow::Status materialize(const std::vector<std::string>& columns, std::shared_ptr<arrow::RecordBatch>* batch_out) {
+            std::vector<int> indices;
+            for (auto& name: columns) {
+                int i;
+                ARROW_RETURN_NOT_OK(column_index(name, &i));
+                indices.push_back(i);
+            }
+            return materialize(indices, batch_out);
+        }
+
+        /**
+         * A record batch of all columns.
+         */
+        arrow::Status materialize(std::shared_ptr<arrow::RecordBatch>* batch_out) {
+            std::vector<int> indices;
+            for (int i = 0; i < num_columns(); i++) {
+                indices.push_back(i);
+            }
+            return materialize(indices, batch_out);
+        }
+
+    private:
+        struct Column {
+            std::shared_ptr<arrow::Array> array;
+            std::shared_ptr<arrow::Array> index;
+            std::shared_ptr<arrow::Array> gathered;
+        };
+
+        arrow::Status column_index(const std::string& name, int* index_out) const {
+            for (int i = 0; i < num_columns(); i++) {
+                if (_fields[i]->name() == name) {
+                    *index_out = i;
+                    return arrow::Status::OK();
+                }
+            }
+            return arrow::Status::KeyError("No such column: " + name);
+        }
+
+        arrow::Status gather(int i, int num_threads) {
+            auto& c = _columns[i];
+            if (!c.gathered) {
+                if (c.index) {
+                    ARROW_RETURN_NOT_OK(column_by_index(c.array, c.index, &c.gathered, num_threads, _pool, _options));
+                }
+                else {
+                    c.gathered = c.array;
+                }
+            }
+            return arrow::Status::OK();
+        }
+
+        arrow::Status materialize(const std::vector<int>& indices, std::shared_ptr<arrow::RecordBatch>* batch_out) {
+            std::vector<int> missing;
+            for (auto i: indices) {
+                if (!is_materialized(i) && std::find(missing.begin(), missing.end(), i) == missing.end()) {
+                    missing.push_back(i);
+                }
+            }
+            int column_threads = std::max(1, _num_threads / std::max<int>(1, static_cast<int>(missing.size())));
+            ARROW_RETURN_NOT_OK(parallel_for(missing.size(), _num_threads, [&](int64_t m) {
+                return gather(missing[m], column_threads);
+            }));
+
+            std::vector<std::shared_ptr<arrow::Field>> fields;
+            std::vector<std::shared_ptr<arrow::Array>> arrays;
+            for (auto i: indices) {
+                fields.push_back(_fields[i]);
+                arrays.push_back(_columns[i].gathered);
+            }
+            *batch_out = arrow::RecordBatch::Make(arrow::schema(fields), _num_rows, arrays);
+            return arrow::Status::OK();
+        }
+
+        int64_t _num_rows;
+        int _num_threads;
+        arrow::MemoryPool* _pool;
+        GatherOptions _options;
+        std::vector<std::shared_ptr<arrow::Field>> _fields;
+        std::vector<Column> _columns;
+    };
+}
+
+#endif //MARROW_LAZY_BATCH_H
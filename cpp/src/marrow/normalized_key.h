@@ -0,0 +1,269 @@
+#ifndef MARROW_NORMALIZED_KEY_H
+#define MARROW_NORMALIZED_KEY_H
+
+#include <arrow/array.h>
+#include <arrow/record_batch.h>
+#include <cstring>
+#include <vector>
+#include "marrow/compare.h"
+#include "marrow/dictionary_rank.h"
+#include "marrow/radix_sort.h"
+#include "marrow/string_array.h"
+
+namespace marrow {
+
+    /**
+     * Writes one column of a normalized key. Nulls are a 0 marker byte (only present if the column has nulls),
+     * numbers are big endian order preserving bytes, strings have 0 bytes escaped as 0x00 0x01 and end in 0x00 0x00
+     * and string dictionaries are the rank of their value.
+     */
+    class IKeyEncoder {
+    public:
+        virtual ~IKeyEncoder() = default;
+        virtual int64_t length(int64_t index) const = 0;
+        virtual uint8_t* write(int64_t index, uint8_t* out) const = 0;
+    };
+
+    template<typename TArray>
+    class FixedWidthKeyEncoder : public IKeyEncoder {
+    public:
+        typedef RadixKey<typename TArray::value_type> Key;
+
+        FixedWidthKeyEncoder(std::shared_ptr<arrow::Array> array, bool has_nulls) : _array(std::static_pointer_cast<TArray>(array)), _has_nulls(has_nulls) {
+        }
+
+        int64_t length(int64_t index) const final {
+            if (_has_nulls) {
+                return _array->IsNull(index) ? 1 : 1 + sizeof(typename Key::type);
+            }
+            return sizeof(typename Key::type);
+        }
+
+        uint8_t* write(int64_t index, uint8_t* out) const final {
+            if (_has_nulls) {
+                if (_array->IsNull(index)) {
+                    *out++ = 0;
+                    return out;
+                }
+                *out++ = 1;
+            }
+            auto key = Key::encode(_array->Value(index));
+            for (int shift = (sizeof(key) - 1) * 8; shift >= 0; shift -= 8) {
+                *out++ = static_cast<uint8_t>(key >> shift);
+            }
+            return out;
+        }
+
+    private:
+        std::shared_ptr<TArray> _array;
+        bool _has_nulls;
+    };
+
+    class StringKeyEncoder : public IKeyEncoder {
+    public:
+        StringKeyEncoder(std::shared_ptr<arrow::Array> array, bool has_nulls) : _array(make_istring_array(array)), _has_nulls(has_nulls) {
+        }
+
+        int64_t length(int64_t index) const final {
+            if (_has_nulls && _array->IsNull(index)) {
+                return 1;
+            }
+            auto value = _array->Value(index);
+            int64_t ret = value.size() + 2 + (_has_nulls ? 1 : 0);
+            auto it = value.data(), end = value.data() + value.size();
+            while ((it = static_cast<const char*>(std::memchr(it, 0, end - it))) != nullptr) {
+                ret++;
+                it++;
+            }
+            return ret;
+        }
+
+        uint8_t* write(int64_t index, uint8_t* out) const final {
+            if (_has_nulls) {
+                if (_array->IsNull(index)) {
+                    *out++ = 0;
+                    return out;
+                }
+                *out++ = 1;
+            }
+            for (auto c: _array->Value(index)) {
+                *out++ = static_cast<uint8_t>(c);
+                if (c == 0) {
+                    *out++ = 1;
+                }
+            }
+            *out++ = 0;
+            *out++ = 0;
+            return out;
+        }
+
+    private:
+        std::shared_ptr<IStringArray> _array;
+        bool _has_nulls;
+    };
+
+    /**
+     * Encodes string dictionary codes by the rank of their string, in as few big endian bytes as the number of ranks
+     * needs.
+     */
+    template<typename TIndexArray>
+    class DictionaryRankKeyEncoder : public IKeyEncoder {
+    public:
+        DictionaryRankKeyEncoder(std::shared_ptr<arrow::Array> array, bool has_nulls)
+                : _indices(std::static_pointer_cast<TIndexArray>(std::static_pointer_cast<arrow::DictionaryArray>(array)->indices())),
+                  _ranks(dictionary_ranks(static_cast<const arrow::StringArray&>(*std::static_pointer_cast<arrow::DictionaryArray>(array)->dictionary()))),
+                  _width(_ranks.size() <= 0x100 ? 1 : (_ranks.size() <= 0x10000 ? 2 : 4)),
+                  _has_nulls(has_nulls) {
+        }
+
+        int64_t length(int64_t index) const final {
+            if (_has_nulls) {
+                return _indices->IsNull(index) ? 1 : 1 + _width;
+            }
+            return _width;
+        }
+
+        uint8_t* write(int64_t index, uint8_t* out) const final {
+            if (_has_nulls) {
+                if (_indices->IsNull(index)) {
+                    *out++ = 0;
+                    return out;
+                }
+                *out++ = 1;
+            }
+            auto rank = _ranks[_indices->Value(index)];
+            for (int shift = (_width - 1) * 8; shift >= 0; shift -= 8) {
+                *out++ = static_cast<uint8_t>(rank >> shift);
+            }
+            return out;
+        }
+
+    private:
+        std::shared_ptr<TIndexArray> _indices;
+        std::vector<uint32_t> _ranks;
+        int _width;
+        bool _has_nulls;
+    };
+
+    /**
+     * Keys which are compared across batches always have the null marker and encode dictionary strings instead of
+     * their ranks, which are only comparable within one dictionary.
+     */
+    static inline std::shared_ptr<IKeyEncoder> make_key_encoder(std::shared_ptr<arrow::Array> array, bool across_batches = false) {
+        bool has_nulls = across_batches || array->null_count() != 0;
+        switch (array->type_id()) {
+            case arrow::Type::INT8:
+                return std::make_shared<FixedWidthKeyEncoder<arrow::Int8Array>>(array, has_nulls);
+            case arrow::Type::INT16:
+                return std::make_shared<FixedWidthKeyEncoder<arrow::Int16Array>>(array, has_nulls);
+            case arrow::Type::INT32:
+                return std::make_shared<FixedWidthKeyEncoder<arrow::Int32Array>>(array, has_nulls);
+            case arrow::Type::INT64:
+                return std::make_shared<FixedWidthKeyEncoder<arrow::Int64Array>>(array, has_nulls);
+            case arrow::Type::UINT8:
+                return std::make_shared<FixedWidthKeyEncoder<arrow::UInt8Array>>(array, has_nulls);
+            case arrow::Type::UINT16:
+                return std::make_shared<FixedWidthKeyEncoder<arrow::UInt16Array>>(array, has_nulls);
+            case arrow::Type::UINT32:
+                return std::make_shared<FixedWidthKeyEncoder<arrow::UInt32Array>>(array, has_nulls);
+            case arrow::Type::UINT64:
+                return std::make_shared<FixedWidthKeyEncoder<arrow::UInt64Array>>(array, has_nulls);
+            case arrow::Type::HALF_FLOAT:
+                //Same raw bit order as SimpleComparer<arrow::HalfFloatArray>
+                return std::make_shared<FixedWidthKeyEncoder<arrow::HalfFloatArray>>(array, has_nulls);
+            case arrow::Type::FLOAT:
+                return std::make_shared<FixedWidthKeyEncoder<arrow::FloatArray>>(array, has_nulls);
+            case arrow::Type::DOUBLE:
+                return std::make_shared<FixedWidthKeyEncoder<arrow::DoubleArray>>(array, has_nulls);
+            case arrow::Type::STRING:
+            case arrow::Type::LARGE_STRING:
+                return std::make_shared<StringKeyEncoder>(array, has_nulls);
+            case arrow::Type::DICTIONARY:
+                if (!across_batches && is_string_dictionary(*array)) {
+                    auto indices = std::static_pointer_cast<arrow::DictionaryArray>(array)->indices();
+                    switch (indices->type_id()) {
+                        case arrow::Type::INT8:
+                            return std::make_shared<DictionaryRankKeyEncoder<arrow::Int8Array>>(array, has_nulls);
+                        case arrow::Type::INT16:
+                            return std::make_shared<DictionaryRankKeyEncoder<arrow::Int16Array>>(array, has_nulls);
+                        case arrow::Type::INT32:
+                            return std::make_shared<DictionaryRankKeyEncoder<arrow::Int32Array>>(array, has_nulls);
+                        default:
+                            break;
+                    }
+                }
+                return std::make_shared<StringKeyEncoder>(array, has_nulls);
+            default:
+                throw std::runtime_error("Unsupported array type for normalized key: " + array->type()->ToString());
+        }
+    }
+
+    /**
+     * Encodes all key columns of a batch once into one byte comparable key per row, so that multi column compares
+     * are a single memcmp instead of a chain of virtual compares per column. With across_batches the keys of different
+     * batches with the same columns are comparable with compare_keys.
+     */
+    class NormalizedKeyComparer : public IComparer {
+    public:
+        NormalizedKeyComparer(std::shared_ptr<arrow::RecordBatch> batch, const std::vector<std::string>& columns, bool across_batches = false) : _offsets(batch->num_rows() + 1, 0) {
+            std::vector<std::shared_ptr<IKeyEncoder>> encoders;
+            for (auto& c: columns) {
+                auto array = batch->GetColumnByName(c);
+                if (!array) {
+                    throw std::runtime_error("Column missing from batch: " + c);
+                }
+                encoders.push_back(make_key_encoder(array, across_batches));
+            }
+            auto n = batch->num_rows();
+            for (auto& e: encoders) {
+                for (int64_t i = 0; i < n; i++) {
+                    _offsets[i + 1] += e->length(i);
+                }
+            }
+            for (int64_t i = 0; i < n; i++) {
+                _offsets[i + 1] += _offsets[i];
+            }
+            _data.resize(_offsets[n]);
+            for (int64_t i = 0; i < n; i++) {
+                auto out = _data.data() + _offsets[i];
+                for (auto& e: encoders) {
+                    out = e->write(i, out);
+                }
+            }
+        }
+
+        bool lt(int64_t index1, int64_t index2) const final {
+            return compare(index1, index2) < 0;
+        }
+
+        bool gt(int64_t index1, int64_t index2) const final {
+            return compare(index1, index2) > 0;
+        }
+
+        int cmp(int64_t index1, int64_t index2) const final {
+            return compare(index1, index2);
+        }
+
+        int compare(int64_t index1, int64_t index2) const {
+            return compare_keys(key(index1), key(index2));
+        }
+
+        arrow::util::string_view key(int64_t index) const {
+            return arrow::util::string_view(reinterpret_cast<const char*>(_data.data() + _offsets[index]), _offsets[index + 1] - _offsets[index]);
+        }
+
+        static int compare_keys(arrow::util::string_view key1, arrow::util::string_view key2) {
+            auto ret = std::memcmp(key1.data(), key2.data(), std::min(key1.size(), key2.size()));
+            if (ret != 0) {
+                return ret;
+            }
+            return key1.size() < key2.size() ? -1 : (key1.size() > key2.size() ? 1 : 0);
+        }
+
+    private:
+        std::vector<int64_t> _offsets;
+        std::vector<uint8_t> _data;
+    };
+}
+
+#endif //MARROW_NORMALIZED_KEY_H
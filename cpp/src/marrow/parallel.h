@@ -0,0 +1,195 @@
+#ifndef MARROW_PARALLEL_H
+#define MARROW_PARALLEL_H
+
+#include <arrow/status.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace marrow {
+
+    /**
+     * Run task(0) ... task(num_tasks - 1) on up to num_threads threads. Returns the first failed status; exceptions
+     * thrown by a task are rethrown on the calling thread.
+     */
+    static inline arrow::Status parallel_for(int64_t num_tasks, int num_threads, const std::function<arrow::Status(int64_t)>& task) {
+        num_threads = static_cast<int>(std::max<int64_t>(1, std::min<int64_t>(num_threads, num_tasks)));
+        if (num_threads == 1) {
+            for (int64_t i = 0; i < num_tasks; i++) {
+                ARROW_RETURN_NOT_OK(task(i));
+            }
+            return arrow::Status::OK();
+        }
+
+        std::atomic<int64_t> next(0);
+        std::vector<arrow::Status> statuses(num_threads);
+        std::vector<std::exception_ptr> exceptions(num_threads);
+        auto worker = [&](int thread) {
+            try {
+                for (int64_t i = next++; i < num_tasks; i = next++) {
+                    statuses[thread] = task(i);
+                    if (!statuses[thread].ok()) {
+                        break;
+                    }
+                }
+            }
+            catch (...) {
+                exceptions[thread] = std::current_exception();
+            }
+        };
+        std::vector<std::thread> threads;
+        for (int t = 1; t < num_threads; t++) {
+            threads.emplace_back(worker, t);
+        }
+        worker(0);
+        for (auto& t: threads) {
+            t.join();
+        }
+        for (auto& e: exceptions) {
+            if (e) {
+                std::rethrow_exception(e);
+            }
+        }
+        for (auto& s: statuses) {
+            ARROW_RETURN_NOT_OK(s);
+        }
+        return arrow::Status::OK();
+    }
+
+    /**
+     * Blocks the threads which call wait until num_threads of them have, then releases them all. Can be reused.
+     */
+    class Barrier {
+    public:
+        explicit Barrier(int num_threads) : _num_threads(num_threads) {}
+
+        void wait() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            auto generation = _generation;
+            if (++_waiting == _num_threads) {
+                _waiting = 0;
+                _generation++;
+                _released.notify_all();
+                return;
+            }
+            _released.wait(lock, [&] {return _generation != generation;});
+        }
+
+    private:
+        std::mutex _mutex;
+        std::condition_variable _released;
+        int _num_threads;
+        int _waiting = 0;
+        int64_t _generation = 0;
+    };
+
+    /**
+     * The number of elements of the sorted a (of length length1) among the first d elements of the stable merge of a
+     * and b (of length length2), in which equal elements of a come first: the co-rank of d, found by binary search.
+     */
+    template<typename T, typename TLess>
+    int64_t merge_co_rank(const T* a, int64_t length1, const T* b, int64_t length2, int64_t d, TLess less) {
+        auto lo = std::max<int64_t>(0, d - length2);
+        auto hi = std::min<int64_t>(d, length1);
+        while (lo < hi) {
+            auto i = lo + (hi - lo) / 2;
+            auto j = d - i;
+            //a[i] comes before b[j - 1] unless b[j - 1] is less, so a[i] is among the first d
+            if (j > 0 && !less(b[j - 1], a[i])) {
+                lo = i + 1;
+            }
+            else {
+                hi = i;
+            }
+        }
+        return lo;
+    }
+
+    /**
+     * Merge the sorted runs [begin + bounds[i], begin + bounds[i + 1]) of [begin, end) pairwise, level by level. Every
+     * level is split by output position into one range per thread, whose start in both runs of a merge is found by
+     * merge_co_rank, so all threads merge every level, including the last single merge. The threads are started once
+     * and wait for each other between levels. The merge is stable, equal elements keep the order of their runs, so
+     * the result does not depend on num_threads.
+     */
+    template<typename T, typename TLess>
+    arrow::Status parallel_merge_runs(T* begin, T* end, std::vector<int64_t> bounds, int num_threads, TLess less) {
+        int64_t n = end - begin;
+        if (bounds.size() <= 2) {
+            return arrow::Status::OK();
+        }
+
+        //The run bounds of every level, the last level is a single run
+        std::vector<std::vector<int64_t>> levels = {std::move(bounds)};
+        while (levels.back().size() > 2) {
+            auto& runs = levels.back();
+            std::vector<int64_t> merged_bounds;
+            for (size_t i = 0; i < runs.size(); i += 2) {
+                merged_bounds.push_back(runs[i]);
+            }
+            if (merged_bounds.back() != n) {
+                merged_bounds.push_back(n);
+            }
+            levels.push_back(std::move(merged_bounds));
+        }
+
+        std::vector<T> scratch(n);
+        num_threads = static_cast<int>(std::max<int64_t>(1, std::min<int64_t>(num_threads, n)));
+        Barrier barrier(num_threads);
+        return parallel_for(num_threads, num_threads, [&](int64_t thread) {
+            auto out_begin = n * thread / num_threads;
+            auto out_end = n * (thread + 1) / num_threads;
+            T* from = begin;
+            T* to = scratch.data();
+            for (size_t level = 0; level + 1 < levels.size(); level++) {
+                auto& runs = levels[level];
+                auto& merged_bounds = levels[level + 1];
+                //The merges whose output overlaps the range of this thread
+                auto m = std::upper_bound(merged_bounds.begin(), merged_bounds.end(), out_begin) - merged_bounds.begin() - 1;
+                for (; m + 1 < static_cast<int64_t>(merged_bounds.size()) && merged_bounds[m] < out_end; m++) {
+                    auto first = merged_bounds[m], last = merged_bounds[m + 1];
+                    auto middle = std::min(runs[2 * m + 1], last);
+                    auto a = from + first, b = from + middle;
+                    auto length1 = middle - first, length2 = last - middle;
+                    auto d_begin = std::max(first, out_begin) - first;
+                    auto d_end = std::min(last, out_end) - first;
+                    auto i_begin = merge_co_rank(a, length1, b, length2, d_begin, less);
+                    auto i_end = merge_co_rank(a, length1, b, length2, d_end, less);
+                    std::merge(a + i_begin, a + i_end, b + (d_begin - i_begin), b + (d_end - i_end), to + first + d_begin, less);
+                }
+                barrier.wait();
+                std::swap(from, to);
+            }
+            if (from != begin) {
+                std::copy(from + out_begin, from + out_end, begin + out_begin);
+            }
+            return arrow::Status::OK();
+        });
+    }
+
+    /**
+     * Stable parallel sort of [begin, end): each thread sorts a contiguous run with sort_run, then the runs are merged
+     * pairwise in parallel. Equal elements keep the order of their runs, so the result is the same as a stable sort
+     * on one thread.
+     */
+    template<typename T, typename TLess, typename TSortRun>
+    arrow::Status parallel_stable_sort(T* begin, T* end, int num_threads, TLess less, TSortRun sort_run) {
+        int64_t n = end - begin;
+        int64_t num_runs = std::max<int64_t>(1, std::min<int64_t>(num_threads, n));
+        std::vector<int64_t> bounds(num_runs + 1);
+        for (int64_t i = 0; i <= num_runs; i++) {
+            bounds[i] = n * i / num_runs;
+        }
+        ARROW_RETURN_NOT_OK(parallel_for(num_runs, num_threads, [&](int64_t run) {
+            return sort_run(begin + bounds[run], begin + bounds[run + 1]);
+        }));
+        return parallel_merge_runs(begin, end, std::move(bounds), num_threads, less);
+    }
+}
+
+#endif //MARROW_PARALLEL_H
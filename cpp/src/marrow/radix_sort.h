@@ -0,0 +1,223 @@
+#ifndef MARROW_RADIX_SORT_H
+#define MARROW_RADIX_SORT_H
+
+#include <arrow/array.h>
+#include <arrow/record_batch.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include "marrow/dictionary_rank.h"
+
+namespace marrow {
+
+    /**
+     * Maps a fixed width value onto an unsigned key with the same ordering, so it can be sorted byte by byte.
+     */
+    template<typename TCType, typename Enable = void>
+    struct RadixKey;
+
+    template<typename TCType>
+    struct RadixKey<TCType, typename std::enable_if<std::is_integral<TCType>::value && std::is_unsigned<TCType>::value>::type> {
+        typedef TCType type;
+        static type encode(TCType value) {
+            return value;
+        }
+    };
+
+    template<typename TCType>
+    struct RadixKey<TCType, typename std::enable_if<std::is_integral<TCType>::value && std::is_signed<TCType>::value>::type> {
+        typedef typename std::make_unsigned<TCType>::type type;
+        static type encode(TCType value) {
+            return static_cast<type>(value) ^ (type(1) << (sizeof(type) * 8 - 1));
+        }
+    };
+
+    template<typename TCType>
+    struct RadixKey<TCType, typename std::enable_if<std::is_floating_point<TCType>::value>::type> {
+        typedef typename std::conditional<sizeof(TCType) == 4, uint32_t, uint64_t>::type type;
+        static type encode(TCType value) {
+            if (value == 0) {
+                //-0.0 and 0.0 compare equal
+                value = 0;
+            }
+            type bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            constexpr type sign = type(1) << (sizeof(type) * 8 - 1);
+            return (bits & sign) ? ~bits : bits | sign;
+        }
+    };
+
+    /**
+     * Stable LSD radix sort of keys, moving the values along. Passes where all keys share the same byte are skipped.
+     */
+    template<typename TKey, typename TValue>
+    void radix_sort_pairs(std::vector<TKey>& keys, std::vector<TValue>& values) {
+        const size_t n = keys.size();
+        std::array<std::array<size_t, 256>, sizeof(TKey)> counts{};
+        for (size_t i = 0; i < n; i++) {
+            auto key = keys[i];
+            for (size_t b = 0; b < sizeof(TKey); b++) {
+                counts[b][(key >> (b * 8)) & 0xff]++;
+            }
+        }
+
+        std::vector<TKey> keys_scratch(n);
+        std::vector<TValue> values_scratch(n);
+        for (size_t b = 0; b < sizeof(TKey); b++) {
+            auto& count = counts[b];
+            if (n == 0 || count[(keys[0] >> (b * 8)) & 0xff] == n) {
+                continue;
+            }
+            size_t offset = 0;
+            for (auto& c: count) {
+                auto next = offset + c;
+                c = offset;
+                offset = next;
+            }
+            for (size_t i = 0; i < n; i++) {
+                auto pos = count[(keys[i] >> (b * 8)) & 0xff]++;
+                keys_scratch[pos] = keys[i];
+                values_scratch[pos] = values[i];
+            }
+            keys.swap(keys_scratch);
+            values.swap(values_scratch);
+        }
+    }
+
+    /**
+     * Stable sort of the permutation by a single column. Nulls are ordered first, as in NullComparer.
+     */
+    template<typename TArray, typename TIndex>
+    void radix_sort_column(const TArray& array, std::vector<TIndex>& permutation) {
+        typedef RadixKey<typename TArray::value_type> Key;
+        std::vector<typename Key::type> keys(permutation.size());
+        auto has_nulls = array.null_count() != 0;
+        for (size_t i = 0; i < permutation.size(); i++) {
+            auto row = permutation[i];
+            keys[i] = has_nulls && array.IsNull(row) ? 0 : Key::encode(array.Value(row));
+        }
+        radix_sort_pairs(keys, permutation);
+        if (has_nulls) {
+            std::stable_partition(permutation.begin(), permutation.end(), [&array](TIndex row) { return array.IsNull(row); });
+        }
+    }
+
+    /**
+     * Stable sort of the permutation by a string dictionary column, using the rank of each code. With up to 256
+     * distinct values this is a single counting sort pass.
+     */
+    template<typename TKey, typename TIndices, typename TIndex>
+    void radix_sort_ranks(const TIndices& indices, const std::vector<uint32_t>& ranks, std::vector<TIndex>& permutation) {
+        std::vector<TKey> keys(permutation.size());
+        auto has_nulls = indices.null_count() != 0;
+        for (size_t i = 0; i < permutation.size(); i++) {
+            auto row = permutation[i];
+            keys[i] = has_nulls && indices.IsNull(row) ? 0 : static_cast<TKey>(ranks[indices.Value(row)]);
+        }
+        radix_sort_pairs(keys, permutation);
+        if (has_nulls) {
+            std::stable_partition(permutation.begin(), permutation.end(), [&indices](TIndex row) { return indices.IsNull(row); });
+        }
+    }
+
+    template<typename TIndex>
+    arrow::Status radix_sort_dictionary_column(const arrow::Array& array, std::vector<TIndex>& permutation) {
+        return visit_dictionary_ranks(array, [&permutation](const auto& indices, const std::vector<uint32_t>& ranks) {
+            if (ranks.size() <= 0x100) {
+                radix_sort_ranks<uint8_t>(indices, ranks, permutation);
+            }
+            else if (ranks.size() <= 0x10000) {
+                radix_sort_ranks<uint16_t>(indices, ranks, permutation);
+            }
+            else {
+                radix_sort_ranks<uint32_t>(indices, ranks, permutation);
+            }
+        });
+    }
+
+    static inline bool is_radix_sortable(const arrow::Array& array) {
+        switch (array.type_id()) {
+            case arrow::Type::INT8:
+            case arrow::Type::INT16:
+            case arrow::Type::INT32:
+            case arrow::Type::INT64:
+            case arrow::Type::UINT8:
+            case arrow::Type::UINT16:
+            case arrow::Type::UINT32:
+            case arrow::Type::UINT64:
+            case arrow::Type::FLOAT:
+            case arrow::Type::DOUBLE:
+                return true;
+            case arrow::Type::DICTIONARY:
+                return is_string_dictionary(array);
+            default:
+                //HALF_FLOAT is compared on its raw bits by SimpleComparer, so it stays on the comparer path.
+                return false;
+        }
+    }
+
+    static inline bool is_radix_sortable(const std::shared_ptr<arrow::RecordBatch>& batch, const std::vector<std::string>& columns) {
+        for (auto& c: columns) {
+            auto array = batch->GetColumnByName(c);
+            if (!array || !is_radix_sortable(*array)) {
+                return false;
+            }
+        }
+        return !columns.empty();
+    }
+
+    /**
+     * Sort the permutation by the given columns, most significant first. All columns must be radix sortable.
+     */
+    template<typename TIndex>
+    arrow::Status radix_sort(const std::shared_ptr<arrow::RecordBatch>& batch, const std::vector<std::string>& columns, std::vector<TIndex>& permutation) {
+        for (auto c = columns.rbegin(); c != columns.rend(); c++) {
+            auto array = batch->GetColumnByName(*c);
+            if (!array) {
+                return arrow::Status::Invalid("Column missing from batch: " + *c);
+            }
+            switch (array->type_id()) {
+                case arrow::Type::INT8:
+                    radix_sort_column(static_cast<const arrow::Int8Array&>(*array), permutation);
+                    break;
+                case arrow::Type::INT16:
+                    radix_sort_column(static_cast<const arrow::Int16Array&>(*array), permutation);
+                    break;
+                case arrow::Type::INT32:
+                    radix_sort_column(static_cast<const arrow::Int32Array&>(*array), permutation);
+                    break;
+                case arrow::Type::INT64:
+                    radix_sort_column(static_cast<const arrow::Int64Array&>(*array), permutation);
+                    break;
+                case arrow::Type::UINT8:
+                    radix_sort_column(static_cast<const arrow::UInt8Array&>(*array), permutation);
+                    break;
+                case arrow::Type::UINT16:
+                    radix_sort_column(static_cast<const arrow::UInt16Array&>(*array), permutation);
+                    break;
+                case arrow::Type::UINT32:
+                    radix_sort_column(static_cast<const arrow::UInt32Array&>(*array), permutation);
+                    break;
+                case arrow::Type::UINT64:
+                    radix_sort_column(static_cast<const arrow::UInt64Array&>(*array), permutation);
+                    break;
+                case arrow::Type::FLOAT:
+                    radix_sort_column(static_cast<const arrow::FloatArray&>(*array), permutation);
+                    break;
+                case arrow::Type::DOUBLE:
+                    radix_sort_column(static_cast<const arrow::DoubleArray&>(*array), permutation);
+                    break;
+                case arrow::Type::DICTIONARY:
+                    ARROW_RETURN_NOT_OK(radix_sort_dictionary_column(*array, permutation));
+                    break;
+                default:
+                    return arrow::Status::Invalid("Cannot radix sort array of type " + array->type()->ToString());
+            }
+        }
+        return arrow::Status::OK();
+    }
+}
+
+#endif //MARROW_RADIX_SORT_H
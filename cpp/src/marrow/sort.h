@@ -5,143 +5,479 @@
 #ifndef MARROW_SORT_H
 #define MARROW_SORT_H
 
+#include <limits>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
+#include "marrow/chunked_index.h"
 #include "marrow/index.h"
+#include "marrow/take.h"
 
 namespace marrow {
 
     template <typename TIndexType, typename TArrayType>
-    arrow::Status array_by_index(std::shared_ptr<TIndexType> index, std::shared_ptr<TArrayType> array, std::shared_ptr<arrow::Array>* array_out) {
-        typename arrow::TypeTraits<typename TArrayType::TypeClass>::BuilderType builder;
-        for (int64_t i = 0; i < index->length(); i++) {
-            auto ai = index->Value(i);
-            if (ai < 0 || array->IsNull(ai)) {
-                ARROW_RETURN_NOT_OK(builder.AppendNull());
-            }
-            else {
-                ARROW_RETURN_NOT_OK(builder.Append(array->Value(ai)));
-            }
-        }
-        return builder.Finish(array_out);
+    arrow::Status array_by_index(std::shared_ptr<TIndexType> index, std::shared_ptr<TArrayType> array, std::shared_ptr<arrow::Array>* array_out, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool(), const GatherOptions& options = GatherOptions()) {
+        return take_primitive(*index, *array, array_out, num_threads, pool, options);
     }
 
     template <typename TBuilderType, typename TIndexType>
-    arrow::Status array_by_index(std::shared_ptr<TIndexType> index, std::shared_ptr<IStringArray> array, std::shared_ptr<arrow::Array>* array_out) {
-        TBuilderType builder;
-        for (int64_t i = 0; i < index->length(); i++) {
-            auto ai = index->Value(i);
-            if (ai < 0 || array->array().IsNull(ai)) {
-                ARROW_RETURN_NOT_OK(builder.AppendNull());
+    arrow::Status array_by_index(std::shared_ptr<TIndexType> index, std::shared_ptr<IStringArray> array, std::shared_ptr<arrow::Array>* array_out, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool()) {
+        if constexpr (std::is_same<TBuilderType, arrow::StringBuilder>::value) {
+            return take_istring<arrow::StringArray>(*index, *array, array_out, num_threads, pool);
+        }
+        else if constexpr (std::is_same<TBuilderType, arrow::LargeStringBuilder>::value) {
+            return take_istring<arrow::LargeStringArray>(*index, *array, array_out, num_threads, pool);
+        }
+        else {
+            TBuilderType builder(pool);
+            for (int64_t i = 0; i < index->length(); i++) {
+                auto ai = index->Value(i);
+                if (ai < 0 || array->array().IsNull(ai)) {
+                    ARROW_RETURN_NOT_OK(builder.AppendNull());
+                }
+                else {
+                    ARROW_RETURN_NOT_OK(builder.Append(array->Value(ai)));
+                }
             }
-            else {
-                ARROW_RETURN_NOT_OK(builder.Append(array->Value(ai)));
+            return builder.Finish(array_out);
+        }
+    }
+
+    /**
+     * Gather one column in index order, long columns are split into row ranges gathered by up to num_threads threads.
+     * An index made of long runs of consecutive rows, e.g. the identity, gives slices of the array instead of copies.
+     */
+    template <typename TType>
+    arrow::Status column_by_index(const std::shared_ptr<typename arrow::TypeTraits<TType>::ArrayType>& typed_index, const std::shared_ptr<arrow::Array>& array, std::shared_ptr<arrow::Array>* array_out, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool(), const GatherOptions& options = GatherOptions()) {
+        std::vector<std::pair<int64_t, int64_t>> slices;
+        if (index_slices(*typed_index, &slices)) {
+            return take_slices(array, slices, array_out, pool);
+        }
+        switch (array->type_id()) {
+            case arrow::Type::INT8:
+                ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::Int8Array>(array), array_out, num_threads, pool, options)));
+                break;
+            case arrow::Type::INT16:
+                ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::Int16Array>(array), array_out, num_threads, pool, options)));
+                break;
+            case arrow::Type::INT32:
+                ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::Int32Array>(array), array_out, num_threads, pool, options)));
+                break;
+            case arrow::Type::INT64:
+                ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::Int64Array>(array), array_out, num_threads, pool, options)));
+                break;
+            case arrow::Type::UINT8:
+                ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::UInt8Array>(array), array_out, num_threads, pool, options)));
+                break;
+            case arrow::Type::UINT16:
+                ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::UInt16Array>(array), array_out, num_threads, pool, options)));
+                break;
+            case arrow::Type::UINT32:
+                ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::UInt32Array>(array), array_out, num_threads, pool, options)));
+                break;
+            case arrow::Type::UINT64:
+                ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::UInt64Array>(array), array_out, num_threads, pool, options)));
+                break;
+            case arrow::Type::HALF_FLOAT:
+                ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::HalfFloatArray>(array), array_out, num_threads, pool, options)));
+                break;
+            case arrow::Type::FLOAT:
+                ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::FloatArray>(array), array_out, num_threads, pool, options)));
+                break;
+            case arrow::Type::DOUBLE:
+                ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::DoubleArray>(array), array_out, num_threads, pool, options)));
+                break;
+            case arrow::Type::STRING:
+                ARROW_RETURN_NOT_OK(take_string(*typed_index, static_cast<const arrow::StringArray&>(*array), array_out, num_threads, pool));
+                break;
+            case arrow::Type::LARGE_STRING:
+                ARROW_RETURN_NOT_OK(take_string(*typed_index, static_cast<const arrow::LargeStringArray&>(*array), array_out, num_threads, pool));
+                break;
+            case arrow::Type::DICTIONARY: {
+                auto dict_array = std::static_pointer_cast<arrow::DictionaryArray>(array);
+                auto indices = dict_array->indices();
+                switch (indices->type_id()) {
+                    case arrow::Type::INT8:
+                        ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::Int8Array>(indices), &indices, num_threads, pool, options)));
+                        break;
+                    case arrow::Type::INT16:
+                        ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::Int16Array>(indices), &indices, num_threads, pool, options)));
+                        break;
+                    case arrow::Type::INT32:
+                        ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::Int32Array>(indices), &indices, num_threads, pool, options)));
+                        break;
+                    case arrow::Type::INT64:
+                        ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::Int64Array>(indices), &indices, num_threads, pool, options)));
+                        break;
+                    default:
+                        return arrow::Status::Invalid("Invalid dict index type " + indices->type()->ToString());
+                }
+                auto dict = dict_array->dictionary();
+                auto type = arrow::dictionary(indices->type(), dict->type());
+                *array_out = std::make_shared<arrow::DictionaryArray>(type, indices, dict);
+                break;
             }
+            default:
+                return arrow::Status::Invalid("Cannot sort array of type " + array->type()->ToString());
+        }
+        return arrow::Status::OK();
+    }
+
+    static arrow::Status column_by_index(const std::shared_ptr<arrow::Array>& array, std::shared_ptr<arrow::Array> index, std::shared_ptr<arrow::Array>* array_out, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool(), const GatherOptions& options = GatherOptions()) {
+        switch (index->type_id()) {
+            case arrow::Type::INT8:
+                return column_by_index<arrow::Int8Type>(std::static_pointer_cast<arrow::Int8Array>(index), array, array_out, num_threads, pool, options);
+            case arrow::Type::INT16:
+                return column_by_index<arrow::Int16Type>(std::static_pointer_cast<arrow::Int16Array>(index), array, array_out, num_threads, pool, options);
+            case arrow::Type::INT32:
+                return column_by_index<arrow::Int32Type>(std::static_pointer_cast<arrow::Int32Array>(index), array, array_out, num_threads, pool, options);
+            case arrow::Type::INT64:
+                return column_by_index<arrow::Int64Type>(std::static_pointer_cast<arrow::Int64Array>(index), array, array_out, num_threads, pool, options);
+            default:
+                return arrow::Status::Invalid("Unexpected index type: " + index->type()->ToString());
         }
-        return builder.Finish(array_out);
     }
 
+    /**
+     * Gather the rows of the batch in index order. Columns are gathered concurrently on up to num_threads threads;
+     * threads left over when there are fewer columns than threads split long columns into row ranges.
+     */
     template <typename TType>
-    arrow::Status batch_by_index(const std::shared_ptr<arrow::RecordBatch>& batch, std::shared_ptr<arrow::Array> index, std::shared_ptr<arrow::RecordBatch>* sorted_batch) {
+    arrow::Status batch_by_index(const std::shared_ptr<arrow::RecordBatch>& batch, std::shared_ptr<arrow::Array> index, std::shared_ptr<arrow::RecordBatch>* sorted_batch, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool(), const GatherOptions& options = GatherOptions()) {
         std::vector<std::shared_ptr<arrow::Array>> sorted_arrays(batch->num_columns());
         auto typed_index = std::static_pointer_cast<typename arrow::TypeTraits<TType>::ArrayType>(index);
-        for (int32_t i = 0; i < batch->num_columns(); i++) {
-            auto array = batch->column(i);
+        int column_threads = std::max(1, num_threads / std::max(1, batch->num_columns()));
+        ARROW_RETURN_NOT_OK(parallel_for(batch->num_columns(), num_threads, [&](int64_t i) {
+            return column_by_index<TType>(typed_index, batch->column(i), &sorted_arrays[i], column_threads, pool, options);
+        }));
+
+        std::vector<std::shared_ptr<arrow::Field>> fields;
+        for (size_t i = 0; i < sorted_arrays.size(); i++) {
+            fields.push_back(arrow::field(batch->column_name(i), sorted_arrays[i]->type()));
+        }
+
+        *sorted_batch = arrow::RecordBatch::Make(arrow::schema(fields), index->length(), sorted_arrays);
+
+        return arrow::Status::OK();
+    }
+
+
+    static arrow::Status batch_by_index(const std::shared_ptr<arrow::RecordBatch>& batch, std::shared_ptr<arrow::Array> index, std::shared_ptr<arrow::RecordBatch>* sorted_batch, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool(), const GatherOptions& options = GatherOptions()) {
+        switch (index->type_id()) {
+            case arrow::Type::INT8:
+                return batch_by_index<arrow::Int8Type>(batch, index, sorted_batch, num_threads, pool, options);
+            case arrow::Type::INT16:
+                return batch_by_index<arrow::Int16Type>(batch, index, sorted_batch, num_threads, pool, options);
+            case arrow::Type::INT32:
+                return batch_by_index<arrow::Int32Type>(batch, index, sorted_batch, num_threads, pool, options);
+            case arrow::Type::INT64:
+                return batch_by_index<arrow::Int64Type>(batch, index, sorted_batch, num_threads, pool, options);
+            default:
+                return arrow::Status::Invalid("Unexpected index type: " + index->type()->ToString());
+        }
+    }
+
+    /**
+     * Fill a fixed width TArray of the length of a chunked index with get_value(i), into buffers which are allocated
+     * once. is_valid(i) gives the validity of row i if has_nulls, otherwise no validity bitmap is written. Long
+     * gathers are split into row ranges filled by up to num_threads threads.
+     */
+    template <typename TArray, typename TIsValid, typename TGetValue>
+    arrow::Status chunked_take(const ChunkedIndex& index, bool has_nulls, TIsValid is_valid, TGetValue get_value, std::shared_ptr<arrow::Array>* array_out, int num_threads, arrow::MemoryPool* pool) {
+        typedef typename TArray::value_type c_type;
+        auto length = index.length();
+        auto bounds = take_ranges(length, num_threads);
+        auto num_ranges = static_cast<int64_t>(bounds.size()) - 1;
+        std::shared_ptr<arrow::Buffer> values;
+        ARROW_RETURN_NOT_OK(arrow::AllocateBuffer(pool, length * sizeof(c_type), &values));
+        auto out = reinterpret_cast<c_type*>(values->mutable_data());
+        if (!has_nulls) {
+            ARROW_RETURN_NOT_OK(parallel_for(num_ranges, num_threads, [&](int64_t r) {
+                for (int64_t i = bounds[r]; i < bounds[r + 1]; i++) {
+                    out[i] = get_value(i);
+                }
+                return arrow::Status::OK();
+            }));
+            *array_out = std::make_shared<TArray>(length, values);
+            return arrow::Status::OK();
+        }
+
+        std::shared_ptr<arrow::Buffer> validity;
+        ARROW_RETURN_NOT_OK(arrow::AllocateBitmap(pool, length, &validity));
+        auto bits = validity->mutable_data();
+        std::vector<int64_t> null_counts(num_ranges);
+        ARROW_RETURN_NOT_OK(parallel_for(num_ranges, num_threads, [&](int64_t r) {
+            int64_t null_count = 0;
+            for (int64_t i = bounds[r]; i < bounds[r + 1]; i++) {
+                bool valid = is_valid(i);
+                out[i] = valid ? get_value(i) : c_type();
+                arrow::BitUtil::SetBitTo(bits, i, valid);
+                null_count += !valid;
+            }
+            null_counts[r] = null_count;
+            return arrow::Status::OK();
+        }));
+        int64_t null_count = 0;
+        for (auto c: null_counts) {
+            null_count += c;
+        }
+        *array_out = std::make_shared<TArray>(length, values, validity, null_count);
+        return arrow::Status::OK();
+    }
+
+    /**
+     * Gather the rows of a chunked index from fixed width chunks, a null row gives a null. Without nulls in the chunks
+     * or the rows no validity bitmap is written.
+     */
+    template <typename TArrayType>
+    arrow::Status chunked_array_by_index(const ChunkedIndex& index, const std::vector<std::shared_ptr<arrow::Array>>& chunks, std::shared_ptr<arrow::Array>* array_out, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool()) {
+        typedef typename TArrayType::value_type c_type;
+        auto chunk_ids = index.chunks->raw_values();
+        auto rows = index.rows->raw_values();
+        bool has_nulls = index.rows->null_count() != 0;
+        std::vector<const c_type*> values(chunks.size());
+        for (size_t c = 0; c < chunks.size(); c++) {
+            values[c] = static_cast<const TArrayType&>(*chunks[c]).raw_values();
+            has_nulls = has_nulls || chunks[c]->null_count() != 0;
+        }
+        return chunked_take<TArrayType>(index, has_nulls,
+                [&](int64_t i) {return index.rows->IsValid(i) && chunks[chunk_ids[i]]->IsValid(rows[i]);},
+                [&](int64_t i) {return values[chunk_ids[i]][rows[i]];}, array_out, num_threads, pool);
+    }
+
+    /**
+     * Gather the rows of a chunked index from StringArray or LargeStringArray chunks with the two pass
+     * take_string_rows, a null row gives a null.
+     */
+    template <typename TArrayType>
+    arrow::Status chunked_string_array_by_index(const ChunkedIndex& index, const std::vector<std::shared_ptr<arrow::Array>>& chunks, std::shared_ptr<arrow::Array>* array_out, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool()) {
+        auto chunk_ids = index.chunks->raw_values();
+        auto rows = index.rows->raw_values();
+        bool has_nulls = index.rows->null_count() != 0;
+        std::vector<const TArrayType*> arrays(chunks.size());
+        for (size_t c = 0; c < chunks.size(); c++) {
+            arrays[c] = static_cast<const TArrayType*>(chunks[c].get());
+            has_nulls = has_nulls || chunks[c]->null_count() != 0;
+        }
+        return take_string_rows<TArrayType>(index.length(), has_nulls,
+                [&](int64_t i) {return index.rows->IsValid(i) && arrays[chunk_ids[i]]->IsValid(rows[i]);},
+                [&](int64_t i) {return arrays[chunk_ids[i]]->GetView(rows[i]);}, array_out, num_threads, pool);
+    }
+
+    /**
+     * Unify the dictionaries of string dictionary chunks into one dictionary of their distinct strings, in the order
+     * they first appear, and the code in it of every entry of every chunk dictionary. Chunks which share a dictionary
+     * share its codes.
+     */
+    static arrow::Status unify_chunk_dictionaries(const std::vector<std::shared_ptr<arrow::Array>>& chunks, std::shared_ptr<arrow::Array>* dictionary_out, std::vector<std::vector<int32_t>>* codes_out, arrow::MemoryPool* pool) {
+        std::unordered_map<std::string_view, int32_t> codes;
+        arrow::StringBuilder builder(pool);
+        codes_out->resize(chunks.size());
+        for (size_t c = 0; c < chunks.size(); c++) {
+            auto dictionary = std::static_pointer_cast<arrow::DictionaryArray>(chunks[c])->dictionary();
+            if (c > 0 && is_same_dictionary(*dictionary, *std::static_pointer_cast<arrow::DictionaryArray>(chunks[c - 1])->dictionary())) {
+                (*codes_out)[c] = (*codes_out)[c - 1];
+                continue;
+            }
+            auto values = make_istring_array(dictionary);
+            auto& chunk_codes = (*codes_out)[c];
+            chunk_codes.resize(values->length());
+            for (int64_t i = 0; i < values->length(); i++) {
+                auto value = values->Value(i);
+                auto found = codes.emplace(std::string_view(value.data(), value.size()), static_cast<int32_t>(codes.size()));
+                if (found.second) {
+                    ARROW_RETURN_NOT_OK(builder.Append(value));
+                }
+                chunk_codes[i] = found.first->second;
+            }
+        }
+        return builder.Finish(dictionary_out);
+    }
+
+    /**
+     * Gather the rows of a chunked index from string dictionary chunks with different dictionaries: the dictionaries
+     * are unified once, and the codes of the rows are mapped to the unified codes into an index array allocated once,
+     * of the narrowest type holding the unified dictionary as the dictionary builder gives.
+     */
+    static arrow::Status chunked_dictionary_by_index(const ChunkedIndex& index, const std::vector<std::shared_ptr<arrow::Array>>& chunks, std::shared_ptr<arrow::Array>* array_out, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool()) {
+        std::shared_ptr<arrow::Array> dictionary;
+        std::vector<std::vector<int32_t>> codes;
+        ARROW_RETURN_NOT_OK(unify_chunk_dictionaries(chunks, &dictionary, &codes, pool));
+        if (chunks.empty()) {
+            //Only null rows, e.g. of the missing side of an outer join
+            std::shared_ptr<arrow::Array> indices;
+            ARROW_RETURN_NOT_OK(chunked_take<arrow::Int8Array>(index, true, [](int64_t) {return false;}, [](int64_t) {return int8_t();}, &indices, num_threads, pool));
+            *array_out = std::make_shared<arrow::DictionaryArray>(arrow::dictionary(indices->type(), dictionary->type()), indices, dictionary);
+            return arrow::Status::OK();
+        }
+        auto chunk_ids = index.chunks->raw_values();
+        auto rows = index.rows->raw_values();
+        bool has_nulls = index.rows->null_count() != 0;
+        std::vector<std::shared_ptr<arrow::Array>> index_chunks;
+        for (auto& c: chunks) {
+            index_chunks.push_back(std::static_pointer_cast<arrow::DictionaryArray>(c)->indices());
+            has_nulls = has_nulls || c->null_count() != 0;
+        }
+        auto gather = [&](auto* out_index) {
+            typedef std::remove_pointer_t<decltype(out_index)> TOutIndexArray;
+            return visit_dictionary_index_type(*chunks[0], [&](auto* in_index) {
+                typedef std::remove_pointer_t<decltype(in_index)> TInIndexArray;
+                typedef typename TOutIndexArray::value_type out_type;
+                std::vector<const typename TInIndexArray::value_type*> in(index_chunks.size());
+                for (size_t c = 0; c < index_chunks.size(); c++) {
+                    in[c] = static_cast<const TInIndexArray&>(*index_chunks[c]).raw_values();
+                }
+                std::shared_ptr<arrow::Array> indices;
+                ARROW_RETURN_NOT_OK(chunked_take<TOutIndexArray>(index, has_nulls,
+                        [&](int64_t i) {return index.rows->IsValid(i) && index_chunks[chunk_ids[i]]->IsValid(rows[i]);},
+                        [&](int64_t i) {return static_cast<out_type>(codes[chunk_ids[i]][in[chunk_ids[i]][rows[i]]]);}, &indices, num_threads, pool));
+                *array_out = std::make_shared<arrow::DictionaryArray>(arrow::dictionary(indices->type(), dictionary->type()), indices, dictionary);
+                return arrow::Status::OK();
+            });
+        };
+        if (dictionary->length() <= std::numeric_limits<int8_t>::max()) {
+            return gather(static_cast<arrow::Int8Array*>(nullptr));
+        }
+        else if (dictionary->length() <= std::numeric_limits<int16_t>::max()) {
+            return gather(static_cast<arrow::Int16Array*>(nullptr));
+        }
+        return gather(static_cast<arrow::Int32Array*>(nullptr));
+    }
+
+    /**
+     * Gather the rows of the batches in the order of a chunked index into one batch with the given schema. The
+     * batches are not concatenated first. Dictionary columns keep their dictionary if all batches share it, otherwise
+     * the dictionaries are unified. Columns are gathered concurrently on up to num_threads threads; threads left over
+     * when there are fewer columns than threads split long columns into row ranges, as in batch_by_index.
+     */
+    static arrow::Status batches_by_index(const std::shared_ptr<arrow::Schema>& schema, const std::vector<std::shared_ptr<arrow::RecordBatch>>& batches, const ChunkedIndex& index, std::shared_ptr<arrow::RecordBatch>* sorted_batch, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool()) {
+        std::vector<std::shared_ptr<arrow::Array>> sorted_arrays(schema->num_fields());
+        int column_threads = std::max(1, num_threads / std::max(1, schema->num_fields()));
+        ARROW_RETURN_NOT_OK(parallel_for(schema->num_fields(), num_threads, [&](int64_t i) {
+            std::vector<std::shared_ptr<arrow::Array>> chunks;
+            for (auto& b: batches) {
+                chunks.push_back(b->column(i));
+            }
             std::shared_ptr<arrow::Array> sorted_array;
-            switch (array->type_id()) {
+            auto type = schema->field(i)->type();
+            switch (type->id()) {
                 case arrow::Type::INT8:
-                    ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::Int8Array>(array), &sorted_array)));
+                    ARROW_RETURN_NOT_OK(chunked_array_by_index<arrow::Int8Array>(index, chunks, &sorted_array, column_threads, pool));
                     break;
                 case arrow::Type::INT16:
-                    ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::Int16Array>(array), &sorted_array)));
+                    ARROW_RETURN_NOT_OK(chunked_array_by_index<arrow::Int16Array>(index, chunks, &sorted_array, column_threads, pool));
                     break;
                 case arrow::Type::INT32:
-                    ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::Int32Array>(array), &sorted_array)));
+                    ARROW_RETURN_NOT_OK(chunked_array_by_index<arrow::Int32Array>(index, chunks, &sorted_array, column_threads, pool));
                     break;
                 case arrow::Type::INT64:
-                    ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::Int64Array>(array), &sorted_array)));
+                    ARROW_RETURN_NOT_OK(chunked_array_by_index<arrow::Int64Array>(index, chunks, &sorted_array, column_threads, pool));
                     break;
                 case arrow::Type::UINT8:
-                    ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::UInt8Array>(array), &sorted_array)));
+                    ARROW_RETURN_NOT_OK(chunked_array_by_index<arrow::UInt8Array>(index, chunks, &sorted_array, column_threads, pool));
                     break;
                 case arrow::Type::UINT16:
-                    ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::UInt16Array>(array), &sorted_array)));
+                    ARROW_RETURN_NOT_OK(chunked_array_by_index<arrow::UInt16Array>(index, chunks, &sorted_array, column_threads, pool));
                     break;
                 case arrow::Type::UINT32:
-                    ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::UInt32Array>(array), &sorted_array)));
+                    ARROW_RETURN_NOT_OK(chunked_array_by_index<arrow::UInt32Array>(index, chunks, &sorted_array, column_threads, pool));
                     break;
                 case arrow::Type::UINT64:
-                    ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::UInt64Array>(array), &sorted_array)));
+                    ARROW_RETURN_NOT_OK(chunked_array_by_index<arrow::UInt64Array>(index, chunks, &sorted_array, column_threads, pool));
                     break;
                 case arrow::Type::HALF_FLOAT:
-                    ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::HalfFloatArray>(array), &sorted_array)));
+                    ARROW_RETURN_NOT_OK(chunked_array_by_index<arrow::HalfFloatArray>(index, chunks, &sorted_array, column_threads, pool));
                     break;
                 case arrow::Type::FLOAT:
-                    ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::FloatArray>(array), &sorted_array)));
+                    ARROW_RETURN_NOT_OK(chunked_array_by_index<arrow::FloatArray>(index, chunks, &sorted_array, column_threads, pool));
                     break;
                 case arrow::Type::DOUBLE:
-                    ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::DoubleArray>(array), &sorted_array)));
+                    ARROW_RETURN_NOT_OK(chunked_array_by_index<arrow::DoubleArray>(index, chunks, &sorted_array, column_threads, pool));
                     break;
                 case arrow::Type::STRING:
-                    ARROW_RETURN_NOT_OK((array_by_index<arrow::StringBuilder>(typed_index, make_istring_array(array), &sorted_array)));
+                    ARROW_RETURN_NOT_OK(chunked_string_array_by_index<arrow::StringArray>(index, chunks, &sorted_array, column_threads, pool));
                     break;
                 case arrow::Type::LARGE_STRING:
-                    ARROW_RETURN_NOT_OK((array_by_index<arrow::LargeStringBuilder>(typed_index ,make_istring_array(array), &sorted_array)));
+                    ARROW_RETURN_NOT_OK(chunked_string_array_by_index<arrow::LargeStringArray>(index, chunks, &sorted_array, column_threads, pool));
                     break;
                 case arrow::Type::DICTIONARY: {
-                    auto dict_array = std::static_pointer_cast<arrow::DictionaryArray>(array);
-                    auto indices = dict_array->indices();
-                    switch (indices->type_id()) {
+                    bool same_dictionary = !chunks.empty();
+                    for (auto& c: chunks) {
+                        auto dict = std::static_pointer_cast<arrow::DictionaryArray>(c)->dictionary();
+                        auto first_dict = std::static_pointer_cast<arrow::DictionaryArray>(chunks[0])->dictionary();
+                        same_dictionary = same_dictionary && (is_same_dictionary(*dict, *first_dict) || dict->Equals(*first_dict));
+                    }
+                    if (!same_dictionary) {
+                        ARROW_RETURN_NOT_OK(chunked_dictionary_by_index(index, chunks, &sorted_array, column_threads, pool));
+                        break;
+                    }
+                    std::vector<std::shared_ptr<arrow::Array>> index_chunks;
+                    for (auto& c: chunks) {
+                        index_chunks.push_back(std::static_pointer_cast<arrow::DictionaryArray>(c)->indices());
+                    }
+                    std::shared_ptr<arrow::Array> indices;
+                    switch (index_chunks[0]->type_id()) {
                         case arrow::Type::INT8:
-                            ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::Int8Array>(indices), &indices)));
+                            ARROW_RETURN_NOT_OK(chunked_array_by_index<arrow::Int8Array>(index, index_chunks, &indices, column_threads, pool));
                             break;
                         case arrow::Type::INT16:
-                            ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::Int16Array>(indices), &indices)));
+                            ARROW_RETURN_NOT_OK(chunked_array_by_index<arrow::Int16Array>(index, index_chunks, &indices, column_threads, pool));
                             break;
                         case arrow::Type::INT32:
-                            ARROW_RETURN_NOT_OK((array_by_index(typed_index, std::static_pointer_cast<arrow::Int32Array>(indices), &indices)));
+                            ARROW_RETURN_NOT_OK(chunked_array_by_index<arrow::Int32Array>(index, index_chunks, &indices, column_threads, pool));
+                            break;
+                        case arrow::Type::INT64:
+                            ARROW_RETURN_NOT_OK(chunked_array_by_index<arrow::Int64Array>(index, index_chunks, &indices, column_threads, pool));
                             break;
                         default:
-                            return arrow::Status::Invalid("Invalid dict index type " + indices->type()->ToString());
+                            return arrow::Status::Invalid("Invalid dict index type " + index_chunks[0]->type()->ToString());
                     }
-                    auto dict = dict_array->dictionary();
-                    auto type = arrow::dictionary(indices->type(), dict->type());
-                    sorted_array = std::make_shared<arrow::DictionaryArray>(type, indices, dict);
+                    auto dict = std::static_pointer_cast<arrow::DictionaryArray>(chunks[0])->dictionary();
+                    sorted_array = std::make_shared<arrow::DictionaryArray>(arrow::dictionary(indices->type(), dict->type()), indices, dict);
                     break;
                 }
                 default:
-                    return arrow::Status::Invalid("Cannot sort array of type " + array->type()->ToString());
+                    return arrow::Status::Invalid("Cannot sort array of type " + type->ToString());
             }
             sorted_arrays[i] = sorted_array;
-        }
+            return arrow::Status::OK();
+        }));
 
         std::vector<std::shared_ptr<arrow::Field>> fields;
         for (size_t i = 0; i < sorted_arrays.size(); i++) {
-            fields.push_back(arrow::field(batch->column_name(i), sorted_arrays[i]->type()));
+            fields.push_back(arrow::field(schema->field(i)->name(), sorted_arrays[i]->type()));
         }
 
-        *sorted_batch = arrow::RecordBatch::Make(arrow::schema(fields), index->length(), sorted_arrays);
-
+        *sorted_batch = arrow::RecordBatch::Make(arrow::schema(fields), index.length(), sorted_arrays);
         return arrow::Status::OK();
     }
 
-
-    static arrow::Status batch_by_index(const std::shared_ptr<arrow::RecordBatch>& batch, std::shared_ptr<arrow::Array> index, std::shared_ptr<arrow::RecordBatch>* sorted_batch) {
-        switch (index->type_id()) {
-            case arrow::Type::INT8:
-                return batch_by_index<arrow::Int8Type>(batch, index, sorted_batch);
-            case arrow::Type::INT16:
-                return batch_by_index<arrow::Int16Type>(batch, index, sorted_batch);
-            case arrow::Type::INT32:
-                return batch_by_index<arrow::Int32Type>(batch, index, sorted_batch);
-            default:
-                return arrow::Status::Invalid("Unexpected index type: " + index->type()->ToString());
+    /**
+     * The given columns of the batch in the given order, all columns if none are given. No data is copied.
+     */
+    static arrow::Status select_columns(const std::shared_ptr<arrow::RecordBatch>& batch, const std::vector<std::string>& columns, std::shared_ptr<arrow::RecordBatch>* batch_out) {
+        if (columns.empty()) {
+            *batch_out = batch;
+            return arrow::Status::OK();
         }
+        std::vector<std::shared_ptr<arrow::Field>> fields;
+        std::vector<std::shared_ptr<arrow::Array>> arrays;
+        for (auto& name: columns) {
+            auto i = batch->schema()->GetFieldIndex(name);
+            if (i < 0) {
+                return arrow::Status::KeyError("No such column: " + name);
+            }
+            fields.push_back(batch->schema()->field(i));
+            arrays.push_back(batch->column(i));
+        }
+        *batch_out = arrow::RecordBatch::Make(arrow::schema(fields, batch->schema()->metadata()), batch->num_rows(), arrays);
+        return arrow::Status::OK();
     }
 
-    static inline arrow::Status sort(const std::shared_ptr<arrow::RecordBatch>& batch, std::vector<std::string> sort_columns, std::shared_ptr<arrow::RecordBatch>* sorted_batch) {
+    static inline arrow::Status sort(const std::shared_ptr<arrow::RecordBatch>& batch, std::vector<std::string> sort_columns, std::shared_ptr<arrow::RecordBatch>* sorted_batch, arrow::MemoryPool* pool = arrow::default_memory_pool()) {
         std::shared_ptr<arrow::Array> index;
-        ARROW_RETURN_NOT_OK(make_index(batch, sort_columns, &index));
-        return batch_by_index(batch, index, sorted_batch);
+        ARROW_RETURN_NOT_OK(make_index(batch, sort_columns, &index, 1, pool));
+        return batch_by_index(batch, index, sorted_batch, 1, pool);
     }
 }
 
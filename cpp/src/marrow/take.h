@@ -0,0 +1,384 @@
+#ifndef MARROW_TAKE_H
+#define MARROW_TAKE_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+#include <arrow/array.h>
+#include <arrow/array/concatenate.h>
+#include <arrow/buffer.h>
+#include <arrow/util/bit_util.h>
+#include "marrow/parallel.h"
+#include "marrow/string_array.h"
+
+namespace marrow {
+
+    /**
+     * True if the index has negative entries, which take as nulls.
+     */
+    template<typename TIndexArray>
+    bool index_has_nulls(const TIndexArray& index) {
+        auto indices = index.raw_values();
+        return std::any_of(indices, indices + index.length(), [](typename TIndexArray::value_type i) {return i < 0;});
+    }
+
+    /**
+     * Minimum average length of the runs of consecutive rows of an index which is gathered as slices.
+     */
+    constexpr int64_t take_min_slice_length = 32;
+
+    /**
+     * Split the index into runs of consecutive rows, given as (first row, length). Returns false if the index has
+     * negative entries or its runs are on average shorter than take_min_slice_length; the scan stops as soon as
+     * that is known, so random indices cost little.
+     */
+    template<typename TIndexArray>
+    bool index_slices(const TIndexArray& index, std::vector<std::pair<int64_t, int64_t>>* slices_out) {
+        auto length = index.length();
+        auto indices = index.raw_values();
+        auto max_slices = std::max<int64_t>(1, length / take_min_slice_length);
+        slices_out->clear();
+        int64_t i = 0;
+        while (i < length) {
+            if (indices[i] < 0 || static_cast<int64_t>(slices_out->size()) == max_slices) {
+                return false;
+            }
+            int64_t j = i + 1;
+            while (j < length && indices[j] == indices[j - 1] + 1) {
+                j++;
+            }
+            slices_out->emplace_back(indices[i], j - i);
+            i = j;
+        }
+        return true;
+    }
+
+    /**
+     * Gather runs of consecutive rows of the array: a single run is a zero copy slice, several runs are concatenated
+     * slices. Dictionary arrays keep their dictionary.
+     */
+    static arrow::Status take_slices(const std::shared_ptr<arrow::Array>& array, const std::vector<std::pair<int64_t, int64_t>>& slices, std::shared_ptr<arrow::Array>* array_out, arrow::MemoryPool* pool = arrow::default_memory_pool()) {
+        if (slices.empty()) {
+            *array_out = array->Slice(0, 0);
+            return arrow::Status::OK();
+        }
+        if (slices.size() == 1) {
+            *array_out = array->Slice(slices[0].first, slices[0].second);
+            return arrow::Status::OK();
+        }
+        if (array->type_id() == arrow::Type::DICTIONARY) {
+            auto& dict_array = static_cast<const arrow::DictionaryArray&>(*array);
+            std::shared_ptr<arrow::Array> indices;
+            ARROW_RETURN_NOT_OK(take_slices(dict_array.indices(), slices, &indices, pool));
+            *array_out = std::make_shared<arrow::DictionaryArray>(array->type(), indices, dict_array.dictionary());
+            return arrow::Status::OK();
+        }
+        std::vector<std::shared_ptr<arrow::Array>> arrays;
+        for (auto& s: slices) {
+            arrays.push_back(array->Slice(s.first, s.second));
+        }
+        return arrow::Concatenate(arrays, pool, array_out);
+    }
+
+    /**
+     * Minimum number of rows a thread gathers when a column is split into row ranges.
+     */
+    constexpr int64_t take_min_rows_per_thread = 64 * 1024;
+
+    /**
+     * Bounds of the row ranges a gather of length rows is split into for up to num_threads threads. Ranges start at a
+     * multiple of 64 rows, so no two threads write to the same byte of a validity bitmap.
+     */
+    static inline std::vector<int64_t> take_ranges(int64_t length, int num_threads) {
+        auto num_ranges = std::max<int64_t>(1, std::min<int64_t>(num_threads, length / take_min_rows_per_thread));
+        std::vector<int64_t> bounds(num_ranges + 1);
+        for (int64_t r = 0; r < num_ranges; r++) {
+            bounds[r] = (length / num_ranges * r) & ~int64_t(63);
+        }
+        bounds[num_ranges] = length;
+        return bounds;
+    }
+
+#if defined(__GNUC__)
+#define MARROW_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define MARROW_PREFETCH(addr)
+#endif
+
+    /**
+     * How a fixed width gather reads the array: in index order, in index order prefetching the values a distance
+     * ahead, or blocked, i.e. with the rows partitioned by the block of the array they read so that each block is
+     * read while it is in cache. Auto picks one from the sizes of the array and the index.
+     */
+    enum class GatherMode {Auto, Simple, Prefetch, Blocked};
+
+    struct GatherOptions {
+        GatherMode mode = GatherMode::Auto;
+        /** Number of rows ahead whose values the prefetching gather requests. */
+        int64_t prefetch_distance = 16;
+    };
+
+    /**
+     * Minimum size of the array values for which Auto prefetches, smaller arrays are mostly in cache. Measured with
+     * marrow_test/take_benchmark.cpp.
+     */
+    constexpr int64_t take_prefetch_min_bytes = 256 * 1024 * 1024;
+
+    /**
+     * Size of the blocks of array values the blocked gather partitions rows by, about half an L2 cache.
+     */
+    constexpr int64_t take_block_bytes = 256 * 1024;
+
+    /**
+     * True if a sample of the index mostly jumps further than a page between consecutive rows, e.g. the index of a
+     * sort by a high cardinality key.
+     */
+    template<typename TIndexArray>
+    bool index_is_random(const TIndexArray& index, int64_t value_size) {
+        constexpr int64_t num_samples = 256;
+        auto length = index.length();
+        auto indices = index.raw_values();
+        if (length < 2) {
+            return false;
+        }
+        auto step = std::max<int64_t>(1, (length - 1) / num_samples);
+        int64_t samples = 0;
+        int64_t jumps = 0;
+        for (int64_t i = 0; i + 1 < length && samples < num_samples; i += step, samples++) {
+            auto distance = static_cast<int64_t>(indices[i + 1]) - static_cast<int64_t>(indices[i]);
+            jumps += std::abs(distance) * value_size > 4096;
+        }
+        return jumps * 2 > samples;
+    }
+
+    /**
+     * The gather mode of options, or for Auto: prefetching for random indices into arrays larger than
+     * take_prefetch_min_bytes and simple otherwise. Blocked is never picked, as the partitioning pass costs more
+     * than it saves on the hardware it was measured on.
+     */
+    template<typename TIndexArray>
+    GatherMode gather_mode(const GatherOptions& options, const TIndexArray& index, int64_t array_length, int64_t value_size) {
+        if (options.mode != GatherMode::Auto) {
+            return options.mode;
+        }
+        if (array_length * value_size < take_prefetch_min_bytes || !index_is_random(index, value_size)) {
+            return GatherMode::Simple;
+        }
+        return GatherMode::Prefetch;
+    }
+
+    /**
+     * Gather the rows [begin, end) of an index without negative entries. The blocked gather first partitions the
+     * rows by the take_block_bytes block of in they read, keeping (row, index) pairs, which costs 16 bytes per row.
+     */
+    template<typename TIndex, typename c_type>
+    void take_range(const TIndex* indices, const c_type* in, int64_t in_length, c_type* out, int64_t begin, int64_t end, GatherMode mode, int64_t prefetch_distance) {
+        if (mode == GatherMode::Prefetch) {
+            int64_t i = begin;
+            for (; i + prefetch_distance < end; i++) {
+                MARROW_PREFETCH(in + indices[i + prefetch_distance]);
+                out[i] = in[indices[i]];
+            }
+            for (; i < end; i++) {
+                out[i] = in[indices[i]];
+            }
+        }
+        else if (mode == GatherMode::Blocked && in_length > 0) {
+            int shift = 0;
+            while ((int64_t(sizeof(c_type)) << (shift + 1)) <= take_block_bytes) {
+                shift++;
+            }
+            auto num_blocks = ((in_length - 1) >> shift) + 1;
+            std::vector<int64_t> starts(num_blocks + 1);
+            for (int64_t i = begin; i < end; i++) {
+                starts[(indices[i] >> shift) + 1]++;
+            }
+            for (int64_t b = 0; b < num_blocks; b++) {
+                starts[b + 1] += starts[b];
+            }
+            std::vector<std::pair<int64_t, int64_t>> rows(end - begin);
+            for (int64_t i = begin; i < end; i++) {
+                rows[starts[indices[i] >> shift]++] = {i, indices[i]};
+            }
+            for (auto& row: rows) {
+                out[row.first] = in[row.second];
+            }
+        }
+        else {
+            for (int64_t i = begin; i < end; i++) {
+                out[i] = in[indices[i]];
+            }
+        }
+    }
+
+    /**
+     * Gather array[index[i]] of a fixed width array into buffers which are allocated once, a negative index gives a
+     * null. Without nulls in the array or the index no validity bitmap is written. Long gathers are split into row
+     * ranges filled by up to num_threads threads. Gathers with nulls prefetch instead of gathering blocked.
+     */
+    template<typename TIndexArray, typename TArray>
+    arrow::Status take_primitive(const TIndexArray& index, const TArray& array, std::shared_ptr<arrow::Array>* array_out, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool(), const GatherOptions& options = GatherOptions()) {
+        typedef typename TArray::value_type c_type;
+        auto length = index.length();
+        auto indices = index.raw_values();
+        auto in = array.raw_values();
+        auto bounds = take_ranges(length, num_threads);
+        auto num_ranges = static_cast<int64_t>(bounds.size()) - 1;
+        auto mode = gather_mode(options, index, array.length(), sizeof(c_type));
+        auto prefetch_distance = mode == GatherMode::Simple ? 0 : std::max<int64_t>(1, options.prefetch_distance);
+
+        std::shared_ptr<arrow::Buffer> values;
+        ARROW_RETURN_NOT_OK(arrow::AllocateBuffer(pool, length * sizeof(c_type), &values));
+        auto out = reinterpret_cast<c_type*>(values->mutable_data());
+        if (array.null_count() == 0 && !index_has_nulls(index)) {
+            ARROW_RETURN_NOT_OK(parallel_for(num_ranges, num_threads, [&](int64_t r) {
+                take_range(indices, in, array.length(), out, bounds[r], bounds[r + 1], mode, prefetch_distance);
+                return arrow::Status::OK();
+            }));
+            *array_out = std::make_shared<TArray>(length, values);
+            return arrow::Status::OK();
+        }
+
+        std::shared_ptr<arrow::Buffer> validity;
+        ARROW_RETURN_NOT_OK(arrow::AllocateBitmap(pool, length, &validity));
+        auto bits = validity->mutable_data();
+        std::vector<int64_t> null_counts(num_ranges);
+        ARROW_RETURN_NOT_OK(parallel_for(num_ranges, num_threads, [&](int64_t r) {
+            int64_t null_count = 0;
+            for (int64_t i = bounds[r]; i < bounds[r + 1]; i++) {
+                if (prefetch_distance && i + prefetch_distance < bounds[r + 1] && indices[i + prefetch_distance] >= 0) {
+                    MARROW_PREFETCH(in + indices[i + prefetch_distance]);
+                }
+                auto ai = indices[i];
+                bool valid = ai >= 0 && array.IsValid(ai);
+                out[i] = valid ? in[ai] : c_type();
+                arrow::BitUtil::SetBitTo(bits, i, valid);
+                null_count += !valid;
+            }
+            null_counts[r] = null_count;
+            return arrow::Status::OK();
+        }));
+        int64_t null_count = 0;
+        for (auto c: null_counts) {
+            null_count += c;
+        }
+        *array_out = std::make_shared<TArray>(length, values, validity, null_count);
+        return arrow::Status::OK();
+    }
+
+    /**
+     * Two pass gather of length strings, get_value(i) gives the string of output row i and is_valid(i) its validity.
+     * The first pass computes the offsets, so the data buffer is allocated once with its exact size, the second pass
+     * copies the bytes. Both passes run over row ranges on up to num_threads threads: the first pass writes offsets
+     * relative to the start of each range, which the second pass rebases.
+     */
+    template<typename TOutArray, typename TIsValid, typename TGetValue>
+    arrow::Status take_string_rows(int64_t length, bool has_nulls, TIsValid is_valid, TGetValue get_value, std::shared_ptr<arrow::Array>* array_out, int num_threads, arrow::MemoryPool* pool) {
+        typedef typename TOutArray::offset_type offset_type;
+        auto bounds = take_ranges(length, num_threads);
+        auto num_ranges = static_cast<int64_t>(bounds.size()) - 1;
+
+        std::shared_ptr<arrow::Buffer> offsets_buffer, validity;
+        ARROW_RETURN_NOT_OK(arrow::AllocateBuffer(pool, (length + 1) * sizeof(offset_type), &offsets_buffer));
+        auto offsets = reinterpret_cast<offset_type*>(offsets_buffer->mutable_data());
+        uint8_t* bits = nullptr;
+        if (has_nulls) {
+            ARROW_RETURN_NOT_OK(arrow::AllocateBitmap(pool, length, &validity));
+            bits = validity->mutable_data();
+        }
+        auto too_large = []() {
+            return arrow::Status::CapacityError("Gathered strings too large for offset type, use large strings");
+        };
+        std::vector<int64_t> null_counts(num_ranges), data_lengths(num_ranges);
+        ARROW_RETURN_NOT_OK(parallel_for(num_ranges, num_threads, [&](int64_t r) {
+            int64_t null_count = 0;
+            int64_t data_length = 0;
+            for (int64_t i = bounds[r]; i < bounds[r + 1]; i++) {
+                bool valid = !has_nulls || is_valid(i);
+                if (valid) {
+                    data_length += get_value(i).size();
+                }
+                if (bits) {
+                    arrow::BitUtil::SetBitTo(bits, i, valid);
+                    null_count += !valid;
+                }
+                if (data_length > std::numeric_limits<offset_type>::max()) {
+                    return too_large();
+                }
+                offsets[i + 1] = static_cast<offset_type>(data_length);
+            }
+            null_counts[r] = null_count;
+            data_lengths[r] = data_length;
+            return arrow::Status::OK();
+        }));
+        int64_t null_count = 0;
+        int64_t data_length = 0;
+        std::vector<int64_t> range_offsets(num_ranges);
+        for (int64_t r = 0; r < num_ranges; r++) {
+            range_offsets[r] = data_length;
+            null_count += null_counts[r];
+            data_length += data_lengths[r];
+        }
+        if (data_length > std::numeric_limits<offset_type>::max()) {
+            return too_large();
+        }
+
+        std::shared_ptr<arrow::Buffer> data;
+        ARROW_RETURN_NOT_OK(arrow::AllocateBuffer(pool, data_length, &data));
+        auto out = data->mutable_data();
+        offsets[0] = 0;
+        ARROW_RETURN_NOT_OK(parallel_for(num_ranges, num_threads, [&](int64_t r) {
+            auto range_offset = static_cast<offset_type>(range_offsets[r]);
+            offset_type previous = 0;
+            for (int64_t i = bounds[r]; i < bounds[r + 1]; i++) {
+                auto value_length = offsets[i + 1] - previous;
+                previous = offsets[i + 1];
+                if (value_length > 0) {
+                    std::memcpy(out + range_offset + previous - value_length, get_value(i).data(), value_length);
+                }
+                offsets[i + 1] += range_offset;
+            }
+            return arrow::Status::OK();
+        }));
+        *array_out = std::make_shared<TOutArray>(length, offsets_buffer, data, validity, null_count);
+        return arrow::Status::OK();
+    }
+
+    /**
+     * take_string_rows of the rows of an index, get_value(ai) and is_valid(ai) take the row of the source.
+     */
+    template<typename TOutArray, typename TIndexArray, typename TIsValid, typename TGetValue>
+    arrow::Status take_string_impl(const TIndexArray& index, bool has_nulls, TIsValid is_valid, TGetValue get_value, std::shared_ptr<arrow::Array>* array_out, int num_threads, arrow::MemoryPool* pool) {
+        auto indices = index.raw_values();
+        return take_string_rows<TOutArray>(index.length(), has_nulls,
+                [&](int64_t i) {return is_valid(indices[i]);},
+                [&](int64_t i) {return get_value(indices[i]);}, array_out, num_threads, pool);
+    }
+
+    /**
+     * Gather a StringArray or LargeStringArray, a negative index gives a null.
+     */
+    template<typename TIndexArray, typename TArray>
+    arrow::Status take_string(const TIndexArray& index, const TArray& array, std::shared_ptr<arrow::Array>* array_out, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool()) {
+        bool has_nulls = array.null_count() != 0 || index_has_nulls(index);
+        return take_string_impl<TArray>(index, has_nulls,
+                [&array](int64_t ai) {return ai >= 0 && array.IsValid(ai);},
+                [&array](int64_t ai) {return array.GetView(ai);}, array_out, num_threads, pool);
+    }
+
+    /**
+     * Gather the strings of an IStringArray, e.g. the values of a string dictionary, into a TOutArray string array.
+     */
+    template<typename TOutArray, typename TIndexArray>
+    arrow::Status take_istring(const TIndexArray& index, const IStringArray& array, std::shared_ptr<arrow::Array>* array_out, int num_threads = 1, arrow::MemoryPool* pool = arrow::default_memory_pool()) {
+        bool has_nulls = array.array().null_count() != 0 || index_has_nulls(index);
+        return take_string_impl<TOutArray>(index, has_nulls,
+                [&array](int64_t ai) {return ai >= 0 && !array.IsNull(ai);},
+                [&array](int64_t ai) {return array.Value(ai);}, array_out, num_threads, pool);
+    }
+}
+
+#endif //MARROW_TAKE_H
@@ -6,6 +6,8 @@
 #include "batch_maker.h"
 #include <gtest/gtest.h>
 #include "test_helpers.h"
+#include <numeric>
+#include <random>
 
 class TestApi : public testing::Test {
 
@@ -19,7 +21,7 @@ TEST_F(TestApi, TestAddIndex) {
             .record_batch();
 
     std::shared_ptr<arrow::Array> index;
-    auto actual = marrow::add_index(batch, {"a", "b"});
+    auto actual = marrow::api::add_index(batch, {"a", "b"});
 
     auto expected = BatchMaker()
             .add_meta_data("__marrow_index", "a,b")
@@ -33,6 +35,28 @@ TEST_F(TestApi, TestAddIndex) {
 }
 
 
+TEST_F(TestApi, TestAppend) {
+    auto batch = BatchMaker()
+            .add_string_array<>("a", {"1", "2", "1", "2", "0"})
+            .add_array<>("b", {100, 150, 99, 200, 1000})
+            .record_batch();
+    auto new_batch = BatchMaker()
+            .add_string_array<>("a", {"2", "0", "1"})
+            .add_array<>("b", {100, 150, 99})
+            .record_batch();
+
+    auto actual = marrow::api::append(marrow::api::add_index(batch, {"a", "b"}), new_batch, {"a", "b"});
+
+    auto expected = BatchMaker()
+            .add_meta_data("__marrow_index", "a,b")
+            .template add_array<arrow::Int8Type>("__marrow_index", {6, 4, 2, 7, 0, 5, 1, 3}, 99)
+            .add_string_array<>("a", {"1", "2", "1", "2", "0", "2", "0", "1"})
+            .add_array<>("b", {100, 150, 99, 200, 1000, 100, 150, 99})
+            .record_batch();
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+}
+
 TEST_F(TestApi, TestSort) {
     auto batch = BatchMaker()
             .add_string_array<>("a", {"1", "2", "1", "2", "0"})
@@ -41,7 +65,7 @@ TEST_F(TestApi, TestSort) {
             .record_batch();
 
     std::shared_ptr<arrow::Array> index;
-    auto actual = marrow::sort(batch, {"a", "b"});
+    auto actual = marrow::api::sort(batch, {"a", "b"});
 
     auto expected = BatchMaker()
             .add_meta_data("__marrow_index", "a,b")
@@ -53,6 +77,193 @@ TEST_F(TestApi, TestSort) {
     ASSERT_TRUE(actual->Equals(*expected));
 }
 
+TEST_F(TestApi, TestSortPresorted) {
+    auto batch = BatchMaker()
+            .add_string_array<>("a", {"0", "1", "1", "2", "2"})
+            .add_array<>("b", {1000, 99, 100, 150, 200})
+            .record_batch();
+
+    auto index = marrow::get_index(batch, {"a", "b"});
+    ASSERT_FALSE(index.first);
+    ASSERT_TRUE(index.second->Equals(*batch));
+    ASSERT_TRUE(marrow::get_index(batch, {"b"}).first);
+
+    auto actual = marrow::api::sort(batch, {"a"}, 1, 2);
+    SCOPED_TRACE(compare_msg(actual, batch->Slice(0, 2)));
+    ASSERT_TRUE(actual->Equals(*batch->Slice(0, 2)));
+}
+
+TEST_F(TestApi, TestSortThreads) {
+    auto batch = BatchMaker()
+            .add_string_array<>("a", {"1", "2", "1", "2", "0"})
+            .add_array<>("b", {100, 150, 99, 200, 1000})
+            .add_array<>("c", {2, 3, 1, 4, 0})
+            .record_batch();
+
+    auto expected = marrow::api::sort(batch, {"a", "b"});
+    auto actual = marrow::api::sort(batch, {"a", "b"}, 4);
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+}
+
+TEST_F(TestApi, TestMergeThreads) {
+    auto batch1 = BatchMaker()
+            .add_array<>("a", {1, 1, 2, 3, 5})
+            .add_string_array<>("b", {"11", "12", "21", "31", "51"})
+            .record_batch();
+
+    auto batch2 = BatchMaker()
+            .add_array<>("a", {1, 2, 4, 5, 5})
+            .add_array<>("c", {11, 21, 41, 51, 52})
+            .record_batch();
+
+    for (auto how: {"left", "inner", "outer"}) {
+        SCOPED_TRACE(how);
+        auto expected = marrow::api::merge(batch1, batch2, {"a"}, how, "_right");
+        auto actual = marrow::api::merge(batch1, batch2, {"a"}, how, "_right", 4);
+        SCOPED_TRACE(compare_msg(actual, expected));
+        ASSERT_TRUE(actual->Equals(*expected));
+    }
+}
+
+TEST_F(TestApi, TestSortColumns) {
+    auto batch = BatchMaker()
+            .add_string_array<>("a", {"1", "2", "1", "2", "0"})
+            .add_array<>("b", {100, 150, 99, 200, 1000})
+            .add_array<>("c", {2, 3, 1, 4, 0})
+            .record_batch();
+
+    auto actual = marrow::api::sort(batch, {"a", "b"}, 1, -1, {"c"});
+    auto expected = BatchMaker().add_array<>("c", {0, 1, 2, 3, 4}).record_batch();
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+    ASSERT_THROW(marrow::api::sort(batch, {"a"}, 1, -1, {"x"}), std::runtime_error);
+}
+
+TEST_F(TestApi, TestMergeColumns) {
+    auto batch1 = BatchMaker()
+            .add_array<>("a", {1, 1, 2, 3, 5})
+            .add_array<>("b", {11, 12, 21, 31, 51})
+            .add_array<>("e", {1, 2, 3, 4, 5})
+            .record_batch();
+
+    auto batch2 = BatchMaker()
+            .add_array<>("a", {1, 2, 4, 5, 5})
+            .add_array<>("c", {11, 21, 41, 51, 52})
+            .add_array<>("d", {1, 2, 3, 4, 5})
+            .record_batch();
+
+    for (auto how: {"left", "inner", "outer"}) {
+        SCOPED_TRACE(how);
+        auto all = marrow::api::merge(batch1, batch2, {"a"}, how, "_right");
+        auto actual = marrow::api::merge(batch1, batch2, {"a"}, how, "_right", 1, {"b", "a"}, {"c"});
+        ASSERT_EQ(actual->num_columns(), 3);
+        ASSERT_EQ(actual->column_name(0), "b");
+        ASSERT_EQ(actual->column_name(1), "a");
+        ASSERT_EQ(actual->column_name(2), "c_right");
+        ASSERT_TRUE(actual->column(0)->Equals(*all->GetColumnByName("b")));
+        ASSERT_TRUE(actual->column(1)->Equals(*all->GetColumnByName("a")));
+        ASSERT_TRUE(actual->column(2)->Equals(*all->GetColumnByName("c_right")));
+
+        //Without the key on the left side
+        actual = marrow::api::merge(batch1, batch2, {"a"}, how, "_right", 1, {"e"}, {"d"});
+        ASSERT_EQ(actual->num_columns(), 2);
+        ASSERT_TRUE(actual->column(0)->Equals(*all->GetColumnByName("e")));
+        ASSERT_TRUE(actual->column(1)->Equals(*all->GetColumnByName("d_right")));
+    }
+}
+
+TEST_F(TestApi, TestMemoryPool) {
+    auto batch1 = BatchMaker()
+            .add_string_array<>("a", {"1", "2", "1", "2", "0"})
+            .add_array<>("b", {100, 150, 99, 200, 1000})
+            .add_dict_array<>("c", {"x", "y", "x", "z", "y"})
+            .record_batch();
+    auto batch2 = BatchMaker()
+            .add_string_array<>("a", {"0", "1", "3"})
+            .add_array<>("d", {1, 2, 3})
+            .record_batch();
+
+    arrow::ProxyMemoryPool pool(arrow::default_memory_pool());
+    {
+        auto expected = marrow::api::sort(batch1, {"a", "b"});
+        auto actual = marrow::api::sort(batch1, {"a", "b"}, 1, -1, {}, &pool);
+        ASSERT_TRUE(actual->Equals(*expected));
+        ASSERT_GT(pool.bytes_allocated(), 0);
+
+        for (auto how: {"left", "inner", "outer"}) {
+            SCOPED_TRACE(how);
+            expected = marrow::api::merge(batch1, batch2, {"a"}, how, "_right");
+            actual = marrow::api::merge(batch1, batch2, {"a"}, how, "_right", 2, {}, {}, &pool);
+            ASSERT_TRUE(actual->Equals(*expected));
+        }
+    }
+    //The results and indices came from the pool and are released, std::vector scratch memory is not counted
+    ASSERT_EQ(pool.bytes_allocated(), 0);
+    ASSERT_GT(pool.max_memory(), 0);
+}
+
+TEST_F(TestApi, TestGatherOptions) {
+    std::mt19937 random(3);
+    std::vector<int64_t> a, b;
+    for (int i = 0; i < 1000; i++) {
+        a.push_back(random() % 100);
+        b.push_back(i);
+    }
+    auto batch1 = BatchMaker()
+            .add_array<arrow::Int64Type>("a", a)
+            .add_array<arrow::Int64Type>("b", b)
+            .record_batch();
+    auto batch2 = BatchMaker()
+            .add_array<arrow::Int64Type>("a", {5, 2, 4, 1, 5})
+            .add_array<arrow::Int64Type>("d", {51, 21, 41, 11, 52})
+            .record_batch();
+
+    auto expected = marrow::api::sort(batch1, {"a"});
+    auto expected_merge = marrow::api::merge(batch1, batch2, {"a"}, "outer", "_right");
+    for (auto mode: {marrow::GatherMode::Simple, marrow::GatherMode::Prefetch, marrow::GatherMode::Blocked}) {
+        SCOPED_TRACE(static_cast<int>(mode));
+        marrow::GatherOptions gather;
+        gather.mode = mode;
+        gather.prefetch_distance = 4;
+        auto actual = marrow::api::sort(batch1, {"a"}, 1, -1, {}, nullptr, gather);
+        ASSERT_TRUE(actual->Equals(*expected));
+        actual = marrow::api::materialize(marrow::api::lazy_sort(batch1, {"a"}, 1, -1, nullptr, gather));
+        ASSERT_TRUE(actual->Equals(*expected));
+        actual = marrow::api::merge(batch1, batch2, {"a"}, "outer", "_right", 1, {}, {}, nullptr, "sort", gather);
+        ASSERT_TRUE(actual->Equals(*expected_merge));
+        actual = marrow::api::materialize(marrow::api::lazy_merge(batch1, batch2, {"a"}, "outer", "_right", 1, {}, {}, nullptr, "sort", gather));
+        ASSERT_TRUE(actual->Equals(*expected_merge));
+    }
+}
+
+TEST_F(TestApi, TestSortLimit) {
+    auto batch = BatchMaker()
+            .add_string_array<>("a", {"1", "2", "1", "2", "0"})
+            .add_array<>("b", {100, 150, 99, 200, 1000})
+            .add_array<>("c", {2, 3, 1, 4, 0})
+            .record_batch();
+
+    auto expected = BatchMaker()
+            .add_string_array<>("a", {"0", "1", "1"})
+            .add_array<>("b", {1000, 99, 100})
+            .add_array<>("c", {0, 1, 2})
+            .record_batch();
+
+    auto actual = marrow::api::sort(batch, {"a", "b"}, 1, 3);
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+
+    actual = marrow::api::sort(marrow::api::add_index(batch, {"a", "b"}), {"a", "b"}, 1, 3);
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+
+    auto sorted = marrow::add_sort_metadata(marrow::api::sort(batch, {"a", "b"}), {"a", "b"});
+    actual = marrow::api::sort(sorted, {"a"}, 1, 3);
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+}
+
 TEST_F(TestApi, TestLeft) {
     auto batch1 = BatchMaker()
             .add_array<>("a", {1, 1, 2, 3, 5})
@@ -64,7 +275,7 @@ TEST_F(TestApi, TestLeft) {
             .add_array<>("c", {11, 21, 41, 51, 52})
             .record_batch();
 
-    auto actual = marrow::merge(batch1, batch2, {"a"}, "left", "_right"); //h
+    auto actual = marrow::api::merge(batch1, batch2, {"a"}, "left", "_right"); //h
 
     auto expected = BatchMaker()
             .add_array<>("a", {1, 1, 2, 3, 5, 5})
@@ -86,12 +297,12 @@ TEST_F(TestApi, TestInner) {
             .template add_array<>("c", {11, 21, 41, 51, 52})
             .record_batch();
 
-    auto actual = marrow::merge(batch1, batch2, {"a"}, "inner", "_right"); //h
+    auto actual = marrow::api::merge(batch1, batch2, {"a"}, "inner", "_right"); //h
 
     auto expected = BatchMaker()
             .add_array<>("a", {1, 1, 2, 5, 5}, 99)
             .template add_array<>("b", {11, 12, 21, 51, 51})
-            .template add_array<>("c", {11, 11, 21, 51, 52})
+            .template add_array<>("c_right", {11, 11, 21, 51, 52})
             .record_batch();
     SCOPED_TRACE(compare_msg(actual, expected));
     ASSERT_TRUE(actual->Equals(*expected));
@@ -108,7 +319,7 @@ TEST_F(TestApi, TestOuter) {
             .add_array<>("c", {11, 21, 41, 51, 52})
             .record_batch();
 
-    auto actual = marrow::merge(batch1, batch2, {"a"}, "outer", ""); //h
+    auto actual = marrow::api::merge(batch1, batch2, {"a"}, "outer", "_right"); //h
 
     auto expected = BatchMaker()
             .add_array<>("a", {1, 1, 2, 3, 4, 5, 5})
@@ -118,3 +329,171 @@ TEST_F(TestApi, TestOuter) {
     SCOPED_TRACE(compare_msg(actual, expected));
     ASSERT_TRUE(actual->Equals(*expected));
 }
+
+TEST_F(TestApi, TestMixedKeyTypes) {
+    auto batch1 = BatchMaker()
+            .add_array<arrow::Int32Type>("a", {1, 1, 2, 3, 5})
+            .add_string_array<>("k", {"1", "1", "2", "3", "5"})
+            .add_array<>("b", {11, 12, 21, 31, 51})
+            .record_batch();
+    auto batch2 = BatchMaker()
+            .add_array<arrow::Int64Type>("a", {1, 2, 4, 5, 5})
+            .add_dict_array<arrow::Int8Type>("k", {"1", "2", "4", "5", "5"})
+            .add_array<>("c", {11, 21, 41, 51, 52})
+            .record_batch();
+
+    //The keys are compared as they are, the outer key gets the wider type
+    auto actual = marrow::api::merge(batch1, batch2, {"a"}, "outer", "_right");
+    auto expected = BatchMaker()
+            .add_array<arrow::Int64Type>("a", {1, 1, 2, 3, 4, 5, 5})
+            .add_string_array<>("k", {"1", "1", "2", "3", "", "5", "5"})
+            .add_array<>("b", {11, 12, 21, 31, 0, 51, 51})
+            .add_dict_array<arrow::Int8Type>("k_right", {"1", "1", "2", "", "4", "5", "5"})
+            .add_array<>("c_right", {11, 11, 21, 0, 41, 51, 52})
+            .record_batch();
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+
+    actual = marrow::api::merge(batch1, batch2, {"k"}, "outer", "_right");
+    ASSERT_EQ(actual->GetColumnByName("k")->type_id(), arrow::Type::STRING);
+    ASSERT_EQ(actual->num_rows(), 7);
+    auto inner = marrow::api::merge(batch1, batch2, {"k", "a"}, "inner", "_right");
+    ASSERT_EQ(inner->num_rows(), 5);
+}
+
+TEST_F(TestApi, TestUnsignedKeysAboveInt64) {
+    uint64_t big = (uint64_t(1) << 63) + 5;
+    auto batch1 = BatchMaker()
+            .add_array<arrow::UInt64Type>("a", {1, 2, big})
+            .add_array<>("b", {11, 21, 31})
+            .record_batch();
+    auto batch2 = BatchMaker()
+            .add_array<arrow::Int64Type>("a", {2, 4})
+            .add_array<>("c", {21, 41})
+            .record_batch();
+
+    //Without negative signed keys the outer key stays uint64
+    auto actual = marrow::api::merge(batch1, batch2, {"a"}, "outer", "_right");
+    auto expected = BatchMaker()
+            .add_array<arrow::UInt64Type>("a", {1, 2, 4, big})
+            .add_array<>("b", {11, 21, 0, 31})
+            .add_array<>("c_right", {0, 21, 41, 0})
+            .record_batch();
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+
+    //With negative signed keys the outer key is int64, which cannot hold big
+    auto negative = BatchMaker()
+            .add_array<arrow::Int64Type>("a", {-1, 2})
+            .add_array<>("c", {-11, 21})
+            .record_batch();
+    ASSERT_THROW(marrow::api::merge(batch1, negative, {"a"}, "outer", "_right"), std::runtime_error);
+    auto small = BatchMaker()
+            .add_array<arrow::UInt64Type>("a", {1, 2})
+            .add_array<>("b", {11, 21})
+            .record_batch();
+    actual = marrow::api::merge(small, negative, {"a"}, "outer", "_right");
+    ASSERT_EQ(actual->GetColumnByName("a")->type_id(), arrow::Type::INT64);
+    ASSERT_EQ(actual->num_rows(), 3);
+}
+
+TEST_F(TestApi, TestHashMerge) {
+    auto batch1 = BatchMaker()
+            .add_array<>("a", {3, 1, 2, 1})
+            .add_array<>("b", {31, 11, 21, 12})
+            .record_batch();
+    auto batch2 = BatchMaker()
+            .add_array<>("a", {1, 4, 3, 1})
+            .add_array<>("c", {11, 41, 31, 12})
+            .record_batch();
+
+    //The rows come in left row order, followed by the right only rows
+    auto actual = marrow::api::merge(batch1, batch2, {"a"}, "outer", "_right", 1, {}, {}, nullptr, "hash");
+    auto expected = BatchMaker()
+            .add_array<>("a", {3, 1, 1, 2, 1, 1, 4})
+            .add_array<>("b", {31, 11, 11, 21, 12, 12, 0})
+            .add_array<>("c_right", {31, 11, 12, 0, 11, 12, 41})
+            .record_batch();
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+
+    //Both sides are indexed, so auto merges them in sort order
+    auto indexed1 = marrow::api::add_index(batch1, {"a"});
+    auto indexed2 = marrow::api::add_index(batch2, {"a"});
+    actual = marrow::api::merge(indexed1, indexed2, {"a"}, "outer", "_right", 1, {}, {}, nullptr, "auto");
+    ASSERT_TRUE(actual->Equals(*marrow::api::merge(batch1, batch2, {"a"}, "outer", "_right")));
+    //Right is not smaller than left, so auto merges as well
+    actual = marrow::api::merge(indexed1, batch2, {"a"}, "outer", "_right", 1, {}, {}, nullptr, "auto");
+    ASSERT_TRUE(actual->Equals(*marrow::api::merge(batch1, batch2, {"a"}, "outer", "_right")));
+    ASSERT_THROW(marrow::api::merge(batch1, batch2, {"a"}, "outer", "_right", 1, {}, {}, nullptr, "nested"), std::runtime_error);
+}
+
+TEST_F(TestApi, TestAutoJoinMethod) {
+    auto make_batch = [](int64_t rows) {
+        std::vector<int64_t> values(rows);
+        std::iota(values.begin(), values.end(), 0);
+        return BatchMaker().add_array<arrow::Int64Type>("a", values, -1).record_batch();
+    };
+    auto small = make_batch(2);
+    auto left = make_batch(8);
+    auto large = make_batch(marrow::api::hash_join_max_right_rows);
+    auto larger = make_batch(marrow::api::hash_join_max_right_rows * marrow::api::hash_join_min_left_ratio);
+
+    //Hashes a right side which is small and a small fraction of left
+    ASSERT_EQ(marrow::api::join_method("auto", left, small, {"a"}), marrow::JoinMethod::Hash);
+    ASSERT_EQ(marrow::api::join_method("auto", larger, small, {"a"}), marrow::JoinMethod::Hash);
+    //Merges otherwise
+    ASSERT_EQ(marrow::api::join_method("auto", make_batch(7), small, {"a"}), marrow::JoinMethod::Sort);
+    ASSERT_EQ(marrow::api::join_method("auto", small, left, {"a"}), marrow::JoinMethod::Sort);
+    ASSERT_EQ(marrow::api::join_method("auto", larger, large, {"a"}), marrow::JoinMethod::Sort);
+    //Merges indexed sides whatever their sizes
+    auto indexed = marrow::api::add_index(left, {"a"});
+    ASSERT_EQ(marrow::api::join_method("auto", indexed, marrow::api::add_index(small, {"a"}), {"a"}), marrow::JoinMethod::Sort);
+    ASSERT_EQ(marrow::api::join_method("auto", indexed, small, {"a"}), marrow::JoinMethod::Hash);
+    ASSERT_EQ(marrow::api::join_method("sort", left, small, {"a"}), marrow::JoinMethod::Sort);
+    ASSERT_EQ(marrow::api::join_method("hash", small, left, {"a"}), marrow::JoinMethod::Hash);
+}
+
+TEST_F(TestApi, TestHashMergeMatchesSort) {
+    //Duplicate, null (0) and mixed type keys
+    std::mt19937 random(5);
+    std::vector<int64_t> a1, b;
+    std::vector<int32_t> a2, c;
+    std::vector<std::string> k1, k2;
+    std::vector<std::string> strings = {"", "x", "y", "z"};
+    for (int i = 1; i <= 300; i++) {
+        a1.push_back(random() % 40);
+        k1.push_back(strings[random() % 4]);
+        b.push_back(i);
+    }
+    for (int i = 1; i <= 100; i++) {
+        a2.push_back(random() % 50);
+        k2.push_back(strings[random() % 4]);
+        c.push_back(i);
+    }
+    auto batch1 = BatchMaker()
+            .add_array<arrow::Int64Type>("a", a1)
+            .add_string_array<>("k", k1)
+            .add_array<arrow::Int64Type>("b", b)
+            .record_batch();
+    auto batch2 = BatchMaker()
+            .add_array<arrow::Int32Type>("a", a2)
+            .add_string_array<arrow::LargeStringType>("k", k2)
+            .add_array<arrow::Int32Type>("c", c)
+            .record_batch();
+
+    for (auto on: std::vector<std::vector<std::string>>{{"a"}, {"k", "a"}}) {
+        for (auto how: {"left", "inner", "outer"}) {
+            SCOPED_TRACE(on.size());
+            SCOPED_TRACE(how);
+            auto expected = marrow::api::merge(batch1, batch2, on, how, "_right");
+            auto actual = marrow::api::merge(batch1, batch2, on, how, "_right", 1, {}, {}, nullptr, "hash");
+            ASSERT_EQ(actual->num_rows(), expected->num_rows());
+            //The rows are unique on b and c, which are null for right and left only rows
+            expected = marrow::api::sort(expected, {"b", "c_right"});
+            actual = marrow::api::sort(actual, {"b", "c_right"});
+            SCOPED_TRACE(compare_msg(actual, expected));
+            ASSERT_TRUE(actual->Equals(*expected));
+        }
+    }
+}
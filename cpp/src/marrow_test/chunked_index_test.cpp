@@ -0,0 +1,221 @@
+#include "marrow/api.h"
+#include "marrow/chunked_index.h"
+#include "marrow/sort.h"
+#include "gtest/gtest.h"
+#include "batch_maker.h"
+#include "test_helpers.h"
+#include <random>
+
+class TestChunkedIndex : public testing::Test {
+public:
+    void SetUp() override {
+        std::mt19937 random(11);
+        for (int i = 0; i < 1000; i++) {
+            a.push_back(random() % 30);
+            b.push_back(std::to_string(random() % 20));
+        }
+    }
+
+    std::shared_ptr<arrow::RecordBatch> make_batch(int64_t begin, int64_t end) {
+        std::vector<int64_t> chunk_a(a.begin() + begin, a.begin() + end);
+        std::vector<std::string> chunk_b(b.begin() + begin, b.begin() + end);
+        //Every batch has its own dictionary
+        return BatchMaker()
+                .add_array<arrow::Int64Type>("a", chunk_a, 7)
+                .add_string_array<>("b", chunk_b)
+                .add_array_impl<arrow::StringDictionaryBuilder, std::string>("c", chunk_b, "3")
+                .record_batch();
+    }
+
+    std::vector<std::shared_ptr<arrow::RecordBatch>> make_batches(std::vector<int64_t> bounds) {
+        std::vector<std::shared_ptr<arrow::RecordBatch>> ret;
+        for (size_t i = 0; i + 1 < bounds.size(); i++) {
+            ret.push_back(make_batch(bounds[i], bounds[i + 1]));
+        }
+        return ret;
+    }
+
+    std::vector<int64_t> a;
+    std::vector<std::string> b;
+};
+
+TEST_F(TestChunkedIndex, TestMatchesConcatenated) {
+    auto batch = make_batch(0, a.size());
+    auto batches = make_batches({0, 300, 301, 301, 700, 1000});
+    for (auto on: std::vector<std::vector<std::string>>{{"a"}, {"b"}, {"c", "a"}}) {
+        for (int num_threads: {1, 3}) {
+            SCOPED_TRACE(on[0] + " with threads: " + std::to_string(num_threads));
+            std::shared_ptr<arrow::RecordBatch> expected, actual;
+            ASSERT_STATUS_OK(marrow::sort(batch, on, &expected));
+            marrow::ChunkedIndex index;
+            ASSERT_STATUS_OK(marrow::make_chunked_index(batches, on, &index, num_threads));
+            ASSERT_EQ(index.length(), batch->num_rows());
+            ASSERT_STATUS_OK(marrow::batches_by_index(batch->schema(), batches, index, &actual));
+            ASSERT_EQ(actual->column(2)->type_id(), arrow::Type::DICTIONARY);
+            actual = decode_dictionaries(actual);
+            expected = decode_dictionaries(expected);
+            SCOPED_TRACE(compare_msg(actual, expected));
+            ASSERT_TRUE(actual->Equals(*expected));
+        }
+    }
+}
+
+TEST_F(TestChunkedIndex, TestSharedDictionary) {
+    auto batch = make_batch(0, a.size());
+    std::vector<std::shared_ptr<arrow::RecordBatch>> batches = {batch->Slice(0, 400), batch->Slice(400)};
+    marrow::ChunkedIndex index;
+    ASSERT_STATUS_OK(marrow::make_chunked_index(batches, {"c", "a"}, &index));
+    std::shared_ptr<arrow::RecordBatch> expected, actual;
+    ASSERT_STATUS_OK(marrow::sort(batch, {"c", "a"}, &expected));
+    ASSERT_STATUS_OK(marrow::batches_by_index(batch->schema(), batches, index, &actual));
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+}
+
+TEST_F(TestChunkedIndex, TestGatherNulls) {
+    //Without null rows or values no validity bitmap is written
+    std::vector<std::shared_ptr<arrow::RecordBatch>> batches = {
+            BatchMaker().add_array<arrow::Int64Type>("a", {3, 1}, -1).add_array<arrow::DoubleType>("b", {3.5, 1.5}, -1).record_batch(),
+            BatchMaker().add_array<arrow::Int64Type>("a", {2, 0}, -1).add_array<arrow::DoubleType>("b", {2.5, -1}, -1).record_batch()
+    };
+    marrow::ChunkedIndex index;
+    ASSERT_STATUS_OK(marrow::make_chunked_index(batches, {"a"}, &index));
+    std::shared_ptr<arrow::RecordBatch> actual;
+    ASSERT_STATUS_OK(marrow::batches_by_index(batches[0]->schema(), batches, index, &actual));
+    auto expected = BatchMaker()
+            .add_array<arrow::Int64Type>("a", {0, 1, 2, 3}, -1)
+            .add_array<arrow::DoubleType>("b", {-1, 1.5, 2.5, 3.5}, -1)
+            .record_batch();
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+    ASSERT_EQ(actual->column(0)->null_bitmap_data(), nullptr);
+    ASSERT_EQ(actual->column(1)->null_count(), 1);
+
+    //A null row gathers a null
+    arrow::Int64Builder rows;
+    ASSERT_STATUS_OK(rows.Append(1));
+    ASSERT_STATUS_OK(rows.AppendNull());
+    std::shared_ptr<arrow::Array> rows_array;
+    ASSERT_STATUS_OK(rows.Finish(&rows_array));
+    index.chunks = std::static_pointer_cast<arrow::Int32Array>(BatchMaker().add_array<arrow::Int32Type>("", {1, 0}, -1).array());
+    index.rows = std::static_pointer_cast<arrow::Int64Array>(rows_array);
+    ASSERT_STATUS_OK(marrow::batches_by_index(batches[0]->schema(), batches, index, &actual));
+    expected = BatchMaker()
+            .add_array<arrow::Int64Type>("a", {0, -1}, -1)
+            .add_array<arrow::DoubleType>("b", {-1, -1}, -1)
+            .record_batch();
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+}
+
+TEST_F(TestChunkedIndex, TestGatherStrings) {
+    //The dictionaries of the chunks are unified, without chunks all rows are null
+    std::vector<std::shared_ptr<arrow::RecordBatch>> batches = {
+            BatchMaker().add_string_array<>("a", {"b", "", "d"}).add_dict_array<arrow::Int32Type>("b", {"b", "", "d"}).record_batch(),
+            BatchMaker().add_string_array<>("a", {"c", "a"}).add_dict_array<arrow::Int32Type>("b", {"c", "a"}).record_batch()
+    };
+    marrow::ChunkedIndex index;
+    ASSERT_STATUS_OK(marrow::make_chunked_index(batches, {"a"}, &index));
+    std::shared_ptr<arrow::RecordBatch> actual;
+    ASSERT_STATUS_OK(marrow::batches_by_index(batches[0]->schema(), batches, index, &actual));
+    ASSERT_EQ(actual->column(1)->type()->ToString(), arrow::dictionary(arrow::int8(), arrow::utf8())->ToString());
+    auto expected = BatchMaker()
+            .add_string_array<>("a", {"", "a", "b", "c", "d"})
+            .add_string_array<>("b", {"", "a", "b", "c", "d"})
+            .record_batch();
+    actual = decode_dictionaries(actual);
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+
+    arrow::Int64Builder rows;
+    ASSERT_STATUS_OK(rows.AppendNulls(2));
+    std::shared_ptr<arrow::Array> rows_array;
+    ASSERT_STATUS_OK(rows.Finish(&rows_array));
+    index.chunks = std::static_pointer_cast<arrow::Int32Array>(BatchMaker().add_array<arrow::Int32Type>("", {0, 0}, -1).array());
+    index.rows = std::static_pointer_cast<arrow::Int64Array>(rows_array);
+    ASSERT_STATUS_OK(marrow::batches_by_index(batches[0]->schema(), {}, index, &actual));
+    ASSERT_EQ(actual->num_rows(), 2);
+    ASSERT_EQ(actual->column(0)->null_count(), 2);
+    ASSERT_EQ(actual->column(1)->null_count(), 2);
+}
+
+TEST_F(TestChunkedIndex, TestGatherRanges) {
+    //A single long column is gathered in row ranges by several threads
+    std::mt19937 random(3);
+    std::vector<std::shared_ptr<arrow::RecordBatch>> batches;
+    for (int c = 0; c < 3; c++) {
+        std::vector<int64_t> values;
+        std::vector<std::string> strings;
+        for (int i = 0; i < 100000; i++) {
+            values.push_back(random() % 1000);
+            strings.push_back(std::to_string(values.back()));
+        }
+        batches.push_back(BatchMaker()
+                .add_array<arrow::Int64Type>("a", values, 7)
+                .add_string_array<>("b", strings, "8")
+                .add_array_impl<arrow::StringDictionaryBuilder, std::string>("c", strings, "9")
+                .record_batch());
+    }
+    marrow::ChunkedIndex index;
+    ASSERT_STATUS_OK(marrow::make_chunked_index(batches, {"a"}, &index, 3));
+    for (int i = 0; i < batches[0]->num_columns(); i++) {
+        SCOPED_TRACE(i);
+        std::vector<std::shared_ptr<arrow::RecordBatch>> columns;
+        for (auto& b: batches) {
+            columns.push_back(arrow::RecordBatch::Make(arrow::schema({b->schema()->field(i)}), b->num_rows(), {b->column(i)}));
+        }
+        std::shared_ptr<arrow::RecordBatch> expected, actual;
+        ASSERT_STATUS_OK(marrow::batches_by_index(columns[0]->schema(), columns, index, &expected));
+        ASSERT_STATUS_OK(marrow::batches_by_index(columns[0]->schema(), columns, index, &actual, 4));
+        ASSERT_TRUE(actual->Equals(*expected));
+        ASSERT_GT(actual->column(0)->null_count(), 0);
+    }
+}
+
+TEST_F(TestChunkedIndex, TestTableApi) {
+    auto batches = make_batches({0, 500, 1000});
+    auto right_batch = BatchMaker()
+            .add_array<arrow::Int64Type>("a", {1, 2, 3, 29}, 7)
+            .add_string_array<>("d", {"x", "y", "z", "w"})
+            .record_batch();
+    std::vector<std::shared_ptr<arrow::ChunkedArray>> columns;
+    for (int i = 0; i < batches[0]->num_columns(); i++) {
+        columns.push_back(std::make_shared<arrow::ChunkedArray>(arrow::ArrayVector{batches[0]->column(i), batches[1]->column(i)}));
+    }
+    auto table = arrow::Table::Make(batches[0]->schema(), columns);
+    auto right = arrow::Table::Make(right_batch->schema(), right_batch->columns());
+
+    auto batch = make_batch(0, a.size());
+    auto expected = decode_dictionaries(marrow::api::sort(batch, {"a", "b"}));
+    auto sorted = marrow::api::sort(table, {"a", "b"}, 2);
+    ASSERT_EQ(sorted->num_rows(), batch->num_rows());
+    auto actual = decode_dictionaries(marrow::api::sorted_batch(table, {"a", "b"}));
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+
+    for (auto how: {"left", "inner", "outer"}) {
+        SCOPED_TRACE(how);
+        auto expected_merge = decode_dictionaries(marrow::api::merge(batch, right_batch, {"a"}, how, "_right"));
+        auto merged = marrow::api::merge(table, right, {"a"}, how, "_right");
+        std::shared_ptr<arrow::RecordBatch> merged_batch;
+        arrow::TableBatchReader reader(*merged);
+        ASSERT_STATUS_OK(reader.ReadNext(&merged_batch));
+        auto actual_merge = decode_dictionaries(merged_batch);
+        SCOPED_TRACE(compare_msg(actual_merge, expected_merge));
+        ASSERT_TRUE(actual_merge->Equals(*expected_merge));
+
+        expected_merge = marrow::api::merge(batch, right_batch, {"a"}, how, "_right", 1, {"b", "a"}, {"d"});
+        merged = marrow::api::merge(table, right, {"a"}, how, "_right", 1, {"b", "a"}, {"d"});
+        ASSERT_EQ(merged->schema()->ToString(), expected_merge->schema()->ToString());
+        ASSERT_EQ(merged->num_rows(), expected_merge->num_rows());
+    }
+
+    expected = marrow::api::sort(batch, {"a", "b"}, 1, -1, {"b"});
+    sorted = marrow::api::sort(table, {"a", "b"}, 1, {"b"});
+    ASSERT_EQ(sorted->num_columns(), 1);
+    arrow::TableBatchReader reader(*sorted);
+    ASSERT_STATUS_OK(reader.ReadNext(&actual));
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+    ASSERT_THROW(marrow::api::sort(table, {"a"}, 1, {"x"}), std::runtime_error);
+}
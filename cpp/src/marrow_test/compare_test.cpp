@@ -131,7 +131,8 @@ TYPED_TEST(CompareStringDictTest, TestWithoutNull) {
     auto comparer = marrow::make_array_comparer(array, array);
     {
         SCOPED_TRACE(typeid(*comparer).name());
-        ASSERT_EQ(typeid(*comparer), typeid(marrow::StringComparer));
+        typedef typename TypeTrait::ArrayType IndexArray;
+        ASSERT_EQ(typeid(*comparer), typeid(marrow::DictionaryRankComparer<IndexArray, IndexArray>));
     }
     ASSERT_TRUE(comparer->lt(0, 1));
     ASSERT_FALSE(comparer->lt(0, 2));
@@ -261,3 +262,118 @@ TEST_F(TextColumnComparer, TestSingleColumns) {
     ASSERT_EQ(typeid(*comparer), typeid(marrow::StringComparer));
     ASSERT_TRUE(comparer->lt(0, 1));
 }
+
+TEST_F(TextColumnComparer, TestCmpMatchesLtGt) {
+    auto batch = BatchMaker()
+            .add_array<>("b", {100, 150, 99, 0, 100, 150}, 0)
+            .add_string_array<>("a", {"1", "2", "2", "2", "", "2"})
+            .record_batch();
+    for (auto on: std::vector<std::vector<std::string>>{{"a"}, {"b"}, {"a", "b"}, {"b", "a"}}) {
+        SCOPED_TRACE(on[0] + std::to_string(on.size()));
+        auto comparer = marrow::make_comparer(batch, on);
+        std::vector<int64_t> indices1, indices2;
+        for (int64_t i = 0; i < batch->num_rows(); i++) {
+            for (int64_t j = 0; j < batch->num_rows(); j++) {
+                indices1.push_back(i);
+                indices2.push_back(j);
+            }
+        }
+        std::vector<int8_t> out(indices1.size());
+        comparer->cmp_batch(indices1.data(), indices2.data(), static_cast<int64_t>(indices1.size()), out.data());
+        for (size_t k = 0; k < indices1.size(); k++) {
+            auto i = indices1[k], j = indices2[k];
+            SCOPED_TRACE(std::to_string(i) + " " + std::to_string(j));
+            int expected = comparer->lt(i, j) ? -1 : (comparer->gt(i, j) ? 1 : 0);
+            auto ret = comparer->cmp(i, j);
+            ASSERT_EQ((ret > 0) - (ret < 0), expected);
+            ASSERT_EQ(out[k], expected);
+        }
+    }
+}
+
+TEST(CompareTest, TestMixedTypes) {
+    auto int32_array = BatchMaker().add_array<arrow::Int32Type>("", {-1, 2, 3}, 99).array();
+    auto uint64_array = BatchMaker().add_array<arrow::UInt64Type>("", {2, 0, 18446744073709551615ull}, 99).array();
+    auto comparer = marrow::make_array_comparer(int32_array, uint64_array);
+    ASSERT_LT(comparer->cmp(0, 1), 0);
+    ASSERT_EQ(comparer->cmp(1, 0), 0);
+    ASSERT_GT(comparer->cmp(2, 1), 0);
+    ASSERT_TRUE(comparer->lt(2, 2));
+    ASSERT_TRUE(marrow::make_array_comparer(uint64_array, int32_array)->gt(1, 0));
+
+    auto float_array = BatchMaker().add_array<arrow::FloatType>("", {0.5, 1.5}, 99).array();
+    auto double_array = BatchMaker().add_array<arrow::DoubleType>("", {1.5, 0.25}, 99).array();
+    comparer = marrow::make_array_comparer(float_array, double_array);
+    ASSERT_EQ(comparer->cmp(1, 0), 0);
+    ASSERT_TRUE(comparer->gt(0, 1));
+
+    auto string_array = BatchMaker().add_string_array<>("", {"a", "b", ""}).array();
+    auto large_array = BatchMaker().add_string_array<arrow::LargeStringType>("", {"b", "a", "c"}, "x").array();
+    auto dict_array = BatchMaker().add_dict_array<arrow::Int16Type>("", {"b", "c", "a"}).array();
+    comparer = marrow::make_array_comparer(string_array, large_array);
+    ASSERT_EQ(comparer->cmp(0, 1), 0);
+    ASSERT_TRUE(comparer->lt(2, 0));
+    comparer = marrow::make_array_comparer(dict_array, string_array);
+    ASSERT_EQ(comparer->cmp(2, 0), 0);
+    ASSERT_TRUE(comparer->gt(1, 1));
+
+    ASSERT_FALSE(marrow::are_comparable_types(*int32_array->type(), *double_array->type()));
+    ASSERT_THROW(marrow::make_array_comparer(int32_array, string_array), std::runtime_error);
+}
+
+TEST(CompareTest, TestDictionaryRanks) {
+    auto dict_array1 = BatchMaker().add_dict_array<arrow::Int8Type>("", {"d", "b", "", "a", "b"}).array();
+    auto dict_array2 = BatchMaker().add_dict_array<arrow::Int32Type>("", {"c", "a", "d", ""}).array();
+    auto& dictionary1 = static_cast<const arrow::StringArray&>(*std::static_pointer_cast<arrow::DictionaryArray>(dict_array1)->dictionary());
+    auto& dictionary2 = static_cast<const arrow::StringArray&>(*std::static_pointer_cast<arrow::DictionaryArray>(dict_array2)->dictionary());
+    std::vector<uint32_t> ranks1, ranks2;
+    auto entries = marrow::unify_dictionary_ranks(dictionary1, dictionary2, &ranks1, &ranks2);
+    ASSERT_EQ(entries.size(), 4);
+    ASSERT_EQ(ranks1, std::vector<uint32_t>({3, 1, 0}));
+    ASSERT_EQ(ranks2, std::vector<uint32_t>({2, 0, 3}));
+
+    auto comparer = marrow::make_array_comparer(dict_array1, dict_array2);
+    {
+        SCOPED_TRACE(typeid(*comparer).name());
+        ASSERT_EQ(typeid(*comparer), typeid(marrow::NullComparer));
+    }
+    ASSERT_EQ(comparer->cmp(0, 2), 0);
+    ASSERT_EQ(comparer->cmp(3, 1), 0);
+    ASSERT_LT(comparer->cmp(1, 0), 0);
+    ASSERT_GT(comparer->cmp(0, 0), 0);
+    ASSERT_EQ(comparer->cmp(2, 3), 0);
+    ASSERT_LT(comparer->cmp(2, 1), 0);
+    std::vector<int64_t> indices1 = {0, 3, 1, 0, 2, 2, 4};
+    std::vector<int64_t> indices2 = {2, 1, 0, 0, 3, 1, 3};
+    std::vector<int8_t> out(indices1.size());
+    comparer->cmp_batch(indices1.data(), indices2.data(), indices1.size(), out.data());
+    for (size_t i = 0; i < indices1.size(); i++) {
+        SCOPED_TRACE(i);
+        ASSERT_EQ(out[i], comparer->cmp(indices1[i], indices2[i]));
+    }
+}
+
+TEST(CompareTest, TestSharedDictionaryRanks) {
+    //Two columns with one dictionary are ranked once, and the cache ranks every pair of dictionaries once
+    auto dict_array1 = std::static_pointer_cast<arrow::DictionaryArray>(BatchMaker().add_dict_array<arrow::Int8Type>("", {"d", "b", "c", "a", "b"}).array());
+    auto indices2 = BatchMaker().add_array<arrow::Int8Type>("", {3, 0, 1}, -1).array();
+    auto dict_array2 = std::make_shared<arrow::DictionaryArray>(dict_array1->type(), indices2, dict_array1->dictionary());
+    auto other_array = std::static_pointer_cast<arrow::DictionaryArray>(BatchMaker().add_dict_array<arrow::Int8Type>("", {"c", "a"}).array());
+
+    auto ranks = marrow::make_dictionary_ranks(dict_array1->dictionary(), dict_array2->dictionary());
+    ASSERT_TRUE(ranks->entries.empty());
+    ASSERT_EQ(ranks->ranks1, std::vector<uint32_t>({3, 1, 2, 0}));
+    ASSERT_EQ(ranks->ranks2, ranks->ranks1);
+
+    marrow::DictionaryRanksCache cache;
+    auto cached = marrow::dictionary_ranks(dict_array1->dictionary(), dict_array2->dictionary(), &cache);
+    ASSERT_EQ(marrow::dictionary_ranks(dict_array1->dictionary(), dict_array2->dictionary(), &cache), cached);
+    ASSERT_NE(marrow::dictionary_ranks(dict_array1->dictionary(), other_array->dictionary(), &cache), cached);
+
+    auto comparer = marrow::make_array_comparer(dict_array1, dict_array2, &cache);
+    ASSERT_EQ(comparer->cmp(3, 0), 0);
+    ASSERT_EQ(comparer->cmp(0, 1), 0);
+    ASSERT_EQ(comparer->cmp(1, 2), 0);
+    ASSERT_GT(comparer->cmp(2, 0), 0);
+    ASSERT_LT(comparer->cmp(2, 1), 0);
+}
@@ -0,0 +1,111 @@
+#include "marrow/external_sort.h"
+#include "marrow/sort.h"
+#include "gtest/gtest.h"
+#include "batch_maker.h"
+#include "test_helpers.h"
+#include <arrow/table.h>
+#include <random>
+
+class TestExternalSort : public testing::Test {
+public:
+    void SetUp() override {
+        std::mt19937 random(13);
+        std::vector<int64_t> a;
+        std::vector<std::string> b;
+        for (int i = 0; i < 5000; i++) {
+            a.push_back(random() % 100);
+            b.push_back(std::to_string(random() % 50));
+        }
+        batch = BatchMaker()
+                .add_array<arrow::Int64Type>("a", a, 7)
+                .add_string_array<>("b", b)
+                .add_array_impl<arrow::StringDictionaryBuilder, std::string>("c", b, "3")
+                .record_batch();
+        table = arrow::Table::Make(batch->schema(), batch->columns());
+    }
+
+    /**
+     * Sorts the batch in input batches of input_rows and checks the concatenated output against marrow::sort.
+     */
+    void assert_sorted(std::vector<std::string> on, int64_t input_rows, int64_t memory_budget, int64_t batch_rows) {
+        arrow::TableBatchReader table_reader(*table);
+        table_reader.set_chunksize(input_rows);
+        std::shared_ptr<arrow::RecordBatchReader> input(&table_reader, [](arrow::RecordBatchReader*) {});
+        std::shared_ptr<arrow::RecordBatchReader> reader;
+        ASSERT_STATUS_OK(marrow::external_sort(input, on, memory_budget, ::testing::TempDir(), &reader, batch_rows));
+
+        std::shared_ptr<arrow::RecordBatch> expected;
+        ASSERT_STATUS_OK(marrow::sort(batch, on, &expected));
+        expected = decode_dictionaries(expected);
+        int64_t offset = 0;
+        while (true) {
+            std::shared_ptr<arrow::RecordBatch> actual;
+            ASSERT_STATUS_OK(reader->ReadNext(&actual));
+            if (!actual) {
+                break;
+            }
+            ASSERT_LE(actual->num_rows(), batch_rows);
+            actual = decode_dictionaries(actual);
+            auto expected_slice = expected->Slice(offset, actual->num_rows());
+            SCOPED_TRACE(compare_msg(actual, expected_slice));
+            ASSERT_TRUE(actual->Equals(*expected_slice));
+            offset += actual->num_rows();
+        }
+        ASSERT_EQ(offset, batch->num_rows());
+    }
+
+    std::shared_ptr<arrow::RecordBatch> batch;
+    std::shared_ptr<arrow::Table> table;
+};
+
+TEST_F(TestExternalSort, TestInMemory) {
+    assert_sorted({"a"}, 1000, std::numeric_limits<int64_t>::max(), 512);
+}
+
+TEST_F(TestExternalSort, TestSpilled) {
+    for (auto on: std::vector<std::vector<std::string>>{{"a"}, {"b", "a"}, {"c"}}) {
+        SCOPED_TRACE(on[0]);
+        //Every input batch is its own spilled run
+        assert_sorted(on, 700, 1, 300);
+        assert_sorted(on, 100, 10000, 4096);
+    }
+}
+
+TEST_F(TestExternalSort, TestSpilledDictionaries) {
+    //Every table chunk has its own dictionary, so runs spanning several chunks unify them
+    std::vector<arrow::ArrayVector> chunks(batch->num_columns());
+    for (int64_t offset = 0; offset < batch->num_rows(); offset += 1000) {
+        std::vector<std::string> values;
+        auto c = std::static_pointer_cast<arrow::DictionaryArray>(batch->column(2));
+        for (int64_t i = offset; i < std::min(offset + 1000, batch->num_rows()); i++) {
+            values.push_back(c->IsNull(i) ? "3" : std::static_pointer_cast<arrow::StringArray>(c->dictionary())->GetString(c->GetValueIndex(i)));
+        }
+        auto column = BatchMaker()
+                .add_array_impl<arrow::StringDictionaryBuilder, std::string>("c", values, "3")
+                .record_batch()->column(0);
+        auto columns = batch->Slice(offset, values.size())->columns();
+        columns[2] = column;
+        for (int i = 0; i < batch->num_columns(); i++) {
+            chunks[i].push_back(columns[i]);
+        }
+    }
+    std::vector<std::shared_ptr<arrow::ChunkedArray>> columns;
+    for (auto& c: chunks) {
+        columns.push_back(std::make_shared<arrow::ChunkedArray>(c));
+    }
+    table = arrow::Table::Make(batch->schema(), columns);
+
+    assert_sorted({"c", "a"}, 500, 20000, 300);
+    assert_sorted({"a"}, 1000, 30000, 700);
+}
+
+TEST_F(TestExternalSort, TestEmpty) {
+    auto empty = arrow::Table::Make(batch->schema(), batch->Slice(0, 0)->columns());
+    arrow::TableBatchReader table_reader(*empty);
+    std::shared_ptr<arrow::RecordBatchReader> input(&table_reader, [](arrow::RecordBatchReader*) {});
+    std::shared_ptr<arrow::RecordBatchReader> reader;
+    ASSERT_STATUS_OK(marrow::external_sort(input, {"a"}, 1, ::testing::TempDir(), &reader));
+    std::shared_ptr<arrow::RecordBatch> actual;
+    ASSERT_STATUS_OK(reader->ReadNext(&actual));
+    ASSERT_FALSE(actual);
+}
@@ -0,0 +1,142 @@
+#include "marrow/fused_compare.h"
+#include "gtest/gtest.h"
+#include "batch_maker.h"
+#include "test_helpers.h"
+
+static void assert_same_order(std::shared_ptr<arrow::RecordBatch> batch1, std::shared_ptr<arrow::RecordBatch> batch2, std::vector<std::string> on, bool expect_fused, marrow::StringPrefixCache* prefixes = nullptr) {
+    auto expected = marrow::make_comparer(batch1, batch2, on);
+    ASSERT_STATUS_OK(marrow::with_comparer(batch1, batch2, on, [&](const auto& comparer) {
+        EXPECT_EQ(expect_fused, (!std::is_same<std::decay_t<decltype(comparer)>, marrow::IComparer>::value));
+        for (int64_t i = 0; i < batch1->num_rows(); i++) {
+            for (int64_t j = 0; j < batch2->num_rows(); j++) {
+                EXPECT_EQ(comparer.lt(i, j), expected->lt(i, j)) << "rows " << i << ", " << j;
+                EXPECT_EQ(comparer.gt(i, j), expected->gt(i, j)) << "rows " << i << ", " << j;
+            }
+        }
+        return arrow::Status::OK();
+    }, nullptr, prefixes));
+}
+
+template<typename TType>
+class TestFusedCompareScalar : public testing::Test {
+
+};
+
+TYPED_TEST_CASE(TestFusedCompareScalar, ScalarTypes);
+
+TYPED_TEST(TestFusedCompareScalar, TestSingleColumn) {
+    auto batch1 = BatchMaker()
+            .add_array<TypeParam>("a", {2, 1, 5, 1, 0, 3}, 99)
+            .record_batch();
+    auto batch2 = BatchMaker()
+            .add_array<TypeParam>("a", {1, 4, 2, 0, 3})
+            .record_batch();
+
+    assert_same_order(batch1, batch2, {"a"}, true);
+    assert_same_order(batch2, batch1, {"a"}, true);
+}
+
+TYPED_TEST(TestFusedCompareScalar, TestMultiColumns) {
+    auto batch1 = BatchMaker()
+            .add_array<TypeParam>("a", {2, 1, 5, 1, 0, 3}, 99)
+            .template add_array<arrow::Int64Type>("b", {1, 2, 3, 1, 2, 3})
+            .template add_string_array<>("c", {"a", "b", "", "a", "b", "c"})
+            .record_batch();
+    auto batch2 = BatchMaker()
+            .add_array<TypeParam>("a", {1, 1, 2, 0, 3})
+            .template add_array<arrow::Int64Type>("b", {1, 2, 3, 0, 3})
+            .template add_string_array<>("c", {"a", "b", "a", "b", ""})
+            .record_batch();
+
+    auto type_id = TypeParam::type_id;
+    bool fused = type_id == arrow::Type::INT32 || type_id == arrow::Type::INT64;
+    assert_same_order(batch1, batch2, {"a", "b"}, fused);
+    assert_same_order(batch1, batch2, {"b", "a"}, fused);
+    assert_same_order(batch1, batch2, {"c", "a", "b"}, fused);
+}
+
+template<typename TBuilder>
+class TestFusedCompareString : public testing::Test {
+
+};
+
+TYPED_TEST_CASE(TestFusedCompareString, StringBuilderTypes);
+
+TYPED_TEST(TestFusedCompareString, TestStrings) {
+    auto batch1 = BatchMaker()
+            .add_array_impl<TypeParam, std::string>("a", {"ab", "a", "", "b", "abc"}, "")
+            .template add_array<arrow::Int32Type>("b", {1, 2, 3, 1, 2})
+            .record_batch();
+    auto batch2 = BatchMaker()
+            .add_array_impl<TypeParam, std::string>("a", {"a", "abc", "b", "ab", "c", "a"}, "")
+            .template add_array<arrow::Int32Type>("b", {2, 2, 1, 1, 0, 1})
+            .record_batch();
+
+    auto type = batch1->column(0)->type();
+    bool fused = type->id() == arrow::Type::STRING || (type->id() == arrow::Type::DICTIONARY && static_cast<const arrow::DictionaryType&>(*type).index_type()->id() == arrow::Type::INT32);
+    assert_same_order(batch1, batch2, {"a"}, true);
+    assert_same_order(batch1, batch2, {"a", "b"}, fused);
+    assert_same_order(batch1, batch2, {"b", "a"}, fused);
+}
+
+TEST(TestFusedCompare, TestFallback) {
+    auto batch = BatchMaker()
+            .add_array<arrow::FloatType>("a", {2, 1, 2, 1})
+            .add_array<arrow::Int32Type>("b", {1, 2, 3, 4})
+            .record_batch();
+
+    assert_same_order(batch, batch, {"a", "b"}, false);
+    assert_same_order(batch, batch, {"a", "b", "a", "b"}, false);
+}
+
+TEST(TestFusedCompare, TestInvalidColumns) {
+    auto batch1 = BatchMaker()
+            .add_array<arrow::Int32Type>("a", {1, 2})
+            .record_batch();
+    auto batch2 = BatchMaker()
+            .add_string_array<>("a", {"1", "2"})
+            .add_array<arrow::Int32Type>("b", {1, 2})
+            .record_batch();
+    auto visitor = [](const auto&) {return arrow::Status::OK();};
+
+    EXPECT_THROW(marrow::with_comparer(batch1, batch2, {"b"}, visitor), std::runtime_error);
+    EXPECT_THROW(marrow::with_comparer(batch2, batch1, {"b"}, visitor), std::runtime_error);
+    EXPECT_THROW(marrow::with_comparer(batch1, batch2, {"a"}, visitor), std::runtime_error);
+}
+
+TEST(TestFusedCompare, TestStringPrefixes) {
+    std::vector<std::string> values1 = {"US0378331005", "US0378331004", "US037833", "US03783", std::string("US037833\0", 9), "", "GB00B03MLX29", "US0378331005X"};
+    std::vector<std::string> values2 = {"US0378331005", "US037833100", "US0378330", std::string("US03783\0", 8), "US037833", "A", "GB00B03MLX2", "US0378331005"};
+    auto batch1 = BatchMaker()
+            .add_string_array<>("a", values1, "-")
+            .add_string_array<arrow::LargeStringType>("b", values1, "-")
+            .record_batch();
+    auto batch2 = BatchMaker()
+            .add_string_array<>("a", values2, "-")
+            .add_string_array<arrow::LargeStringType>("b", values2, "-")
+            .record_batch();
+
+    marrow::StringPrefixCache prefixes;
+    for (auto cache: {static_cast<marrow::StringPrefixCache*>(nullptr), &prefixes}) {
+        assert_same_order(batch1, batch2, {"a"}, true, cache);
+        assert_same_order(batch1, batch2, {"b"}, true, cache);
+        assert_same_order(batch1, batch1, {"a"}, true, cache);
+    }
+}
+
+TEST(TestFusedCompare, TestStringPrefixCache) {
+    auto array = std::static_pointer_cast<arrow::StringArray>(BatchMaker()
+            .add_string_array<>("a", {"b", "", "a"})
+            .record_batch()->column(0));
+    //Shares the buffers but not the array data, as a column without its validity bitmap does
+    auto copy = std::static_pointer_cast<arrow::StringArray>(arrow::MakeArray(array->data()->Copy()));
+    auto slice = std::static_pointer_cast<arrow::StringArray>(array->Slice(1));
+
+    marrow::StringPrefixCache cache;
+    auto prefixes = cache.get(array);
+    ASSERT_EQ(3, prefixes->size());
+    EXPECT_EQ(prefixes, cache.get(array));
+    EXPECT_EQ(prefixes, cache.get(copy));
+    EXPECT_NE(prefixes, cache.get(slice));
+    EXPECT_EQ(2, cache.get(slice)->size());
+}
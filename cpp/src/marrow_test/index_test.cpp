@@ -6,6 +6,7 @@
 #include "gtest/gtest.h"
 #include "batch_maker.h"
 #include "test_helpers.h"
+#include <random>
 
 class TestIndex : public testing::Test {
 
@@ -24,4 +25,357 @@ TEST_F(TestIndex, Test1) {
     auto expected = BatchMaker().add_array<arrow::Int8Type>("", {4, 2, 0, 1, 3}, 99).array();
     SCOPED_TRACE("expected: " + expected->ToString());
     ASSERT_TRUE(index->Equals(*expected));
-}
\ No newline at end of file
+}
+
+template<typename TType>
+class TestScalarIndex : public testing::Test {
+public:
+    typedef typename TType::c_type c_type;
+
+    /**
+     * Checks that index is a permutation which is sorted by the comparer, and that equal keys keep their original order.
+     */
+    void assert_sorted(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> on, std::shared_ptr<arrow::Array> index) {
+        auto comparer = marrow::make_comparer(batch, on);
+        auto typed_index = std::static_pointer_cast<arrow::Int8Array>(index);
+        ASSERT_EQ(index->length(), batch->num_rows());
+        std::vector<bool> seen(batch->num_rows());
+        for (int64_t i = 0; i < typed_index->length(); i++) {
+            auto row = typed_index->Value(i);
+            ASSERT_FALSE(seen[row]);
+            seen[row] = true;
+            if (i > 0) {
+                auto prev = typed_index->Value(i - 1);
+                ASSERT_FALSE(comparer->lt(row, prev)) << "at " << i;
+                if (marrow::is_radix_sortable(batch, on) && !comparer->gt(row, prev)) {
+                    ASSERT_LT(prev, row) << "at " << i;
+                }
+            }
+        }
+    }
+};
+
+TYPED_TEST_CASE(TestScalarIndex, ScalarTypes);
+
+TYPED_TEST(TestScalarIndex, TestSingleColumn) {
+    auto batch = BatchMaker()
+            .add_array<TypeParam>("a", {5, 3, 7, 3, 1, 6, 7, 2, 3, 4}, 99)
+            .record_batch();
+
+    std::shared_ptr<arrow::Array> index;
+    ASSERT_STATUS_OK(marrow::make_index(batch, {"a"}, &index));
+    SCOPED_TRACE("index: " + index->ToString());
+    this->assert_sorted(batch, {"a"}, index);
+}
+
+TYPED_TEST(TestScalarIndex, TestWithNulls) {
+    auto batch = BatchMaker()
+            .add_array<TypeParam>("a", {5, 0, 7, 3, 0, 6, 7, 2, 3, 4})
+            .record_batch();
+
+    std::shared_ptr<arrow::Array> index;
+    ASSERT_STATUS_OK(marrow::make_index(batch, {"a"}, &index));
+    SCOPED_TRACE("index: " + index->ToString());
+    auto typed_index = std::static_pointer_cast<arrow::Int8Array>(index);
+    ASSERT_EQ(typed_index->Value(0), 1);
+    ASSERT_EQ(typed_index->Value(1), 4);
+    this->assert_sorted(batch, {"a"}, index);
+}
+
+TYPED_TEST(TestScalarIndex, TestMultiColumns) {
+    auto batch = BatchMaker()
+            .add_array<TypeParam>("a", {2, 1, 2, 1, 0, 2, 1, 0, 2, 1})
+            .template add_array<TypeParam>("b", {9, 8, 0, 7, 8, 9, 7, 6, 5, 9})
+            .template add_array<arrow::Int64Type>("c", {1, 2, 3, 4, 5, 6, 7, 8, 9, 10})
+            .record_batch();
+
+    std::shared_ptr<arrow::Array> index;
+    ASSERT_STATUS_OK(marrow::make_index(batch, {"a", "b"}, &index));
+    SCOPED_TRACE("index: " + index->ToString());
+    this->assert_sorted(batch, {"a", "b"}, index);
+
+    ASSERT_STATUS_OK(marrow::make_index(batch, {"b", "a", "c"}, &index));
+    SCOPED_TRACE("index: " + index->ToString());
+    this->assert_sorted(batch, {"b", "a", "c"}, index);
+}
+
+TEST_F(TestIndex, TestRadixSignedAndFloat) {
+    auto batch = BatchMaker()
+            .add_array<arrow::Int64Type>("a", {-5, 3, std::numeric_limits<int64_t>::min(), 0, std::numeric_limits<int64_t>::max(), -1}, 99)
+            .add_array<arrow::DoubleType>("b", {-0.5, 3.25, -1e300, 0, 1e300, -0.0}, 99)
+            .record_batch();
+
+    std::shared_ptr<arrow::Array> index;
+    ASSERT_STATUS_OK(marrow::make_index(batch, {"a"}, &index));
+    auto expected = BatchMaker().add_array<arrow::Int8Type>("", {2, 0, 5, 3, 1, 4}, 99).array();
+    SCOPED_TRACE("index: " + index->ToString());
+    ASSERT_TRUE(index->Equals(*expected));
+
+    ASSERT_STATUS_OK(marrow::make_index(batch, {"b"}, &index));
+    expected = BatchMaker().add_array<arrow::Int8Type>("", {2, 0, 3, 5, 1, 4}, 99).array();
+    SCOPED_TRACE("index: " + index->ToString());
+    ASSERT_TRUE(index->Equals(*expected));
+}
+
+TEST_F(TestIndex, TestParallelMatchesSingleThreaded) {
+    std::mt19937 random(42);
+    std::vector<int64_t> a, b;
+    std::vector<std::string> c;
+    for (int i = 0; i < 50000; i++) {
+        a.push_back(random() % 1000);
+        b.push_back(random() % 7);
+        c.push_back(std::to_string(random() % 500));
+    }
+    auto batch = BatchMaker()
+            .add_array<arrow::Int64Type>("a", a)
+            .add_array<arrow::Int64Type>("b", b)
+            .add_string_array<>("c", c)
+            .record_batch();
+
+    for (auto on: std::vector<std::vector<std::string>>{{"a"}, {"b", "a"}, {"c"}, {"c", "b"}}) {
+        std::shared_ptr<arrow::Array> expected;
+        ASSERT_STATUS_OK(marrow::make_index(batch, on, &expected));
+        for (int num_threads: {2, 3, 8}) {
+            SCOPED_TRACE(on[0] + " with threads: " + std::to_string(num_threads));
+            std::shared_ptr<arrow::Array> actual;
+            ASSERT_STATUS_OK(marrow::make_index(batch, on, &actual, num_threads));
+            ASSERT_TRUE(actual->Equals(*expected));
+        }
+    }
+}
+
+template<typename TBuilder>
+class TestStringIndex : public testing::Test {
+
+};
+
+TYPED_TEST_CASE(TestStringIndex, StringBuilderTypes);
+
+TYPED_TEST(TestStringIndex, TestSingleColumn) {
+    auto batch = BatchMaker()
+            .add_array_impl<TypeParam, std::string>("a", {"b", "", "ab", "a", "b", "", "c", "ab"}, "")
+            .record_batch();
+
+    std::shared_ptr<arrow::Array> index;
+    ASSERT_STATUS_OK(marrow::make_index(batch, {"a"}, &index));
+    SCOPED_TRACE("index: " + index->ToString());
+    auto expected = BatchMaker().add_array<arrow::Int8Type>("", {1, 5, 3, 2, 7, 0, 4, 6}, 99).array();
+    ASSERT_TRUE(index->Equals(*expected));
+}
+
+TYPED_TEST(TestStringIndex, TestMultiColumns) {
+    auto batch = BatchMaker()
+            .add_array_impl<TypeParam, std::string>("a", {"b", "", "ab", "a", "b", "", "c", "ab"}, "")
+            .template add_array<arrow::Int32Type>("b", {2, 1, 1, 0, 1, 0, 1, 0})
+            .record_batch();
+
+    std::shared_ptr<arrow::Array> index;
+    ASSERT_STATUS_OK(marrow::make_index(batch, {"a", "b"}, &index));
+    SCOPED_TRACE("index: " + index->ToString());
+    auto expected = BatchMaker().add_array<arrow::Int8Type>("", {5, 1, 3, 7, 2, 4, 0, 6}, 99).array();
+    ASSERT_TRUE(index->Equals(*expected));
+
+    ASSERT_STATUS_OK(marrow::make_index(batch, {"b", "a"}, &index, 3));
+    SCOPED_TRACE("index: " + index->ToString());
+    expected = BatchMaker().add_array<arrow::Int8Type>("", {5, 3, 7, 1, 2, 4, 6, 0}, 99).array();
+    ASSERT_TRUE(index->Equals(*expected));
+}
+
+TEST_F(TestIndex, TestLargeDictionary) {
+    std::mt19937 random(7);
+    std::vector<std::string> values;
+    for (int i = 0; i < 5000; i++) {
+        values.push_back("v" + std::to_string(random() % 700));
+    }
+    auto batch = BatchMaker()
+            .add_string_array<>("a", values)
+            .record_batch();
+    auto dict_batch = BatchMaker()
+            .add_array_impl<arrow::StringDictionary32Builder, std::string>("a", values, "")
+            .record_batch();
+
+    std::shared_ptr<arrow::Array> expected, actual;
+    ASSERT_STATUS_OK(marrow::make_index(batch, {"a"}, &expected));
+    ASSERT_STATUS_OK(marrow::make_index(dict_batch, {"a"}, &actual));
+    ASSERT_TRUE(actual->Equals(*expected));
+}
+
+TEST_F(TestIndex, TestPartialIndex) {
+    std::mt19937 random(3);
+    std::vector<int32_t> a;
+    std::vector<std::string> b;
+    for (int i = 0; i < 1000; i++) {
+        a.push_back(random() % 50);
+        b.push_back(std::to_string(random() % 30));
+    }
+    auto batch = BatchMaker()
+            .add_array<arrow::Int32Type>("a", a, 7)
+            .add_string_array<>("b", b)
+            .add_array_impl<arrow::StringDictionaryBuilder, std::string>("c", b, "3")
+            .record_batch();
+
+    for (auto on: std::vector<std::vector<std::string>>{{"a"}, {"b"}, {"c"}, {"b", "a"}}) {
+        std::shared_ptr<arrow::Array> full;
+        ASSERT_STATUS_OK(marrow::make_index(batch, on, &full));
+        for (int64_t limit: {0, 1, 10, 999, 1000, 2000}) {
+            SCOPED_TRACE(on[0] + " with limit: " + std::to_string(limit));
+            std::shared_ptr<arrow::Array> actual;
+            ASSERT_STATUS_OK(marrow::make_partial_index(batch, on, limit, &actual));
+            ASSERT_EQ(actual->type_id(), full->type_id());
+            ASSERT_TRUE(actual->Equals(*full->Slice(0, std::min<int64_t>(limit, full->length()))));
+        }
+    }
+}
+
+TEST_F(TestIndex, TestNearlySorted) {
+    std::mt19937 random(5);
+    std::vector<int64_t> a;
+    std::vector<std::string> b;
+    //Ascending runs, a descending run with duplicates and a few out of place rows
+    for (int i = 0; i < 5000; i++) {
+        a.push_back(i / 3);
+        b.push_back(std::to_string(random() % 10));
+    }
+    for (int i = 3000; i > 0; i--) {
+        a.push_back(i / 2);
+        b.push_back(std::to_string(random() % 10));
+    }
+    for (int i = 0; i < 20; i++) {
+        std::swap(a[random() % a.size()], a[random() % a.size()]);
+    }
+    auto batch = BatchMaker()
+            .add_array<arrow::Int64Type>("a", a, 100)
+            .add_string_array<>("b", b)
+            .record_batch();
+
+    for (auto on: std::vector<std::vector<std::string>>{{"a"}, {"a", "b"}}) {
+        SCOPED_TRACE(on.size());
+        auto comparer = marrow::make_comparer(batch, on);
+        std::vector<int64_t> expected(batch->num_rows());
+        std::iota(expected.begin(), expected.end(), 0);
+        std::stable_sort(expected.begin(), expected.end(), [&comparer](int64_t i1, int64_t i2) {return comparer->lt(i1, i2);});
+        for (int num_threads: {1, 4}) {
+            std::shared_ptr<arrow::Array> index;
+            ASSERT_STATUS_OK(marrow::make_index(batch, on, &index, num_threads));
+            auto typed_index = std::static_pointer_cast<arrow::Int16Array>(index);
+            ASSERT_EQ(typed_index->length(), static_cast<int64_t>(expected.size()));
+            for (int64_t i = 0; i < typed_index->length(); i++) {
+                ASSERT_EQ(typed_index->Value(i), expected[i]) << "at " << i;
+            }
+        }
+    }
+}
+
+TEST_F(TestIndex, TestIsBatchSorted) {
+    auto batch = BatchMaker()
+            .add_array<>("a", {1, 1, 2, 3, 3}, 0)
+            .add_array<>("b", {5, 6, 1, 2, 1})
+            .record_batch();
+    bool sorted;
+    ASSERT_STATUS_OK(marrow::is_batch_sorted(batch, {"a"}, &sorted));
+    ASSERT_TRUE(sorted);
+    ASSERT_STATUS_OK(marrow::is_batch_sorted(batch, {"a", "b"}, &sorted));
+    ASSERT_FALSE(sorted);
+    ASSERT_STATUS_OK(marrow::is_batch_sorted(batch, {"b"}, &sorted));
+    ASSERT_FALSE(sorted);
+    ASSERT_STATUS_OK(marrow::is_batch_sorted(batch->Slice(0, 2), {"a", "b"}, &sorted));
+    ASSERT_TRUE(sorted);
+}
+
+TEST_F(TestIndex, TestAppendIndex) {
+    std::mt19937 random(9);
+    std::vector<int32_t> a;
+    std::vector<std::string> b;
+    for (int i = 0; i < 300; i++) {
+        a.push_back(random() % 40);
+        b.push_back(std::to_string(random() % 20));
+    }
+    auto batch = BatchMaker()
+            .add_array<arrow::Int32Type>("a", a, 7)
+            .add_string_array<>("b", b)
+            .record_batch();
+
+    for (auto on: std::vector<std::vector<std::string>>{{"a"}, {"b", "a"}}) {
+        std::shared_ptr<arrow::Array> expected;
+        ASSERT_STATUS_OK(marrow::make_index(batch, on, &expected));
+        for (int64_t split: {0, 1, 100, 299, 300}) {
+            SCOPED_TRACE(on[0] + " split at: " + std::to_string(split));
+            auto first = batch->Slice(0, split);
+            std::shared_ptr<arrow::Array> first_index, actual;
+            ASSERT_STATUS_OK(marrow::make_index(first, on, &first_index));
+            ASSERT_STATUS_OK(marrow::append_index(first, first_index, batch->Slice(split), on, &actual));
+            ASSERT_TRUE(actual->Equals(*expected));
+        }
+    }
+
+    //A null index means the existing rows are sorted
+    auto sorted = BatchMaker().add_array<>("a", {1, 3, 5}).record_batch();
+    auto appended = BatchMaker().add_array<>("a", {4, 2, 5}).record_batch();
+    std::shared_ptr<arrow::Array> actual;
+    ASSERT_STATUS_OK(marrow::append_index(sorted, nullptr, appended, {"a"}, &actual));
+    auto expected = BatchMaker().add_array<arrow::Int8Type>("", {0, 4, 1, 3, 2, 5}, 99).array();
+    SCOPED_TRACE("actual: " + actual->ToString());
+    ASSERT_TRUE(actual->Equals(*expected));
+}
+
+TEST_F(TestIndex, TestNullPartition) {
+    std::mt19937 random(23);
+    std::vector<int64_t> a;
+    std::vector<std::string> b;
+    for (int i = 0; i < 3000; i++) {
+        a.push_back(random() % 40);
+        b.push_back(std::to_string(random() % 60));
+    }
+    auto batch = BatchMaker()
+            .add_array<arrow::Int64Type>("a", a, 7)
+            .add_string_array<>("b", b, "3")
+            .add_array_impl<arrow::StringDictionaryBuilder, std::string>("c", b, "5")
+            .add_array<arrow::DoubleType>("d", std::vector<double>(a.begin(), a.end()), 11)
+            .record_batch();
+
+    for (auto on: std::vector<std::vector<std::string>>{{"a"}, {"b"}, {"c"}, {"d"}}) {
+        //The null rows lead the index in row order, the rest is sorted as by the null checking comparer
+        auto comparer = marrow::make_comparer(batch, on);
+        std::vector<int64_t> rows(batch->num_rows());
+        std::iota(rows.begin(), rows.end(), 0);
+        std::stable_sort(rows.begin(), rows.end(), [&comparer](int64_t i1, int64_t i2) {return comparer->lt(i1, i2);});
+        auto expected = BatchMaker().add_array<arrow::Int16Type>("", std::vector<int16_t>(rows.begin(), rows.end()), -1).array();
+        for (int num_threads: {1, 3}) {
+            SCOPED_TRACE(on[0] + " with threads: " + std::to_string(num_threads));
+            std::shared_ptr<arrow::Array> actual;
+            ASSERT_STATUS_OK(marrow::make_index(batch, on, &actual, num_threads));
+            ASSERT_TRUE(actual->Equals(*expected));
+        }
+        for (int64_t limit: {1, 20, 100, 3000}) {
+            SCOPED_TRACE(on[0] + " with limit: " + std::to_string(limit));
+            std::shared_ptr<arrow::Array> actual;
+            ASSERT_STATUS_OK(marrow::make_partial_index(batch, on, limit, &actual));
+            ASSERT_TRUE(actual->Equals(*expected->Slice(0, limit)));
+        }
+    }
+}
+
+TEST_F(TestIndex, TestParallelMergeRuns) {
+    //Every thread count splits the merges differently, the result is always that of a stable sort on one thread
+    std::mt19937 random(7);
+    std::vector<std::pair<int, int>> values;
+    for (int i = 0; i < 10007; i++) {
+        values.emplace_back(random() % 50, i);
+    }
+    auto less = [](const std::pair<int, int>& p1, const std::pair<int, int>& p2) {return p1.first < p2.first;};
+    auto expected = values;
+    std::stable_sort(expected.begin(), expected.end(), less);
+    for (int num_threads: {1, 2, 3, 5, 8, 32}) {
+        SCOPED_TRACE(num_threads);
+        auto actual = values;
+        ASSERT_STATUS_OK(marrow::parallel_stable_sort(actual.data(), actual.data() + actual.size(), num_threads, less, [&](auto* begin, auto* end) {
+            std::stable_sort(begin, end, less);
+            return arrow::Status::OK();
+        }));
+        ASSERT_EQ(actual, expected);
+    }
+    //Empty and single element runs
+    std::vector<int> runs = {5, 1, 3, 3, 0, 2};
+    ASSERT_STATUS_OK(marrow::parallel_merge_runs(runs.data(), runs.data() + runs.size(), {0, 1, 1, 2, 4, 4, 6}, 4, std::less<int>()));
+    ASSERT_EQ(runs, std::vector<int>({0, 1, 2, 3, 3, 5}));
+}
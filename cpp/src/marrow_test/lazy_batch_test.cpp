@@ -0,0 +1,82 @@
+#include "marrow/api.h"
+#include "marrow/lazy_batch.h"
+#include "gtest/gtest.h"
+#include "batch_maker.h"
+#include "test_helpers.h"
+
+class TestLazyBatch : public testing::Test {
+public:
+    void SetUp() override {
+        batch1 = BatchMaker()
+                .add_array<>("a", {3, 1, 5, 2, 1})
+                .add_string_array<>("b", {"31", "11", "51", "21", "12"})
+                .add_dict_array<>("c", {"x", "y", "x", "z", "y"})
+                .record_batch();
+        batch2 = BatchMaker()
+                .add_array<>("a", {5, 2, 4, 1, 5})
+                .add_array<>("d", {51, 21, 41, 11, 52})
+                .record_batch();
+    }
+
+    std::shared_ptr<arrow::RecordBatch> batch1;
+    std::shared_ptr<arrow::RecordBatch> batch2;
+};
+
+TEST_F(TestLazyBatch, TestSort) {
+    auto lazy = marrow::api::lazy_sort(batch1, {"a"});
+    ASSERT_EQ(lazy->num_rows(), batch1->num_rows());
+    ASSERT_EQ(lazy->num_columns(), 3);
+    ASSERT_FALSE(lazy->is_materialized(1));
+
+    auto expected = marrow::api::sort(batch1, {"a"});
+    std::shared_ptr<arrow::RecordBatch> actual;
+    ASSERT_STATUS_OK(lazy->materialize({"b"}, &actual));
+    ASSERT_EQ(actual->num_columns(), 1);
+    ASSERT_TRUE(actual->column(0)->Equals(*expected->column(1)));
+    ASSERT_TRUE(lazy->is_materialized(1));
+    ASSERT_FALSE(lazy->is_materialized(0));
+
+    //Cached columns are not gathered again
+    std::shared_ptr<arrow::Array> column;
+    ASSERT_STATUS_OK(lazy->column("b", &column));
+    ASSERT_EQ(column, actual->column(0));
+
+    actual = marrow::api::materialize(lazy);
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+
+    ASSERT_FALSE(lazy->column("x", &column).ok());
+}
+
+TEST_F(TestLazyBatch, TestMerge) {
+    for (auto how: {"left", "inner", "outer"}) {
+        SCOPED_TRACE(how);
+        for (int num_threads: {1, 3}) {
+            auto expected = marrow::api::merge(batch1, batch2, {"a"}, how, "_right");
+            auto lazy = marrow::api::lazy_merge(batch1, batch2, {"a"}, how, "_right", num_threads);
+            ASSERT_EQ(lazy->num_rows(), expected->num_rows());
+            auto actual = marrow::api::materialize(lazy, {"d_right", "a"});
+            ASSERT_TRUE(actual->column(0)->Equals(*expected->GetColumnByName("d_right")));
+            ASSERT_TRUE(actual->column(1)->Equals(*expected->GetColumnByName("a")));
+            actual = marrow::api::materialize(lazy);
+            SCOPED_TRACE(compare_msg(actual, expected));
+            ASSERT_TRUE(actual->Equals(*expected));
+        }
+    }
+}
+
+TEST_F(TestLazyBatch, TestMergeColumns) {
+    for (auto how: {"left", "inner", "outer"}) {
+        SCOPED_TRACE(how);
+        auto expected = marrow::api::merge(batch1, batch2, {"a"}, how, "_right", 1, {"b", "a"}, {"d"});
+        auto lazy = marrow::api::lazy_merge(batch1, batch2, {"a"}, how, "_right", 1, {"b", "a"}, {"d"});
+        ASSERT_EQ(lazy->num_columns(), 3);
+        auto actual = marrow::api::materialize(lazy);
+        SCOPED_TRACE(compare_msg(actual, expected));
+        ASSERT_TRUE(actual->Equals(*expected));
+
+        lazy = marrow::api::lazy_merge(batch1, batch2, {"a"}, how, "_right", 1, {"c"}, {});
+        ASSERT_EQ(lazy->num_columns(), 2);
+        ASSERT_THROW(marrow::api::lazy_merge(batch1, batch2, {"a"}, how, "_right", 1, {"x"}, {}), std::runtime_error);
+    }
+}
@@ -0,0 +1,67 @@
+#include "marrow/normalized_key.h"
+#include "marrow/index.h"
+#include "gtest/gtest.h"
+#include "batch_maker.h"
+#include "test_helpers.h"
+
+static void assert_same_order(std::shared_ptr<arrow::RecordBatch> batch, std::vector<std::string> on) {
+    marrow::NormalizedKeyComparer normalized(batch, on);
+    auto comparer = marrow::make_comparer(batch, on);
+    for (int64_t i = 0; i < batch->num_rows(); i++) {
+        for (int64_t j = 0; j < batch->num_rows(); j++) {
+            SCOPED_TRACE("rows " + std::to_string(i) + ", " + std::to_string(j));
+            ASSERT_EQ(normalized.lt(i, j), comparer->lt(i, j));
+            ASSERT_EQ(normalized.gt(i, j), comparer->gt(i, j));
+        }
+    }
+}
+
+template<typename TType>
+class TestNormalizedKeyScalar : public testing::Test {
+
+};
+
+TYPED_TEST_CASE(TestNormalizedKeyScalar, ScalarTypes);
+
+TYPED_TEST(TestNormalizedKeyScalar, TestMultiColumns) {
+    auto batch = BatchMaker()
+            .add_array<TypeParam>("a", {2, 1, 2, 1, 0, 2, 1, 0, 2, 1})
+            .template add_array<TypeParam>("b", {9, 8, 0, 7, 8, 9, 7, 6, 5, 9}, 99)
+            .template add_string_array<>("c", {"x", "y", "", "x", "z", "x", "y", "a", "", "x"})
+            .record_batch();
+
+    assert_same_order(batch, {"a", "b"});
+    assert_same_order(batch, {"c", "a", "b"});
+    assert_same_order(batch, {"b", "c"});
+}
+
+template<typename TBuilder>
+class TestNormalizedKeyString : public testing::Test {
+
+};
+
+TYPED_TEST_CASE(TestNormalizedKeyString, StringBuilderTypes);
+
+TYPED_TEST(TestNormalizedKeyString, TestPrefixes) {
+    auto batch = BatchMaker()
+            .add_array_impl<TypeParam, std::string>("a", {"ab", "a", "abc", "b", "", "a", "ab", std::string("a\0b", 3), std::string("a\0", 2)}, "")
+            .template add_array_impl<TypeParam, std::string>("b", {"1", "2", "1", "1", "3", "1", "0", "1", "1"}, "")
+            .record_batch();
+
+    assert_same_order(batch, {"a", "b"});
+    assert_same_order(batch, {"b", "a"});
+}
+
+TEST(TestNormalizedKey, TestIndex) {
+    auto batch = BatchMaker()
+            .add_string_array<>("a", {"b", "a", "b", "", "a"})
+            .add_array<>("b", {1, 2, -1, 5, 1}, 99)
+            .add_array<>("c", {0, 1, 2, 3, 4})
+            .record_batch();
+
+    std::shared_ptr<arrow::Array> index;
+    ASSERT_STATUS_OK(marrow::make_index(batch, {"a", "b"}, &index));
+    SCOPED_TRACE("index: " + index->ToString());
+    auto expected = BatchMaker().add_array<arrow::Int8Type>("", {3, 4, 1, 2, 0}, 99).array();
+    ASSERT_TRUE(index->Equals(*expected));
+}
@@ -222,4 +222,124 @@ TYPED_TEST(TestOuterMergeWithString, TestSimple) {
     SCOPED_TRACE(compare_msg(actual, expected));
     ASSERT_TRUE(actual->Equals(*expected));
 
-}
\ No newline at end of file
+}
+TEST(TestOuterMergeIndex, TestInt64Index) {
+    auto batch1 = BatchMaker()
+            .add_array<arrow::Int64Type>("a", {5, 1, 3, 2, 1})
+            .add_array<arrow::Int64Type>("b", {51, 11, 31, 21, 12})
+            .record_batch();
+    auto batch2 = BatchMaker()
+            .add_array<arrow::Int64Type>("a", {5, 4, 2, 5, 1})
+            .add_array<arrow::Int64Type>("c", {51, 41, 21, 52, 11})
+            .record_batch();
+
+    std::shared_ptr<arrow::Array> index1, index2;
+    ASSERT_STATUS_OK(marrow::make_index<arrow::Int64Type>(batch1, {"a"}, &index1));
+    ASSERT_STATUS_OK(marrow::make_index<arrow::Int64Type>(batch2, {"a"}, &index2));
+    std::shared_ptr<arrow::RecordBatch> actual;
+    ASSERT_STATUS_OK(marrow::outer(batch1, batch2, index1, index2, {"a"}, &actual));
+
+    auto expected = BatchMaker()
+            .add_array<arrow::Int64Type>("a", {1, 1, 2, 3, 4, 5, 5})
+            .add_array<arrow::Int64Type>("b", {11, 12, 21, 31, 0, 51, 51})
+            .add_array<arrow::Int64Type>("c", {11, 11, 21, 0, 41, 51, 52})
+            .record_batch();
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+}
+
+TEST(TestOuterMergeIndex, TestNullKeyRuns) {
+    auto batch1 = BatchMaker()
+            .add_string_array<>("a", {"2", "", "1", ""})
+            .add_array<arrow::Int64Type>("b", {21, 1, 11, 2})
+            .record_batch();
+    auto batch2 = BatchMaker()
+            .add_string_array<>("a", {"", "3", "1"})
+            .add_array<arrow::Int64Type>("c", {1, 31, 11})
+            .record_batch();
+    auto batch3 = BatchMaker()
+            .add_string_array<>("a", {"3", "1"})
+            .add_array<arrow::Int64Type>("c", {31, 11})
+            .record_batch();
+
+    //Null keys on both sides match each other
+    std::shared_ptr<arrow::Array> index1, index2, index3;
+    ASSERT_STATUS_OK(marrow::make_index(batch1, {"a"}, &index1));
+    ASSERT_STATUS_OK(marrow::make_index(batch2, {"a"}, &index2));
+    ASSERT_STATUS_OK(marrow::make_index(batch3, {"a"}, &index3));
+    std::shared_ptr<arrow::RecordBatch> actual;
+    ASSERT_STATUS_OK(marrow::outer(batch1, batch2, index1, index2, {"a"}, &actual));
+    auto expected = BatchMaker()
+            .add_string_array<>("a", {"", "", "1", "2", "3"})
+            .add_array<arrow::Int64Type>("b", {1, 2, 11, 21, 0}, 0)
+            .add_array<arrow::Int64Type>("c", {1, 1, 11, 0, 31}, 0)
+            .record_batch();
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+
+    //Null keys on one side only are left only
+    ASSERT_STATUS_OK(marrow::outer(batch1, batch3, index1, index3, {"a"}, &actual));
+    expected = BatchMaker()
+            .add_string_array<>("a", {"", "", "1", "2", "3"})
+            .add_array<arrow::Int64Type>("b", {1, 2, 11, 21, 0}, 0)
+            .add_array<arrow::Int64Type>("c", {0, 0, 11, 0, 31}, 0)
+            .record_batch();
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+}
+
+TEST(TestOuterMergeIndex, TestDictionaryKeys) {
+    //Dictionaries which differ in their entries and their order are compared and unified by rank
+    auto batch1 = BatchMaker()
+            .add_dict_array<arrow::Int32Type>("a", {"5", "1", "", "3", "1"})
+            .add_array<arrow::Int64Type>("b", {51, 11, 1, 31, 12})
+            .record_batch();
+    auto batch2 = BatchMaker()
+            .add_dict_array<arrow::Int32Type>("a", {"4", "2", "5", "", "1", "6"})
+            .add_array<arrow::Int64Type>("c", {41, 21, 51, 1, 11, 61})
+            .record_batch();
+
+    std::shared_ptr<arrow::Array> index1, index2;
+    ASSERT_STATUS_OK(marrow::make_index(batch1, {"a"}, &index1));
+    ASSERT_STATUS_OK(marrow::make_index(batch2, {"a"}, &index2));
+    std::shared_ptr<arrow::RecordBatch> actual;
+    ASSERT_STATUS_OK(marrow::outer(batch1, batch2, index1, index2, {"a"}, &actual));
+    ASSERT_EQ(actual->column(0)->type_id(), arrow::Type::DICTIONARY);
+    actual = decode_dictionaries(actual);
+    auto expected = BatchMaker()
+            .add_string_array<>("a", {"", "1", "1", "2", "3", "4", "5", "6"})
+            .add_array<arrow::Int64Type>("b", {1, 11, 12, 0, 31, 0, 51, 0}, 0)
+            .add_array<arrow::Int64Type>("c", {1, 11, 11, 21, 0, 41, 51, 61}, 0)
+            .record_batch();
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+}
+
+TEST(TestOuterMergeIndex, TestSharedDictionaryKeys) {
+    //The on columns of both sides share one dictionary, which the unified on column keeps
+    auto batch1 = BatchMaker()
+            .add_dict_array<arrow::Int8Type>("a", {"5", "1", "3", "2"})
+            .add_array<arrow::Int64Type>("b", {51, 11, 31, 21})
+            .record_batch();
+    auto column1 = std::static_pointer_cast<arrow::DictionaryArray>(batch1->column(0));
+    auto indices2 = BatchMaker().add_array<arrow::Int8Type>("", {3, 0, 3, 1}, -1).array();
+    auto batch2 = arrow::RecordBatch::Make(
+            arrow::schema({arrow::field("a", column1->type()), arrow::field("c", arrow::int64())}), 4,
+            {std::make_shared<arrow::DictionaryArray>(column1->type(), indices2, column1->dictionary()),
+             BatchMaker().add_array<arrow::Int64Type>("c", {21, 51, 22, 11}).array()});
+
+    std::shared_ptr<arrow::Array> index1, index2;
+    ASSERT_STATUS_OK(marrow::make_index(batch1, {"a"}, &index1));
+    ASSERT_STATUS_OK(marrow::make_index(batch2, {"a"}, &index2));
+    std::shared_ptr<arrow::RecordBatch> actual;
+    ASSERT_STATUS_OK(marrow::outer(batch1, batch2, index1, index2, {"a"}, &actual));
+    ASSERT_TRUE(marrow::is_same_dictionary(*std::static_pointer_cast<arrow::DictionaryArray>(actual->column(0))->dictionary(), *column1->dictionary()));
+    actual = decode_dictionaries(actual);
+    auto expected = BatchMaker()
+            .add_string_array<>("a", {"1", "2", "2", "3", "5"})
+            .add_array<arrow::Int64Type>("b", {11, 21, 21, 31, 51})
+            .add_array<arrow::Int64Type>("c", {11, 21, 22, 0, 51}, 0)
+            .record_batch();
+    SCOPED_TRACE(compare_msg(actual, expected));
+    ASSERT_TRUE(actual->Equals(*expected));
+}
@@ -7,6 +7,7 @@
 #include "gtest/gtest.h"
 #include "batch_maker.h"
 #include "test_helpers.h"
+#include <random>
 
 
 template<typename TType>
@@ -105,3 +106,92 @@ TYPED_TEST(TestStringSort, TestWithNulls) {
     SCOPED_TRACE(compare_msg(actual, expected));
     ASSERT_TRUE(actual->ApproxEquals(*expected));
 }
+
+TEST(TestBatchByIndex, TestContiguousSlices) {
+    std::vector<int64_t> a;
+    std::vector<std::string> b;
+    for (int i = 0; i < 200; i++) {
+        a.push_back(i);
+        b.push_back(std::to_string(i));
+    }
+    auto batch = BatchMaker()
+            .add_array<arrow::Int64Type>("a", a, 7)
+            .add_string_array<>("b", b)
+            .add_array_impl<arrow::StringDictionaryBuilder, std::string>("c", b, "3")
+            .record_batch();
+
+    //The identity gives zero copy slices
+    std::vector<int32_t> identity(a.begin() + 10, a.end());
+    auto index = BatchMaker().add_array<arrow::Int32Type>("", identity, -1).array();
+    std::shared_ptr<arrow::RecordBatch> actual;
+    ASSERT_STATUS_OK(marrow::batch_by_index(batch, index, &actual));
+    ASSERT_TRUE(actual->Equals(*batch->Slice(10)));
+    ASSERT_EQ(actual->column(0)->data()->buffers[1], batch->column(0)->data()->buffers[1]);
+
+    //Two long runs are concatenated slices
+    std::vector<int32_t> runs(a.begin() + 100, a.end());
+    runs.insert(runs.end(), a.begin(), a.begin() + 100);
+    index = BatchMaker().add_array<arrow::Int32Type>("", runs, -1).array();
+    ASSERT_STATUS_OK(marrow::batch_by_index(batch, index, &actual));
+    std::vector<std::pair<int64_t, int64_t>> slices;
+    ASSERT_TRUE(marrow::index_slices(static_cast<const arrow::Int32Array&>(*index), &slices));
+    ASSERT_EQ(slices.size(), 2);
+    for (int i = 0; i < batch->num_columns(); i++) {
+        SCOPED_TRACE(batch->column_name(i));
+        ASSERT_TRUE(actual->column(i)->Slice(0, 100)->Equals(*batch->column(i)->Slice(100)));
+        ASSERT_TRUE(actual->column(i)->Slice(100)->Equals(*batch->column(i)->Slice(0, 100)));
+    }
+
+    //Short runs and nulls are gathered
+    std::vector<int32_t> reversed(a.rbegin(), a.rend());
+    ASSERT_FALSE(marrow::index_slices(static_cast<const arrow::Int32Array&>(*BatchMaker().add_array<arrow::Int32Type>("", reversed, -1).array()), &slices));
+    identity[5] = -1;
+    ASSERT_FALSE(marrow::index_slices(static_cast<const arrow::Int32Array&>(*BatchMaker().add_array<arrow::Int32Type>("", identity, -2).array()), &slices));
+}
+
+TEST(TestBatchByIndex, TestInt64Index) {
+    //Batches of more than 2^31 rows get an Int64 index, which is forced here on a batch that fits in memory
+    std::mt19937 random(17);
+    std::vector<int64_t> a;
+    std::vector<std::string> b;
+    for (int i = 0; i < 200000; i++) {
+        a.push_back(random() % 1000);
+        b.push_back(std::to_string(random() % 300));
+    }
+    auto batch = BatchMaker()
+            .add_array<arrow::Int64Type>("a", a, 7)
+            .add_string_array<>("b", b)
+            .record_batch();
+    std::vector<int64_t> codes;
+    for (auto& s: b) {
+        codes.push_back(std::stoll(s));
+    }
+    std::vector<std::string> values(300);
+    for (int i = 0; i < 300; i++) {
+        values[i] = std::to_string(i);
+    }
+    auto dict = BatchMaker().add_string_array<>("", values).array();
+    auto indices = BatchMaker().add_array<arrow::Int64Type>("", codes, 5).array();
+    auto c = std::make_shared<arrow::DictionaryArray>(arrow::dictionary(arrow::int64(), arrow::utf8()), indices, dict);
+    ASSERT_STATUS_OK(batch->AddColumn(2, arrow::field("c", c->type()), c, &batch));
+
+    for (auto on: std::vector<std::vector<std::string>>{{"a"}, {"b", "a"}}) {
+        SCOPED_TRACE(on[0]);
+        std::shared_ptr<arrow::Array> index32, index64;
+        ASSERT_STATUS_OK(marrow::make_index<arrow::Int32Type>(batch, on, &index32));
+        ASSERT_STATUS_OK(marrow::make_index<arrow::Int64Type>(batch, on, &index64));
+        ASSERT_EQ(index64->type_id(), arrow::Type::INT64);
+        std::shared_ptr<arrow::RecordBatch> expected;
+        ASSERT_STATUS_OK(marrow::batch_by_index(batch, index32, &expected));
+        for (int num_threads: {1, 4}) {
+            SCOPED_TRACE(num_threads);
+            std::shared_ptr<arrow::RecordBatch> actual;
+            ASSERT_STATUS_OK(marrow::batch_by_index(batch, index64, &actual, num_threads));
+            SCOPED_TRACE(compare_msg(actual, expected));
+            ASSERT_TRUE(actual->Equals(*expected));
+            std::shared_ptr<arrow::Array> column;
+            ASSERT_STATUS_OK(marrow::column_by_index(batch->column(2), index64, &column, num_threads));
+            ASSERT_TRUE(column->Equals(*expected->column(2)));
+        }
+    }
+}
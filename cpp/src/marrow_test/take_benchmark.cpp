@@ -0,0 +1,47 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <vector>
+#include "marrow/take.h"
+
+/**
+ * Times the fixed width gather modes of take_primitive for a random permutation of int64 arrays from 1 MiB to
+ * 1 GiB, which is what take_prefetch_min_bytes (the size from which Auto prefetches) was picked from. Usage:
+ * take_benchmark [max MiB] [prefetch distance].
+ */
+int main(int argc, char** argv) {
+    int64_t max_mib = argc > 1 ? std::atoll(argv[1]) : 1024;
+    marrow::GatherOptions options;
+    options.prefetch_distance = argc > 2 ? std::atoll(argv[2]) : options.prefetch_distance;
+    std::printf("%10s %10s %10s %10s %10s %10s\n", "MiB", "simple", "prefetch", "blocked", "auto", "(ns/row)");
+    for (int64_t mib = 1; mib <= max_mib; mib *= 4) {
+        int64_t length = mib * 1024 * 1024 / sizeof(int64_t);
+        std::vector<int64_t> values(length, 1), indices(length);
+        std::iota(indices.begin(), indices.end(), 0);
+        std::shuffle(indices.begin(), indices.end(), std::mt19937(1));
+        arrow::Int64Array array(length, arrow::Buffer::Wrap(values));
+        arrow::Int64Array index(length, arrow::Buffer::Wrap(indices));
+        //Enough repetitions for about 32M rows per mode
+        int64_t reps = std::max<int64_t>(1, (int64_t(1) << 25) / length);
+
+        std::printf("%10ld", static_cast<long>(mib));
+        for (auto mode: {marrow::GatherMode::Simple, marrow::GatherMode::Prefetch, marrow::GatherMode::Blocked, marrow::GatherMode::Auto}) {
+            options.mode = mode;
+            auto start = std::chrono::steady_clock::now();
+            for (int64_t r = 0; r < reps; r++) {
+                std::shared_ptr<arrow::Array> out;
+                auto status = marrow::take_primitive(index, array, &out, 1, arrow::default_memory_pool(), options);
+                if (!status.ok()) {
+                    std::fprintf(stderr, "%s\n", status.ToString().c_str());
+                    return 1;
+                }
+            }
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            std::printf(" %10.2f", elapsed.count() / reps / length);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
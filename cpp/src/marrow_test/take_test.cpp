@@ -0,0 +1,167 @@
+#include "marrow/take.h"
+#include "gtest/gtest.h"
+#include "batch_maker.h"
+#include "test_helpers.h"
+
+template<typename TType>
+class TestTakePrimitive : public testing::Test {
+public:
+    typedef typename arrow::TypeTraits<TType>::ArrayType ArrayType;
+
+    void assert_take(std::shared_ptr<arrow::Array> index, std::shared_ptr<arrow::Array> array, std::shared_ptr<arrow::Array> expected) {
+        ASSERT_STATUS_OK(marrow::take_primitive(static_cast<const arrow::Int32Array&>(*index), static_cast<const ArrayType&>(*array), &actual));
+        SCOPED_TRACE("actual: " + actual->ToString() + " expected: " + expected->ToString());
+        ASSERT_TRUE(actual->Equals(*expected));
+        ASSERT_EQ(actual->null_count(), expected->null_count());
+    }
+
+    std::shared_ptr<arrow::Array> actual;
+};
+
+TYPED_TEST_CASE(TestTakePrimitive, ScalarTypes);
+
+TYPED_TEST(TestTakePrimitive, TestWithoutNulls) {
+    auto array = BatchMaker().add_array<TypeParam>("", {1, 2, 3, 4, 5}, 99).array();
+    auto index = BatchMaker().add_array<>("", {4, 0, 0, 2}, 99).array();
+    auto expected = BatchMaker().add_array<TypeParam>("", {5, 1, 1, 3}, 99).array();
+    this->assert_take(index, array, expected);
+    ASSERT_FALSE(this->actual->null_bitmap());
+}
+
+TYPED_TEST(TestTakePrimitive, TestWithNulls) {
+    auto array = BatchMaker().add_array<TypeParam>("", {1, 2, 3, 4, 5}, 2).array();
+    auto index = BatchMaker().add_array<>("", {4, 1, -1, 2}, 99).array();
+    auto expected = BatchMaker().add_array<TypeParam>("", {5, 99, 99, 3}, 99).array();
+    this->assert_take(index, array, expected);
+
+    //Negative indices without nulls in the array
+    array = BatchMaker().add_array<TypeParam>("", {1, 2, 3, 4, 5}, 99).array();
+    expected = BatchMaker().add_array<TypeParam>("", {5, 2, 99, 3}, 99).array();
+    this->assert_take(index, array, expected);
+}
+
+TYPED_TEST(TestTakePrimitive, TestSliced) {
+    auto array = BatchMaker().add_array<TypeParam>("", {1, 2, 3, 4, 5}, 2).array()->Slice(1);
+    auto index = BatchMaker().add_array<>("", {7, 3, 2, 1, 0}, 99).array()->Slice(1);
+    auto expected = BatchMaker().add_array<TypeParam>("", {5, 4, 3, 99}, 99).array();
+    this->assert_take(index, array, expected);
+}
+
+template<typename TType>
+class TestTakeString : public testing::Test {
+public:
+    typedef typename arrow::TypeTraits<TType>::ArrayType ArrayType;
+};
+
+using StringTypes = ::testing::Types<arrow::StringType, arrow::LargeStringType>;
+TYPED_TEST_CASE(TestTakeString, StringTypes);
+
+TYPED_TEST(TestTakeString, TestTake) {
+    auto array = BatchMaker().add_string_array<TypeParam>("", {"a", "bc", "", "def", "g"}, "null").array();
+    auto index = BatchMaker().add_array<>("", {3, 0, 0, 2, 1}, 99).array();
+    std::shared_ptr<arrow::Array> actual;
+    ASSERT_STATUS_OK(marrow::take_string(static_cast<const arrow::Int32Array&>(*index), static_cast<const typename TestFixture::ArrayType&>(*array), &actual));
+    auto expected = BatchMaker().add_string_array<TypeParam>("", {"def", "a", "a", "", "bc"}, "null").array();
+    SCOPED_TRACE("actual: " + actual->ToString());
+    ASSERT_TRUE(actual->Equals(*expected));
+    ASSERT_FALSE(actual->null_bitmap());
+}
+
+TYPED_TEST(TestTakeString, TestWithNulls) {
+    auto array = BatchMaker().add_string_array<TypeParam>("", {"a", "bc", "", "def", "g"}).array()->Slice(1);
+    auto index = BatchMaker().add_array<>("", {2, -1, 1, 0, 3}, 99).array();
+    std::shared_ptr<arrow::Array> actual;
+    ASSERT_STATUS_OK(marrow::take_string(static_cast<const arrow::Int32Array&>(*index), static_cast<const typename TestFixture::ArrayType&>(*array), &actual));
+    auto expected = BatchMaker().add_string_array<TypeParam>("", {"def", "", "", "bc", "g"}).array();
+    SCOPED_TRACE("actual: " + actual->ToString());
+    ASSERT_TRUE(actual->Equals(*expected));
+    ASSERT_EQ(actual->null_count(), 2);
+}
+
+TEST(TestTakeIString, TestDictionary) {
+    auto array = BatchMaker().add_dict_array<>("", {"x", "yy", "", "x", "zzz"}).array();
+    auto index = BatchMaker().add_array<>("", {4, 2, -1, 0, 1}, 99).array();
+    std::shared_ptr<arrow::Array> actual;
+    ASSERT_STATUS_OK(marrow::take_istring<arrow::StringArray>(static_cast<const arrow::Int32Array&>(*index), *marrow::make_istring_array(array), &actual));
+    auto expected = BatchMaker().add_string_array<>("", {"zzz", "", "", "x", "yy"}).array();
+    SCOPED_TRACE("actual: " + actual->ToString());
+    ASSERT_TRUE(actual->Equals(*expected));
+}
+
+TEST(TestTakeRanges, TestThreadsMatchSequential) {
+    //Long enough to be split into row ranges, with nulls in the array and in the index
+    int64_t n = 5 * marrow::take_min_rows_per_thread + 7;
+    std::vector<int64_t> values, indices;
+    std::vector<std::string> strings;
+    for (int64_t i = 0; i < n; i++) {
+        values.push_back(i % 1000);
+        strings.push_back(std::to_string(i % 777));
+        indices.push_back(i % 101 == 0 ? -1 : (i * 7919) % n);
+    }
+    auto array = BatchMaker().add_array<arrow::Int64Type>("", values, 13).array();
+    auto string_array = BatchMaker().add_string_array<>("", strings, "13").array();
+    auto index = BatchMaker().add_array<arrow::Int64Type>("", indices, n).array();
+    auto& typed_index = static_cast<const arrow::Int64Array&>(*index);
+
+    auto bounds = marrow::take_ranges(n, 4);
+    ASSERT_EQ(bounds.size(), 5);
+    for (size_t r = 1; r + 1 < bounds.size(); r++) {
+        ASSERT_EQ(bounds[r] % 64, 0);
+    }
+
+    std::shared_ptr<arrow::Array> expected, actual;
+    ASSERT_STATUS_OK(marrow::take_primitive(typed_index, static_cast<const arrow::Int64Array&>(*array), &expected));
+    ASSERT_STATUS_OK(marrow::take_primitive(typed_index, static_cast<const arrow::Int64Array&>(*array), &actual, 4));
+    ASSERT_TRUE(actual->Equals(*expected));
+    ASSERT_EQ(actual->null_count(), expected->null_count());
+
+    ASSERT_STATUS_OK(marrow::take_string(typed_index, static_cast<const arrow::StringArray&>(*string_array), &expected));
+    ASSERT_STATUS_OK(marrow::take_string(typed_index, static_cast<const arrow::StringArray&>(*string_array), &actual, 4));
+    ASSERT_TRUE(actual->Equals(*expected));
+    ASSERT_EQ(actual->null_count(), expected->null_count());
+}
+
+TEST(TestTakeRanges, TestGatherModes) {
+    //A random permutation over more blocks than one, gathered with and without nulls in the index
+    int64_t n = 3 * marrow::take_min_rows_per_thread + 5;
+    std::vector<int32_t> values(n);
+    std::vector<int64_t> indices(n);
+    for (int64_t i = 0; i < n; i++) {
+        values[i] = static_cast<int32_t>(i * 3);
+        indices[i] = (i * 7919) % n;
+    }
+    auto array = BatchMaker().add_array<arrow::Int32Type>("", values, -1).array();
+    auto& typed_array = static_cast<const arrow::Int32Array&>(*array);
+    auto index = BatchMaker().add_array<arrow::Int64Type>("", indices, n).array();
+    auto& typed_index = static_cast<const arrow::Int64Array&>(*index);
+    indices[17] = -1;
+    auto null_index = BatchMaker().add_array<arrow::Int64Type>("", indices, n).array();
+
+    ASSERT_TRUE(marrow::index_is_random(typed_index, sizeof(int32_t)));
+    std::vector<int64_t> reversed(n);
+    for (int64_t i = 0; i < n; i++) {
+        reversed[i] = n - 1 - i;
+    }
+    auto reversed_index = BatchMaker().add_array<arrow::Int64Type>("", reversed, n).array();
+    ASSERT_FALSE(marrow::index_is_random(static_cast<const arrow::Int64Array&>(*reversed_index), sizeof(int32_t)));
+    //The array is small enough to be mostly in cache
+    ASSERT_EQ(marrow::gather_mode(marrow::GatherOptions(), typed_index, n, sizeof(int32_t)), marrow::GatherMode::Simple);
+
+    for (auto& idx: {index, null_index}) {
+        auto& typed_idx = static_cast<const arrow::Int64Array&>(*idx);
+        std::shared_ptr<arrow::Array> expected;
+        ASSERT_STATUS_OK(marrow::take_primitive(typed_idx, typed_array, &expected));
+        for (auto mode: {marrow::GatherMode::Simple, marrow::GatherMode::Prefetch, marrow::GatherMode::Blocked}) {
+            for (int num_threads: {1, 3}) {
+                SCOPED_TRACE(std::to_string(static_cast<int>(mode)) + " with threads: " + std::to_string(num_threads));
+                marrow::GatherOptions options;
+                options.mode = mode;
+                options.prefetch_distance = 8;
+                std::shared_ptr<arrow::Array> actual;
+                ASSERT_STATUS_OK(marrow::take_primitive(typed_idx, typed_array, &actual, num_threads, arrow::default_memory_pool(), options));
+                ASSERT_TRUE(actual->Equals(*expected));
+                ASSERT_EQ(actual->null_count(), expected->null_count());
+            }
+        }
+    }
+}
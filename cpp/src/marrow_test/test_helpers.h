@@ -12,7 +12,7 @@
 {                       \
     auto status = (s);  \
     SCOPED_TRACE(status.ToString());    \
-    ASSERT_TRUE(s.ok());    \
+    ASSERT_TRUE(status.ok());    \
 }
 
 static std::string compare_msg(std::shared_ptr<arrow::RecordBatch> actual, std::shared_ptr<arrow::RecordBatch> expected) {
@@ -66,6 +66,22 @@ static std::shared_ptr<arrow::RecordBatch> to_string_columns(std::shared_ptr<arr
     return arrow::RecordBatch::Make(arrow::schema(fields), batch->num_rows(), arrays);
 }
 
+/**
+ * Replace dictionary columns by their string values, for results whose dictionaries may be unified.
+ */
+static std::shared_ptr<arrow::RecordBatch> decode_dictionaries(std::shared_ptr<arrow::RecordBatch> batch) {
+    auto ret = batch;
+    for (int i = 0; i < batch->num_columns(); i++) {
+        if (batch->column(i)->type_id() == arrow::Type::DICTIONARY) {
+            auto column = arrow::RecordBatch::Make(arrow::schema({batch->schema()->field(i)}), batch->num_rows(), {batch->column(i)});
+            auto decoded = to_string_columns(column);
+            ARROW_THROW_NOT_OK(ret->RemoveColumn(i, &ret));
+            ARROW_THROW_NOT_OK(ret->AddColumn(i, decoded->schema()->field(0), decoded->column(0), &ret));
+        }
+    }
+    return ret;
+}
+
 using ScalarTypes = ::testing::Types<arrow::Int8Type, arrow::Int16Type, arrow::Int32Type, arrow::Int64Type,
         arrow::UInt8Type, arrow::UInt16Type, arrow::UInt32Type, arrow::UInt64Type,
         arrow::HalfFloatType, arrow::FloatType, arrow::DoubleType>;
@@ -46,13 +46,65 @@ namespace pybind11 { namespace detail {
             return arrow::py::wrap_record_batch(batch);
         }
     };
+
+    template <> struct type_caster<std::shared_ptr<arrow::Table>> {
+    public:
+        PYBIND11_TYPE_CASTER(std::shared_ptr<arrow::Table>, _("pyarrow.Table"));
+
+        bool load(handle src, bool) {
+            PyObject *source = src.ptr();
+            std::shared_ptr<arrow::Table> ret;
+            auto status = arrow::py::unwrap_table(source, &ret);
+            if (!status.ok()) {
+                return false;
+            }
+            value = ret;
+            return true;
+        }
+
+        static handle cast(std::shared_ptr<arrow::Table> table, return_value_policy /* policy */, handle /* parent */) {
+            return arrow::py::wrap_table(table);
+        }
+    };
 }} // namespace pybind11::detail
 
 PYBIND11_MODULE(pymarrow, m) {
     load_pyarrow();
-    m.def("add_index", &marrow::api::add_index, "Add an index column and meta data, which can be used by the sort and merge methods.", pybind11::arg("batch"), pybind11::arg("on"));
-    m.def("sort", &marrow::api::sort, "Sort the record batch by the specified columns. If an index column is present it uses that.", pybind11::arg("batch"), pybind11::arg("on"));
-    m.def("merge", &marrow::api::merge, "Do a left, inner or outer merge. If the table has either an index or is sorted (and has the required meta data as added by the add_index and sort methods), it will use those, otherwise it will create a temporary index",
-        pybind11::arg("left"), pybind11::arg("right"), pybind11::arg("on"), pybind11::arg("how"), pybind11::arg("right_postfix") = "");
+    pybind11::class_<arrow::MemoryPool, std::shared_ptr<arrow::MemoryPool>>(m, "MemoryPool", "An Arrow memory pool, which all functions take as an optional pool argument for their results and index arrays (but not for their std::vector scratch memory). A pool is kept alive as long as the results allocated from it.")
+        .def_property_readonly("bytes_allocated", &arrow::MemoryPool::bytes_allocated)
+        .def_property_readonly("max_memory", &arrow::MemoryPool::max_memory);
+    pybind11::class_<arrow::ProxyMemoryPool, arrow::MemoryPool, std::shared_ptr<arrow::ProxyMemoryPool>>(m, "ProxyMemoryPool", "Allocates from another pool and tracks the memory of its own allocations, e.g. of one request.")
+        .def(pybind11::init<arrow::MemoryPool*>(), pybind11::keep_alive<1, 2>(), pybind11::arg("pool"));
+    m.def("default_memory_pool", []() {return std::shared_ptr<arrow::MemoryPool>(arrow::default_memory_pool(), [](arrow::MemoryPool*) {});}, "The default Arrow memory pool.");
+    m.def("system_memory_pool", []() {return std::shared_ptr<arrow::MemoryPool>(arrow::system_memory_pool(), [](arrow::MemoryPool*) {});}, "The memory pool of the system allocator.");
+
+    pybind11::enum_<marrow::GatherMode>(m, "GatherMode", "How fixed width columns are gathered: picked from the sizes (Auto), in index order (Simple), in index order prefetching ahead (Prefetch) or partitioned by blocks of the column (Blocked).")
+        .value("Auto", marrow::GatherMode::Auto)
+        .value("Simple", marrow::GatherMode::Simple)
+        .value("Prefetch", marrow::GatherMode::Prefetch)
+        .value("Blocked", marrow::GatherMode::Blocked);
+    pybind11::class_<marrow::GatherOptions>(m, "GatherOptions", "Options of the gathers of sort, merge and their lazy variants.")
+        .def(pybind11::init([](marrow::GatherMode mode, int64_t prefetch_distance) {return marrow::GatherOptions{mode, prefetch_distance};}), pybind11::arg("mode") = marrow::GatherMode::Auto, pybind11::arg("prefetch_distance") = 16)
+        .def_readwrite("mode", &marrow::GatherOptions::mode)
+        .def_readwrite("prefetch_distance", &marrow::GatherOptions::prefetch_distance);
+
+    m.def("add_index", &marrow::api::add_index, "Add an index column and meta data, which can be used by the sort and merge methods.", pybind11::keep_alive<0, 4>(), pybind11::arg("batch"), pybind11::arg("on"), pybind11::arg("num_threads") = 1, pybind11::arg("pool") = pybind11::none());
+    m.def("sort", pybind11::overload_cast<std::shared_ptr<arrow::RecordBatch>, std::vector<std::string>, int, int64_t, std::vector<std::string>, arrow::MemoryPool*, marrow::GatherOptions>(&marrow::api::sort), "Sort the record batch by the specified columns. If an index column is present it uses that. With a limit >= 0 only the first limit rows are returned. Indexing and gathering the columns use up to num_threads threads. If columns are given only those are gathered and returned.", pybind11::keep_alive<0, 6>(), pybind11::arg("batch"), pybind11::arg("on"), pybind11::arg("num_threads") = 1, pybind11::arg("limit") = -1, pybind11::arg("columns") = std::vector<std::string>(), pybind11::arg("pool") = pybind11::none(), pybind11::arg("gather") = marrow::GatherOptions());
+    m.def("append", &marrow::api::append, "Append the rows of new_batch to an indexed batch, sorting only the new rows and merging them into the existing index.", pybind11::keep_alive<0, 4>(), pybind11::arg("batch"), pybind11::arg("new_batch"), pybind11::arg("on"), pybind11::arg("pool") = pybind11::none());
+    m.def("merge", pybind11::overload_cast<std::shared_ptr<arrow::RecordBatch>, std::shared_ptr<arrow::RecordBatch>, std::vector<std::string>, std::string, std::string, int, std::vector<std::string>, std::vector<std::string>, arrow::MemoryPool*, std::string, marrow::GatherOptions>(&marrow::api::merge), "Do a left, inner or outer merge. If the table has either an index or is sorted (and has the required meta data as added by the add_index and sort methods), it will use those, otherwise it will create a temporary index. Indexing and gathering the columns use up to num_threads threads. If columns or right_columns are given only those columns are gathered. The method is \"sort\" for a sort-merge join, \"hash\" for a hash join on the right rows, whose result is in left row order, or \"auto\" to merge if both sides are indexed or sorted, and otherwise to hash only if the right side has fewer than 2^20 rows and at most a quarter of the left rows.",
+        pybind11::keep_alive<0, 9>(), pybind11::arg("left"), pybind11::arg("right"), pybind11::arg("on"), pybind11::arg("how"), pybind11::arg("right_postfix") = "", pybind11::arg("num_threads") = 1,
+        pybind11::arg("columns") = std::vector<std::string>(), pybind11::arg("right_columns") = std::vector<std::string>(), pybind11::arg("pool") = pybind11::none(), pybind11::arg("method") = "sort", pybind11::arg("gather") = marrow::GatherOptions());
+    m.def("sort", pybind11::overload_cast<std::shared_ptr<arrow::Table>, std::vector<std::string>, int, std::vector<std::string>, arrow::MemoryPool*>(&marrow::api::sort), "Sort a table by the specified columns. Every chunk is sorted on its own and the chunks are merged, without concatenating the table first. If columns are given only those are gathered and returned.", pybind11::keep_alive<0, 5>(), pybind11::arg("table"), pybind11::arg("on"), pybind11::arg("num_threads") = 1, pybind11::arg("columns") = std::vector<std::string>(), pybind11::arg("pool") = pybind11::none());
+    m.def("merge", pybind11::overload_cast<std::shared_ptr<arrow::Table>, std::shared_ptr<arrow::Table>, std::vector<std::string>, std::string, std::string, int, std::vector<std::string>, std::vector<std::string>, arrow::MemoryPool*>(&marrow::api::merge), "Do a left, inner or outer merge of two tables, which are sorted chunk by chunk without concatenating them first. If columns or right_columns are given only those columns are gathered.",
+        pybind11::keep_alive<0, 9>(), pybind11::arg("left"), pybind11::arg("right"), pybind11::arg("on"), pybind11::arg("how"), pybind11::arg("right_postfix") = "", pybind11::arg("num_threads") = 1,
+        pybind11::arg("columns") = std::vector<std::string>(), pybind11::arg("right_columns") = std::vector<std::string>(), pybind11::arg("pool") = pybind11::none());
 
+    pybind11::class_<marrow::LazyRecordBatch, std::shared_ptr<marrow::LazyRecordBatch>>(m, "LazyRecordBatch", "A sorted or merged batch whose columns are gathered when they are first materialized.")
+        .def_property_readonly("num_rows", &marrow::LazyRecordBatch::num_rows)
+        .def_property_readonly("num_columns", &marrow::LazyRecordBatch::num_columns)
+        .def("materialize", &marrow::api::materialize, "Gather the given columns, all columns if none are given, into a record batch.", pybind11::keep_alive<0, 1>(), pybind11::arg("columns") = std::vector<std::string>());
+    m.def("lazy_sort", &marrow::api::lazy_sort, "Like sort, but the columns are only gathered when they are materialized.", pybind11::keep_alive<0, 5>(), pybind11::arg("batch"), pybind11::arg("on"), pybind11::arg("num_threads") = 1, pybind11::arg("limit") = -1, pybind11::arg("pool") = pybind11::none(), pybind11::arg("gather") = marrow::GatherOptions());
+    m.def("lazy_merge", &marrow::api::lazy_merge, "Like merge, but the columns are only gathered when they are materialized.",
+        pybind11::keep_alive<0, 9>(), pybind11::arg("left"), pybind11::arg("right"), pybind11::arg("on"), pybind11::arg("how"), pybind11::arg("right_postfix") = "", pybind11::arg("num_threads") = 1,
+        pybind11::arg("columns") = std::vector<std::string>(), pybind11::arg("right_columns") = std::vector<std::string>(), pybind11::arg("pool") = pybind11::none(), pybind11::arg("method") = "sort", pybind11::arg("gather") = marrow::GatherOptions());
 }
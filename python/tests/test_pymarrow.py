@@ -50,5 +50,100 @@ class TestPyMarrow(unittest.TestCase):
         self.assertTrue(actual.equals(expected))
 
 
+    def test_sort_arguments(self):
+        batch = pyarrow.RecordBatch.from_arrays([
+            [5, 4, 3, 2, 1],
+            [1, 2, 3, 4, 5]
+        ], ["a", "b"])
+        expected = pymarrow.sort(batch, ["a"])
+        self.assertTrue(pymarrow.sort(batch, ["a"], num_threads=2).equals(expected))
+        self.assertEqual(pymarrow.sort(batch, ["a"], limit=2).to_pydict(), {"a": [1, 2], "b": [5, 4]})
+        self.assertEqual(pymarrow.sort(batch, ["a"], columns=["b"]).to_pydict(), {"b": [5, 4, 3, 2, 1]})
+        gather = pymarrow.GatherOptions(mode=pymarrow.GatherMode.Prefetch, prefetch_distance=4)
+        self.assertTrue(pymarrow.sort(batch, ["a"], gather=gather).equals(expected))
+        with self.assertRaises(RuntimeError):
+            pymarrow.sort(batch, ["a"], columns=["c"])
+
+    def test_merge_arguments(self):
+        batch1 = pyarrow.RecordBatch.from_arrays([
+            [3, 1, 2],
+            [31, 11, 21]
+        ], ["a", "b"])
+        batch2 = pyarrow.RecordBatch.from_arrays([
+            [1, 4],
+            [11, 41],
+            [12, 42]
+        ], ["a", "c", "d"])
+        expected = {"a": [1, 2, 3, 4], "b": [11, 21, 31, None], "c": [11, None, None, 41], "d": [12, None, None, 42]}
+        self.assertEqual(pymarrow.merge(batch1, batch2, on=["a"], how="outer").to_pydict(), expected)
+        self.assertEqual(pymarrow.merge(batch1, batch2, on=["a"], how="outer", num_threads=2, method="sort").to_pydict(), expected)
+        #A hash join gives the rows in left row order, followed by the right only rows
+        actual = pymarrow.merge(batch1, batch2, on=["a"], how="outer", method="hash", gather=pymarrow.GatherOptions(pymarrow.GatherMode.Simple))
+        self.assertEqual(actual.to_pydict(), {"a": [3, 1, 2, 4], "b": [31, 11, 21, None], "c": [None, 11, None, 41], "d": [None, 12, None, 42]})
+        #The right side is not much smaller than the left, so auto merges in sort order
+        self.assertEqual(pymarrow.merge(batch1, batch2, on=["a"], how="outer", method="auto").to_pydict(), expected)
+        actual = pymarrow.merge(batch1, batch2, on=["a"], how="left", right_postfix="_right", columns=["a"], right_columns=["d"])
+        self.assertEqual(actual.to_pydict(), {"a": [1, 2, 3], "d_right": [12, None, None]})
+        with self.assertRaises(RuntimeError):
+            pymarrow.merge(batch1, batch2, on=["a"], how="outer", method="nested")
+
+    def test_table(self):
+        table1 = pyarrow.Table.from_batches([
+            pyarrow.RecordBatch.from_arrays([[3, 1], [30, 10]], ["a", "b"]),
+            pyarrow.RecordBatch.from_arrays([[2, 0], [20, 0]], ["a", "b"])
+        ])
+        table2 = pyarrow.Table.from_batches([
+            pyarrow.RecordBatch.from_arrays([[1, 5], [11, 51]], ["a", "c"]),
+            pyarrow.RecordBatch.from_arrays([[2], [21]], ["a", "c"])
+        ])
+        actual = pymarrow.sort(table1, ["a"], num_threads=2)
+        self.assertIsInstance(actual, pyarrow.Table)
+        self.assertEqual(actual.to_pydict(), {"a": [0, 1, 2, 3], "b": [0, 10, 20, 30]})
+        self.assertEqual(pymarrow.sort(table1, ["a"], columns=["b"]).to_pydict(), {"b": [0, 10, 20, 30]})
+
+        actual = pymarrow.merge(table1, table2, on=["a"], how="inner")
+        self.assertIsInstance(actual, pyarrow.Table)
+        self.assertEqual(actual.to_pydict(), {"a": [1, 2], "b": [10, 20], "c": [11, 21]})
+        actual = pymarrow.merge(table1, table2, on=["a"], how="outer", columns=["a"], right_columns=["c"])
+        self.assertEqual(actual.to_pydict(), {"a": [0, 1, 2, 3, 5], "c": [None, 11, 21, None, 51]})
+
+    def test_pool(self):
+        batch = pyarrow.RecordBatch.from_arrays([
+            [5, 4, 3, 2, 1],
+            [1, 2, 3, 4, 5]
+        ], ["a", "b"])
+        pool = pymarrow.ProxyMemoryPool(pymarrow.default_memory_pool())
+        actual = pymarrow.sort(batch, ["a"], pool=pool)
+        self.assertTrue(actual.equals(pymarrow.sort(batch, ["a"])))
+        self.assertGreater(pool.bytes_allocated, 0)
+        merged = pymarrow.merge(actual, batch, on=["a"], how="inner", right_postfix="_right", pool=pool)
+        self.assertEqual(merged.num_rows, 5)
+        #The results keep the pool alive
+        del pool
+        self.assertEqual(actual.to_pydict(), {"a": [1, 2, 3, 4, 5], "b": [5, 4, 3, 2, 1]})
+        self.assertEqual(merged.to_pydict()["b_right"], [5, 4, 3, 2, 1])
+
+    def test_lazy(self):
+        batch1 = pyarrow.RecordBatch.from_arrays([
+            [3, 1, 2],
+            [31, 11, 21]
+        ], ["a", "b"])
+        batch2 = pyarrow.RecordBatch.from_arrays([
+            [1, 2, 4],
+            [11, 21, 41]
+        ], ["a", "c"])
+        lazy = pymarrow.lazy_sort(batch1, ["a"], num_threads=2, limit=2, gather=pymarrow.GatherOptions())
+        self.assertEqual((lazy.num_rows, lazy.num_columns), (2, 2))
+        self.assertEqual(lazy.materialize(["b"]).to_pydict(), {"b": [11, 21]})
+        self.assertEqual(lazy.materialize().to_pydict(), {"a": [1, 2], "b": [11, 21]})
+
+        pool = pymarrow.ProxyMemoryPool(pymarrow.default_memory_pool())
+        lazy = pymarrow.lazy_merge(batch1, batch2, on=["a"], how="inner", right_postfix="_right", columns=["a"], right_columns=["c"], pool=pool, method="hash")
+        self.assertEqual(lazy.num_columns, 2)
+        self.assertEqual(lazy.materialize().to_pydict(), {"a": [1, 2], "c_right": [11, 21]})
+        lazy = pymarrow.lazy_merge(batch1, batch2, on=["a"], how="outer")
+        self.assertEqual(lazy.materialize(["a", "c"]).to_pydict(), {"a": [1, 2, 3, 4], "c": [11, 21, None, 41]})
+
+
 if __name__ == '__main__':
     unittest.main()